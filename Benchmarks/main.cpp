@@ -0,0 +1,366 @@
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <algorithm>
+#include <filesystem>
+#include <string_view>
+#include <utl/vector.hpp>
+#include <utl/messenger.hpp>
+#include <utl/scope_guard.hpp>
+
+#if !defined(WM_PLATFORM_WINDOWS)
+#include <sys/resource.h>
+#endif
+
+#include "Core/Debug.hpp"
+#include "Core/Registry.hpp"
+#include "Core/PluginManager.hpp"
+#include "Core/BuildSystem.hpp"
+#include "Core/Image/ImagePool.hpp"
+#include "Core/Network/Network.hpp"
+#include "Core/Network/NodeImplementation.hpp"
+
+#include "CLI/ArgumentParser.hpp"
+
+/// Benchmarks of the builtin nodes and of the build system. Every measurement is
+/// printed as one JSON object per line, so runs can be diffed and tracked by scripts.
+///
+///     node:     one builtin node at one resolution, its inputs built beforehand
+///     threads:  a diamond network at a fixed resolution with 1 to N workers
+///     network:  synthetic deep, wide and diamond networks. At 'overheadResolution'
+///               the work per node is negligible and 'secondsPerNode' is the
+///               scheduling overhead per node.
+///
+/// 'seconds' is the fastest of all repetitions. 'peakMemory' is the peak resident
+/// set of the process so far in bytes, 'poolMemory' what the image pool holds
+/// after the run.
+
+using namespace worldmachine;
+
+namespace {
+
+	struct Options {
+		std::optional<std::filesystem::path> plugin;
+		std::size_t minResolution = 256;
+		std::size_t maxResolution = 8192;
+		std::size_t repetitions = 3;
+		std::size_t threads = std::thread::hardware_concurrency();
+		std::string filter;
+	};
+
+	constexpr char const* usage = R"(usage: wmbench [options]
+
+Runs the node and build system benchmarks and prints one JSON object per measurement.
+
+options:
+      --min-resolution <N>   Smallest image edge of the node benchmarks, default 256
+      --max-resolution <N>   Largest image edge of the node benchmarks, default 8192
+  -r, --repetitions <N>      Runs per measurement, the fastest is reported, default 3
+  -j, --threads <N>          Largest number of worker threads, default all cores
+      --filter <text>        Only run benchmarks whose name contains this
+      --plugin <path>        Node plugin to load, default the builtin nodes next to this executable
+  -h, --help                 Print this message
+)";
+
+	constexpr std::size_t overheadResolution = 16;
+	constexpr std::size_t threadScalingResolution = 2048;
+	constexpr std::size_t networkResolution = 1024;
+
+	std::optional<Options> parseOptions(int argc, char const* const* argv) {
+		Options options;
+		for (ArgumentParser args(argc, argv); args.next();) {
+			std::string_view const arg = args.current();
+			if (arg == "-h" || arg == "--help") {
+				return std::nullopt;
+			}
+			else if (arg == "--min-resolution") {
+				if (!args.number(options.minResolution)) return std::nullopt;
+			}
+			else if (arg == "--max-resolution") {
+				if (!args.number(options.maxResolution)) return std::nullopt;
+			}
+			else if (arg == "-r" || arg == "--repetitions") {
+				if (!args.number(options.repetitions)) return std::nullopt;
+			}
+			else if (arg == "-j" || arg == "--threads") {
+				if (!args.number(options.threads)) return std::nullopt;
+			}
+			else if (arg == "--filter") {
+				auto v = args.value(); if (!v) return std::nullopt;
+				options.filter = *v;
+			}
+			else if (arg == "--plugin") {
+				auto v = args.value(); if (!v) return std::nullopt;
+				options.plugin = *v;
+			}
+			else {
+				std::cerr << "Unexpected argument '" << arg << "'\n";
+				return std::nullopt;
+			}
+		}
+		options.threads = std::max<std::size_t>(options.threads, 1);
+		return options;
+	}
+
+	/// In bytes, 0 where not supported
+	std::size_t peakMemory() {
+#if defined(WM_PLATFORM_WINDOWS)
+		return 0;
+#else
+		rusage usage{};
+		getrusage(RUSAGE_SELF, &usage);
+#if defined(WM_PLATFORM_MACOS)
+		return std::size_t(usage.ru_maxrss);
+#else
+		return std::size_t(usage.ru_maxrss) * 1024;
+#endif
+#endif
+	}
+
+	/// MARK: Networks
+	class Bench {
+	public:
+		explicit Bench(Options const& options): options(options) {
+			/// Every run must compute its nodes.
+			buildSystem->setOutputCacheDirectory(std::nullopt);
+		}
+
+		void run() {
+			auto listeners = buildSystem->makeListeners();
+			[[maybe_unused]] auto listenerIDs = messenger.register_listeners(listeners.begin(), listeners.end());
+			runNodeBenchmarks();
+			runThreadScaling();
+			runNetworkBenchmarks();
+		}
+
+	private:
+		struct Result {
+			double seconds;
+			std::size_t builtNodes;
+		};
+
+		bool enabled(std::string_view name) const {
+			return options.filter.empty() || name.find(options.filter) != std::string_view::npos;
+		}
+
+		static std::size_t addNode(Network& network, std::string_view implementationName) {
+			auto& registry = Registry::instance();
+			for (auto const id: registry.getIDs()) {
+				auto desc = registry.createDescriptorFromID(id);
+				if (desc.name == implementationName) {
+					return network.addNode(std::move(desc));
+				}
+			}
+			throw std::runtime_error("No node named '" + std::string(implementationName) + "' in the loaded plugins");
+		}
+
+		static void connect(Network& network, std::size_t from, std::size_t to, std::size_t pin = 0) {
+			network.addEdge(PinIndex{ from, 0, PinKind::output }, PinIndex{ to, pin, PinKind::input });
+		}
+
+		/// Builds 'targets' from scratch except for the nodes in 'keep', which are
+		/// built once up front and left alone.
+		Result measure(Network& network, utl::vector<std::size_t> const& targets,
+					   std::size_t resolution, std::size_t threads,
+					   utl::vector<std::size_t> const& keep = {})
+		{
+			buildSystem->setResolution(mtl::usize2(resolution));
+			buildSystem->setNumberOfThreads(threads);
+			auto build = [&](utl::vector<std::size_t> const& nodes) {
+				auto const ids = network.IDsFromIndices(nodes);
+				messenger.send_message(BuildRequest{
+					BuildType::highResolution,
+					&network,
+					utl::vector<utl::UUID>(ids.begin(), ids.end())
+				});
+				buildSystem->waitForBuild();
+			};
+			network.invalidateAllNodes();
+			if (!keep.empty()) {
+				build(keep);
+			}
+			Result best{ std::numeric_limits<double>::max(), 0 };
+			for (std::size_t i = 0; i < options.repetitions; ++i) {
+				std::size_t invalidated = 0;
+				for (std::size_t nodeIndex = 0; nodeIndex < network.nodeCount(); ++nodeIndex) {
+					if (std::find(keep.begin(), keep.end(), nodeIndex) == keep.end()) {
+						network.invalidateNodesDownstream(nodeIndex, BuildType::highResolution);
+						++invalidated;
+					}
+				}
+				auto const begin = std::chrono::steady_clock::now();
+				build(targets);
+				std::chrono::duration<double> const elapsed = std::chrono::steady_clock::now() - begin;
+				for (std::size_t nodeIndex: targets) {
+					if (!network.nodes[nodeIndex].implementation->built()) {
+						WM_Log(warning, "'{}' was not built", network.nodes[nodeIndex].name);
+					}
+				}
+				best = std::min(best, Result{ elapsed.count(), invalidated },
+								[](Result a, Result b) { return a.seconds < b.seconds; });
+			}
+			return best;
+		}
+
+		void report(std::string_view benchmark, std::string_view name, std::size_t resolution,
+					std::size_t threads, Result result)
+		{
+			double const pixels = double(resolution) * resolution * result.builtNodes;
+			std::cout << "{\"benchmark\": \"" << benchmark << "\""
+					  << ", \"name\": \"" << name << "\""
+					  << ", \"resolution\": " << resolution
+					  << ", \"threads\": " << threads
+					  << ", \"nodes\": " << result.builtNodes
+					  << ", \"seconds\": " << result.seconds
+					  << ", \"pixelsPerSecond\": " << pixels / result.seconds
+					  << ", \"secondsPerNode\": " << result.seconds / result.builtNodes
+					  << ", \"peakMemory\": " << peakMemory()
+					  << ", \"poolMemory\": " << ImagePool::instance().residentBytes()
+					  << "}" << std::endl;
+		}
+
+		/// MARK: Node Benchmarks
+		void runNodeBenchmarks() {
+			/// Nodes with mandatory inputs read from Perlin noise, which is not measured.
+			struct NodeCase {
+				std::string_view name;
+				std::size_t inputs;
+			};
+			for (NodeCase const node: { NodeCase{ "Perlin Noise", 0 }, NodeCase{ "Voronoi", 0 },
+										NodeCase{ "Erosion", 1 }, NodeCase{ "Combiner", 2 },
+										NodeCase{ "Clamp", 1 }, NodeCase{ "Append", 2 },
+										NodeCase{ "Blur", 1 } })
+			{
+				if (!enabled(node.name)) {
+					continue;
+				}
+				auto network = Network::create();
+				utl::vector<std::size_t> sources;
+				for (std::size_t i = 0; i < node.inputs; ++i) {
+					sources.push_back(addNode(*network, "Perlin Noise"));
+				}
+				std::size_t const target = addNode(*network, node.name);
+				for (std::size_t i = 0; i < node.inputs; ++i) {
+					connect(*network, sources[i], target, i);
+				}
+				for (std::size_t resolution = options.minResolution; resolution <= options.maxResolution; resolution *= 2) {
+					report("node", node.name, resolution, options.threads,
+						   measure(*network, { target }, resolution, options.threads, sources));
+				}
+			}
+		}
+
+		/// MARK: Thread Scaling
+		void runThreadScaling() {
+			if (!enabled("threads")) {
+				return;
+			}
+			auto network = Network::create();
+			std::size_t const target = makeDiamond(*network, 8);
+			for (std::size_t threads = 1;; threads = std::min(threads * 2, options.threads)) {
+				report("threads", "diamond", threadScalingResolution, threads,
+					   measure(*network, { target }, threadScalingResolution, threads));
+				if (threads == options.threads) {
+					break;
+				}
+			}
+		}
+
+		/// MARK: Network Benchmarks
+		/// Perlin noise followed by a chain of 'depth' clamp nodes
+		static std::size_t makeDeep(Network& network, std::size_t depth) {
+			std::size_t last = addNode(network, "Perlin Noise");
+			for (std::size_t i = 0; i < depth; ++i) {
+				std::size_t const next = addNode(network, "Clamp");
+				connect(network, last, next);
+				last = next;
+			}
+			return last;
+		}
+
+		/// 'width' independent noise nodes
+		static utl::vector<std::size_t> makeWide(Network& network, std::size_t width) {
+			utl::vector<std::size_t> result;
+			for (std::size_t i = 0; i < width; ++i) {
+				result.push_back(addNode(network, "Perlin Noise"));
+			}
+			return result;
+		}
+
+		/// Perlin noise fanning out to 'width' clamp nodes, joined again by a tree of combiners
+		static std::size_t makeDiamond(Network& network, std::size_t width) {
+			std::size_t const source = addNode(network, "Perlin Noise");
+			utl::vector<std::size_t> layer;
+			for (std::size_t i = 0; i < width; ++i) {
+				layer.push_back(addNode(network, "Clamp"));
+				connect(network, source, layer.back());
+			}
+			while (layer.size() > 1) {
+				utl::vector<std::size_t> next;
+				for (std::size_t i = 0; i + 1 < layer.size(); i += 2) {
+					next.push_back(addNode(network, "Combiner"));
+					connect(network, layer[i], next.back(), 0);
+					connect(network, layer[i + 1], next.back(), 1);
+				}
+				if (layer.size() % 2) {
+					next.push_back(layer.back());
+				}
+				layer = std::move(next);
+			}
+			return layer.front();
+		}
+
+		void runNetworkBenchmarks() {
+			auto run = [&](std::string_view name, auto make) {
+				if (!enabled(name)) {
+					return;
+				}
+				auto network = Network::create();
+				utl::vector<std::size_t> const targets = make(*network);
+				for (std::size_t resolution: { overheadResolution, networkResolution }) {
+					report("network", name, resolution, options.threads,
+						   measure(*network, targets, resolution, options.threads));
+				}
+			};
+			run("deep", [](Network& network) { return utl::vector<std::size_t>{ makeDeep(network, 64) }; });
+			run("wide", [](Network& network) { return makeWide(network, 64); });
+			run("diamond", [](Network& network) { return utl::vector<std::size_t>{ makeDiamond(network, 64) }; });
+		}
+
+	private:
+		Options options;
+		utl::unique_ref<BuildSystem> buildSystem = BuildSystem::create();
+		utl::messenger messenger;
+	};
+
+}
+
+int main(int argc, char const* const* argv) {
+	/// Log records are printed by a background thread, get them out before we exit.
+	utl::scope_guard flushGuard = []{ flushLog(); };
+	auto const options = parseOptions(argc, argv);
+	if (!options) {
+		std::cerr << usage;
+		return 2;
+	}
+
+	auto& plugins = PluginManager::instance();
+	auto const pluginPath = options->plugin.value_or(defaultPluginPath(argv[0]));
+	plugins.loadPlugin(pluginPath);
+	if (plugins.getLoadedPlugins().empty()) {
+		std::cerr << "Failed to load node plugin " << pluginPath << "\n";
+		return 1;
+	}
+
+	try {
+		Bench(*options).run();
+	}
+	catch (std::exception const& e) {
+		std::cerr << e.what() << "\n";
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,67 @@
+#include <Catch2/Catch2.hpp>
+
+#include <cmath>
+#include <algorithm>
+#include <utl/vector.hpp>
+
+#include "Core/Image/BlurKernels.hpp"
+
+using namespace worldmachine;
+
+TEST_CASE("Blur kernels") {
+	std::size_t const count = 37;
+	utl::vector<float> source(count), dest(count);
+	for (std::size_t i = 0; i < count; ++i) {
+		source[i] = std::sin(i * 0.7f);
+	}
+
+	SECTION("boxBlur") {
+		/// Radii shorter and longer than the row
+		for (std::size_t radius: { 0, 1, 5, 36, 100 }) {
+			boxBlur(source.data(), dest.data(), count, radius);
+			for (std::ptrdiff_t i = 0; i < (std::ptrdiff_t)count; ++i) {
+				double reference = 0;
+				for (std::ptrdiff_t k = i - (std::ptrdiff_t)radius; k <= i + (std::ptrdiff_t)radius; ++k) {
+					reference += source[std::clamp<std::ptrdiff_t>(k, 0, count - 1)];
+				}
+				reference /= 2 * radius + 1;
+				CHECK(dest[i] == Approx(reference).margin(1e-6));
+			}
+		}
+	}
+
+	SECTION("gaussianBoxRadii") {
+		for (float sigma: { 1.0f, 3.0f, 20.0f, 200.0f }) {
+			double variance = 0;
+			for (std::size_t r: gaussianBoxRadii(sigma)) {
+				variance += ((2.0 * r + 1) * (2.0 * r + 1) - 1) / 12;
+			}
+			CHECK(std::sqrt(variance) == Approx(sigma).epsilon(0.2));
+		}
+		auto const none = gaussianBoxRadii(0);
+		CHECK(std::all_of(none.begin(), none.end(), [](std::size_t r) { return r == 0; }));
+	}
+
+	SECTION("gaussianBlur keeps constants") {
+		utl::vector<float> constant(count, 0.25f), scratch(count);
+		gaussianBlur(constant.data(), dest.data(), count, gaussianBoxRadii(10), scratch.data());
+		for (float value: dest) {
+			CHECK(value == Approx(0.25f));
+		}
+	}
+
+	SECTION("transpose") {
+		/// Larger than a tile in both directions and not a multiple of it
+		mtl::usize2 const size = { 45, 70 };
+		utl::vector<float> image(size.x * size.y), transposed(size.x * size.y);
+		for (std::size_t i = 0; i < image.size(); ++i) {
+			image[i] = (float)i;
+		}
+		transpose(image.data(), size.x, transposed.data(), size.y, size);
+		for (std::size_t y = 0; y < size.y; ++y) {
+			for (std::size_t x = 0; x < size.x; ++x) {
+				CHECK(transposed[x * size.y + y] == image[y * size.x + x]);
+			}
+		}
+	}
+}
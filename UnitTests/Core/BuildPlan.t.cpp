@@ -0,0 +1,78 @@
+#include <Catch2/Catch2.hpp>
+
+#include "Core/BuildPlan.hpp"
+#include "Core/Network/Network.hpp"
+
+#include "MockNetworkBuilder.t.hpp"
+
+using namespace worldmachine;
+
+using test::MockNetworkBuilder;
+
+TEST_CASE("BuildPlan topological order") {
+	MockNetworkBuilder builder;
+	builder.addNodes(5);
+	builder.addEdge(0, 1);
+	builder.addEdge(0, 2);
+	builder.addEdge(1, 3);
+	builder.addEdge(2, {3, 1});
+	
+	/* Network:
+		   1
+		 /   \
+	 0 -	   - 3        4
+		 \   /
+		   2
+	 */
+	
+	auto network = builder.get();
+	std::array<std::size_t, 1> const leaves = { 3 };
+	
+	SECTION("Nothing built") {
+		BuildPlan plan(network.get(), leaves, [](std::size_t) { return false; });
+		REQUIRE(plan.size() == 4);
+		CHECK(plan.builtDependencies().empty());
+		
+		auto const order = plan.nodeIndices();
+		auto position = [&](std::size_t nodeIndex) {
+			return std::find(order.begin(), order.end(), nodeIndex) - order.begin();
+		};
+		CHECK(position(0) < position(1));
+		CHECK(position(0) < position(2));
+		CHECK(position(1) < position(3));
+		CHECK(position(2) < position(3));
+		
+		REQUIRE(plan.roots().size() == 1);
+		CHECK(plan.nodeIndex(plan.roots()[0]) == 0);
+		CHECK(plan.successors(plan.roots()[0]).size() == 2);
+	}
+	
+	SECTION("Root built") {
+		BuildPlan plan(network.get(), leaves, [](std::size_t nodeIndex) { return nodeIndex == 0; });
+		REQUIRE(plan.size() == 3);
+		REQUIRE(plan.builtDependencies().size() == 1);
+		CHECK(plan.builtDependencies()[0] == 0);
+		CHECK(plan.roots().size() == 2);
+		
+		/// Node 3 is released by both of its inputs
+		auto const planIndex = std::find(plan.nodeIndices().begin(), plan.nodeIndices().end(), 3) - plan.nodeIndices().begin();
+		CHECK(!plan.releasePredecessor(planIndex));
+		CHECK(plan.releasePredecessor(planIndex));
+	}
+	
+	SECTION("Prioritize upstream of a node") {
+		BuildPlan plan(network.get(), leaves, [](std::size_t) { return false; });
+		plan.prioritize(1);
+		auto priority = [&](std::size_t nodeIndex) {
+			auto const planIndex = std::find(plan.nodeIndices().begin(), plan.nodeIndices().end(), nodeIndex) - plan.nodeIndices().begin();
+			return plan.state(planIndex).priority;
+		};
+		CHECK(priority(0));
+		CHECK(priority(1));
+		CHECK(!priority(2));
+		CHECK(!priority(3));
+		
+		/// Not part of the plan
+		plan.prioritize(4);
+	}
+}
@@ -1,10 +1,106 @@
 #include <Catch2/Catch2.hpp>
 
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+#include "Core/BuildJob.hpp"
 #include "Core/BuildSystem.hpp"
+#include "Core/Registry.hpp"
 #include "Core/Network/Network.hpp"
+#include "Core/Network/NodeDependencyMap.hpp"
 
 using namespace worldmachine;
 
+namespace {
+	
+	/// Like Voronoi with its feature outputs switched off, output 1 is never computed.
+	class SwitchedOutputTestNode: public ImageNodeImplementationT<SwitchedOutputTestNode, "Switched Output Test Node"> {
+	public:
+		bool displayControls() override { return false; }
+		BuildJob makeBuildJob(NodeDependencyMap) override {
+			ImageView<float> dest = getBuildDest(0);
+			BuildJob job;
+			job.add([dest]{ std::fill(dest.data(), dest.data() + dest.size().fold(utl::multiplies), 1.0f); });
+			return job;
+		}
+		static NodeDescriptor staticDescriptor() {
+			return {
+				.category = NodeCategory::generator,
+				.pinDescriptorArray = {
+					.output = { { "Main", DataType::float1 }, { "Switched", DataType::float1 } }
+				}
+			};
+		}
+		
+	private:
+		bool outputEnabled(std::size_t index) const override { return index == 0; }
+	};
+	
+	WM_RegisterNode(SwitchedOutputTestNode);
+	
+	/// Like Clamp, reads all of its input.
+	class ReadInputTestNode: public ImageNodeImplementationT<ReadInputTestNode, "Read Input Test Node"> {
+	public:
+		bool displayControls() override { return false; }
+		BuildJob makeBuildJob(NodeDependencyMap dependencies) override {
+			ImageView<float> dest = getBuildDest(0);
+			auto const input = dependencies.getInput<float>(0);
+			inputSize = input.size();
+			BuildJob job;
+			if (input.size() == dest.size()) {
+				job.add([input, dest]{ std::copy_n(input.data(), dest.size().fold(utl::multiplies), dest.data()); });
+			}
+			return job;
+		}
+		static NodeDescriptor staticDescriptor() {
+			return {
+				.category = NodeCategory::filter,
+				.pinDescriptorArray = {
+					.input = { { "Input", DataType::float1, mandatory } },
+					.output = { { "Default", DataType::float1 } }
+				}
+			};
+		}
+		
+		mtl::usize2 inputSize = 0;
+	};
+	
+	WM_RegisterNode(ReadInputTestNode);
+	
+	/// Jobs wait until 'open' is set, so requests can be queued behind a running build.
+	class GatedTestNode: public ImageNodeImplementationT<GatedTestNode, "Gated Test Node"> {
+	public:
+		bool displayControls() override { return false; }
+		BuildJob makeBuildJob(NodeDependencyMap) override {
+			BuildJob job;
+			job.add([]{
+				while (!open) {
+					std::this_thread::yield();
+				}
+			});
+			return job;
+		}
+		static NodeDescriptor staticDescriptor() {
+			return {
+				.category = NodeCategory::generator,
+				.pinDescriptorArray = {
+					.output = { { "Default", DataType::float1 } }
+				}
+			};
+		}
+		
+		static inline std::atomic_bool open = false;
+	};
+	
+	WM_RegisterNode(GatedTestNode);
+	
+	std::size_t addNode(Network& network, ImplementationID id) {
+		return network.addNode(Registry::instance().createDescriptorFromID(id));
+	}
+	
+}
+
 TEST_CASE("BuildSystem") {
 	auto buildSystem = BuildSystem::create();
 	
@@ -18,3 +114,70 @@ TEST_CASE("BuildSystem") {
 	m.send_message(BuildRequest(BuildType::preview, network.get()));
 	
 }
+
+TEST_CASE("BuildSystem switched off output that is read downstream") {
+	auto buildSystem = BuildSystem::create();
+	buildSystem->setOutputCacheDirectory(std::nullopt);
+	buildSystem->setResolution({ 16, 8 });
+	
+	utl::messenger m;
+	auto listeners = buildSystem->makeListeners();
+	[[maybe_unused]] auto ids = m.register_listeners(listeners.begin(), listeners.end());
+	
+	auto network = Network::create();
+	std::size_t const source = addNode(*network, SwitchedOutputTestNode::staticID());
+	std::size_t const reader = addNode(*network, ReadInputTestNode::staticID());
+	network->addEdge({ source, 1, PinKind::output }, { reader, 0, PinKind::input });
+	
+	std::size_t const targets[] = { reader };
+	auto const targetIDs = network->IDsFromIndices(targets);
+	m.send_message(BuildRequest(BuildType::highResolution, network.get(),
+								utl::vector<utl::UUID>(targetIDs.begin(), targetIDs.end())));
+	buildSystem->waitForBuild();
+	
+	auto const& readerImpl = static_cast<ReadInputTestNode const&>(*network->nodes[reader].implementation);
+	REQUIRE(readerImpl.built());
+	/// Read as a blank image rather than as no image
+	CHECK(readerImpl.inputSize == mtl::usize2(16, 8));
+	Image const& result = readerImpl.highResImage(0);
+	REQUIRE(result.size() == mtl::usize2(16, 8));
+	CHECK(std::all_of(result.begin(), result.end(), [](float x) { return x == 0; }));
+	
+	/// Not connected, so still left empty
+	std::size_t const unconnected = addNode(*network, SwitchedOutputTestNode::staticID());
+	std::size_t const unconnectedTargets[] = { unconnected };
+	auto const unconnectedIDs = network->IDsFromIndices(unconnectedTargets);
+	m.send_message(BuildRequest(BuildType::highResolution, network.get(),
+								utl::vector<utl::UUID>(unconnectedIDs.begin(), unconnectedIDs.end())));
+	buildSystem->waitForBuild();
+	auto const& unconnectedImpl = static_cast<ImageNodeImplementation const&>(*network->nodes[unconnected].implementation);
+	REQUIRE(unconnectedImpl.built());
+	CHECK(unconnectedImpl.highResImage(1).empty());
+}
+
+TEST_CASE("BuildSystem keeps queued requests of other build types") {
+	auto buildSystem = BuildSystem::create();
+	buildSystem->setOutputCacheDirectory(std::nullopt);
+	buildSystem->setResolution({ 16, 8 });
+	buildSystem->setPreviewResolution({ 8, 4 });
+	
+	utl::messenger m;
+	auto listeners = buildSystem->makeListeners();
+	[[maybe_unused]] auto ids = m.register_listeners(listeners.begin(), listeners.end());
+	
+	auto network = Network::create();
+	std::size_t const node = addNode(*network, GatedTestNode::staticID());
+	
+	GatedTestNode::open = false;
+	m.send_message(BuildRequest(BuildType::preview, network.get()));
+	/// Both queued behind the running preview build. The second preview
+	/// request must not replace the high resolution one.
+	m.send_message(BuildRequest(BuildType::highResolution, network.get()));
+	m.send_message(BuildRequest(BuildType::preview, network.get()));
+	GatedTestNode::open = true;
+	buildSystem->waitForBuild();
+	
+	auto const& impl = *network->nodes[node].implementation;
+	CHECK(impl.previewBuilt());
+	CHECK(impl.built());
+}
@@ -0,0 +1,42 @@
+#include <Catch2/Catch2.hpp>
+
+#include <sstream>
+
+#include "Core/BuildTrace.hpp"
+
+using namespace worldmachine;
+using namespace std::chrono_literals;
+
+TEST_CASE("BuildTrace per node totals and Chrome trace") {
+	BuildTrace trace;
+	auto const t0 = BuildTrace::Clock::now();
+	trace.begin = t0;
+	trace.planned = t0 + 1ms;
+	trace.end = t0 + 10ms;
+	trace.workerCount = 2;
+	trace.nodes.push_back({ .name = "A \"quoted\"", .begin = t0 + 1ms });
+	trace.nodes.push_back({ .name = "B", .begin = t0 + 4ms });
+	trace.jobs.push_back({ 1, 0, { 0, 8 }, t0 + 4ms, t0 + 5ms, t0 + 8ms });
+	trace.jobs.push_back({ 0, 0, { 0, 4 }, t0 + 1ms, t0 + 1ms, t0 + 3ms });
+	trace.jobs.push_back({ 0, 1, { 4, 8 }, t0 + 1ms, t0 + 2ms, t0 + 4ms });
+	trace.jobs.push_back({ 1, BuildTrace::Job::buildThread, { 8, 9 }, t0 + 4ms, t0 + 4ms, t0 + 5ms });
+	trace.summarize();
+
+	CHECK(trace.jobs.front().node == 0);
+	CHECK(trace.jobs.back().node == 1);
+	CHECK(trace.nodes[0].jobCount == 2);
+	CHECK(trace.nodes[0].jobTime == 4ms);
+	CHECK(trace.nodes[0].queueWaitTime == 1ms);
+	CHECK(trace.nodes[0].end == t0 + 4ms);
+	CHECK(trace.nodes[1].jobCount == 2);
+	CHECK(trace.nodes[1].queueWaitTime == 1ms);
+
+	std::stringstream str;
+	trace.writeChromeTrace(str);
+	auto const json = str.str();
+	CHECK(json.find("\"traceEvents\"") != std::string::npos);
+	CHECK(json.find("A \\\"quoted\\\"") != std::string::npos);
+	CHECK(json.find("Worker 1") != std::string::npos);
+	/// Jobs off the worker pool are on the build thread
+	CHECK(json.find(R"("cat": "job", "tid": 0, "name": "B")") != std::string::npos);
+}
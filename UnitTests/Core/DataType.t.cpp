@@ -1,3 +1,5 @@
+#include <cmath>
+#include <limits>
 #include <Catch2/Catch2.hpp>
 
 #include "Core/DataType.hpp"
@@ -11,4 +13,32 @@ TEST_CASE("dataTypeSize") {
 	CHECK(dataTypeSize(DataType::float3) == 3 * sizeof(float));
 	CHECK(dataTypeSize(DataType::float4) == 4 * sizeof(float));
 	CHECK(dataTypeSize(DataType::integer) == sizeof(int));
+	CHECK(dataTypeSize(DataType::float16) == 2);
+	CHECK(dataTypeSize(DataType::unorm16) == 2);
+}
+
+TEST_CASE("Float16 conversion") {
+	for (float x: { 0.0f, 1.0f, -2.5f, 0.333251953125f, 65504.0f, 0x1p-24f, 0x1p-14f }) {
+		CHECK(float(Float16(x)) == x);
+	}
+	CHECK(Float16(-0.0f).bits == 0x8000);
+	CHECK(Float16(1.0f).bits == 0x3C00);
+	/// Halfway between 1 and the next half rounds to even
+	CHECK(Float16(1.0f + 0x1p-11f).bits == 0x3C00);
+	CHECK(Float16(1.0f + 3 * 0x1p-11f).bits == 0x3C02);
+	CHECK(Float16(65520.0f).bits == 0x7C00);
+	CHECK(Float16(1e-9f).bits == 0);
+	CHECK(std::isnan(float(Float16(std::numeric_limits<float>::quiet_NaN()))));
+	CHECK(std::isinf(float(Float16(std::numeric_limits<float>::infinity()))));
+}
+
+TEST_CASE("UNorm16 conversion") {
+	CHECK(UNorm16(0.0f).bits == 0);
+	CHECK(UNorm16(1.0f).bits == 65535);
+	CHECK(UNorm16(-1.0f).bits == 0);
+	CHECK(UNorm16(2.0f).bits == 65535);
+	CHECK(UNorm16(std::numeric_limits<float>::quiet_NaN()).bits == 0);
+	for (float x: { 0.1f, 0.5f, 0.9f }) {
+		CHECK(std::abs(float(UNorm16(x)) - x) <= 0.5f / 65535);
+	}
 }
@@ -3,6 +3,8 @@
 #include <Catch2/Catch2.hpp>
 
 #include "Core/Image/Image.hpp"
+#include "Core/Image/ImagePool.hpp"
+#include "Core/Image/TiledImage.hpp"
 
 #include <utl/utility.hpp>
 #include <utl/test/terminates.hpp>
@@ -24,3 +26,115 @@ TEST_CASE("imageHash") {
 	
 	
 }
+
+TEST_CASE("ImagePool recycles buffers") {
+	using namespace worldmachine;
+	auto& pool = ImagePool::instance();
+	
+	Image a(DataType::float1);
+	pool.allocate(a, { 16, 16 });
+	a.data()[3] = 1;
+	float const* const storage = a.data();
+	pool.release(a);
+	CHECK(a.empty());
+	
+	Image b(DataType::float1);
+	pool.allocate(b, { 16, 16 });
+	CHECK(b.data() == storage);
+	CHECK(std::all_of(b.begin(), b.end(), [](float x) { return x == 0; }));
+	pool.release(b);
+}
+
+TEST_CASE("Image storage size per data type") {
+	using namespace worldmachine;
+	CHECK(Image::storageSize(DataType::float1, { 4, 2 }) == 8);
+	CHECK(Image::storageSize(DataType::float2, { 4, 2 }) == 16);
+	CHECK(Image::storageSize(DataType::float3, { 4, 2 }) == 24);
+	CHECK(Image::storageSize(DataType::float4, { 4, 2 }) == 32);
+	CHECK(Image::storageSize(DataType::float16, { 4, 2 }) == 4);
+	CHECK(Image::storageSize(DataType::unorm16, { 3, 1 }) == 2);
+}
+
+TEST_CASE("decodeImage converts compact images to float1") {
+	using namespace worldmachine;
+	Image compact(DataType::unorm16, { 5, 3 });
+	ImageView<UNorm16> view(compact);
+	for (std::size_t i = 0; i < 15; ++i) {
+		view.data()[i] = float(i) / 14;
+	}
+	Image const decoded = decodeImage(compact);
+	CHECK(decoded.dataType() == DataType::float1);
+	REQUIRE(decoded.size() == compact.size());
+	for (std::size_t i = 0; i < 15; ++i) {
+		CHECK(std::abs(decoded.data()[i] - float(i) / 14) <= 1.0f / 65535);
+	}
+}
+
+TEST_CASE("ImageView::forEachTile visits every pixel once") {
+	using namespace worldmachine;
+	Image img(DataType::float1, { 37, 21 });
+	ImageView<float> view(img);
+	view.forEachTile({ 8, 8 }, [](ImageTile<float> tile) {
+		CHECK(tile.size().x <= 8);
+		CHECK(tile.size().y <= 8);
+		for (std::size_t j = 0; j < tile.size().y; ++j) {
+			for (float& x: tile.row(j)) {
+				x += 1;
+			}
+		}
+	});
+	CHECK(std::all_of(img.begin(), img.end(), [](float x) { return x == 1; }));
+}
+
+TEST_CASE("TiledImage round trip with eviction") {
+	using namespace worldmachine;
+	auto& cache = TileCache::instance();
+	std::size_t const budget = cache.budget();
+	/// Two tiles of 16 x 16 float2
+	cache.setBudget(2 * 16 * 16 * 2 * sizeof(float));
+	{
+		Image source(DataType::float2, { 50, 40 });
+		for (std::size_t i = 0; i < source.storageSize(); ++i) {
+			source.data()[i] = float(i);
+		}
+		TiledImage tiled(DataType::float2, { 50, 40 }, 16);
+		CHECK(tiled.tileCount() == mtl::usize2(4, 3));
+		tiled.copyFrom(source);
+		CHECK(cache.residentBytes() <= cache.budget());
+		
+		tiled.forEachTile<mtl::float2>([](ImageTile<mtl::float2> tile) {
+			for (std::size_t j = 0; j < tile.size().y; ++j) {
+				for (auto& x: tile.row(j)) {
+					x *= 2;
+				}
+			}
+		});
+		
+		Image result(DataType::float2, { 50, 40 });
+		tiled.copyTo(result);
+		for (std::size_t i = 0; i < source.storageSize(); ++i) {
+			REQUIRE(result.data()[i] == 2 * source.data()[i]);
+		}
+	}
+	CHECK(cache.residentBytes() == 0);
+	cache.setBudget(budget);
+}
+
+TEST_CASE("TiledImage round trip of a compact data type") {
+	using namespace worldmachine;
+	/// Odd width, so rows start in the middle of a float
+	mtl::usize2 const size = { 37, 21 };
+	Image source(DataType::float16, size);
+	ImageView<Float16> sourceView(source);
+	for (std::size_t i = 0; i < size.fold(utl::multiplies); ++i) {
+		sourceView.data()[i] = float(i);
+	}
+	TiledImage tiled(DataType::float16, size, 16);
+	tiled.copyFrom(source);
+	Image result(DataType::float16, size);
+	tiled.copyTo(result);
+	ImageView<Float16> resultView(result);
+	for (std::size_t i = 0; i < size.fold(utl::multiplies); ++i) {
+		REQUIRE(resultView.data()[i].bits == sourceView.data()[i].bits);
+	}
+}
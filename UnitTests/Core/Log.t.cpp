@@ -0,0 +1,79 @@
+#include <Catch2/Catch2.hpp>
+
+#include <algorithm>
+#include <thread>
+
+#include "Core/BoundedQueue.hpp"
+#include "Core/Log.hpp"
+
+using namespace worldmachine;
+
+TEST_CASE("BoundedQueue single thread") {
+	BoundedQueue<int> queue(4);
+	CHECK(queue.capacity() == 4);
+	for (int i = 0; i < 4; ++i) {
+		CHECK(queue.tryPush(int(i)));
+	}
+	CHECK(!queue.tryPush(4));
+	CHECK(queue.pushed() == 4);
+	int value = -1;
+	for (int i = 0; i < 4; ++i) {
+		REQUIRE(queue.tryPop(value));
+		CHECK(value == i);
+	}
+	CHECK(!queue.tryPop(value));
+	CHECK(queue.tryPush(5));
+	REQUIRE(queue.tryPop(value));
+	CHECK(value == 5);
+}
+
+TEST_CASE("BoundedQueue many producers") {
+	int const producerCount = 4;
+	int const itemsPerProducer = 10000;
+	BoundedQueue<int> queue(64);
+	utl::vector<std::thread> producers;
+	for (int p = 0; p < producerCount; ++p) {
+		producers.emplace_back([&, p]{
+			for (int i = 0; i < itemsPerProducer; ++i) {
+				while (!queue.tryPush(p * itemsPerProducer + i)) {
+					std::this_thread::yield();
+				}
+			}
+		});
+	}
+	/// Items of one producer arrive in the order it pushed them
+	utl::vector<int> last(producerCount, -1);
+	int received = 0;
+	while (received < producerCount * itemsPerProducer) {
+		int value;
+		if (!queue.tryPop(value)) {
+			std::this_thread::yield();
+			continue;
+		}
+		int const p = value / itemsPerProducer;
+		CHECK(value % itemsPerProducer > last[p]);
+		last[p] = value % itemsPerProducer;
+		++received;
+	}
+	for (auto& t: producers) {
+		t.join();
+	}
+	CHECK(std::all_of(last.begin(), last.end(), [&](int i) { return i == itemsPerProducer - 1; }));
+}
+
+TEST_CASE("postLog reaches globalLog after flushLog") {
+	postLog({ .level = utl::log_level::warning, .message = "Log.t.cpp test message" });
+	flushLog();
+	auto [lock, logs] = globalLog();
+	CHECK(std::any_of(logs.begin(), logs.end(), [](LogRecord const& record) {
+		return record.message == "Log.t.cpp test message";
+	}));
+}
+
+TEST_CASE("Log levels of categories") {
+	CHECK(logEnabled(LogCategory::general, utl::log_level::error));
+	CHECK(logEnabled(LogCategory::kernel, utl::log_level::warning));
+#if WM_LOGLEVEL_KERNEL == 0
+	CHECK(!logEnabled(LogCategory::kernel, utl::log_level::trace));
+#endif
+}
@@ -2,6 +2,8 @@
 
 #include "Core/Network/Network.hpp"
 
+#include "MockNetworkBuilder.t.hpp"
+
 using namespace worldmachine;
 
 TEST_CASE("") {
@@ -11,3 +13,82 @@ TEST_CASE("") {
 	
 	
 }
+
+TEST_CASE("Network ID lookup") {
+	test::MockNetworkBuilder builder;
+	builder.addNodes(5);
+	builder.addEdge(0, 1);
+	builder.addEdge(1, 2);
+	auto network = builder.get();
+	
+	auto checkIndices = [&]{
+		for (std::size_t i = 0; i < network->nodeCount(); ++i) {
+			CHECK(network->indexFromID(network->IDFromIndex(i)) == (long)i);
+		}
+	};
+	checkIndices();
+	
+	auto const removedID = network->IDFromIndex(1);
+	network->removeNode(std::size_t(1));
+	CHECK(network->nodeCount() == 4);
+	CHECK(network->indexFromID(removedID) == -1);
+	checkIndices();
+	
+	network->moveToTop(2);
+	checkIndices();
+	
+	network->clear();
+	CHECK(network->indexFromID(removedID) == -1);
+}
+
+TEST_CASE("Network adjacency follows edge edits") {
+	test::MockNetworkBuilder builder;
+	builder.addNodes(3);
+	builder.addEdge(0, 1);
+	builder.addEdge(0, { 2, 1 });
+	builder.addEdge(1, 2);
+	auto network = builder.get();
+	
+	auto neighbours = [](auto const& offsets, auto const& indices, std::size_t nodeIndex) {
+		return utl::vector<std::uint32_t>(indices.begin() + offsets[nodeIndex], indices.begin() + offsets[nodeIndex + 1]);
+	};
+	{
+		auto const& adjacency = network->adjacency();
+		CHECK(neighbours(adjacency.downstreamOffsets, adjacency.downstreamIndices, 0) == utl::vector<std::uint32_t>{ 1, 2 });
+		CHECK(neighbours(adjacency.upstreamOffsets, adjacency.upstreamIndices, 2) == utl::vector<std::uint32_t>{ 0, 1 });
+	}
+	
+	network->removeNode(std::size_t(1));
+	{
+		auto const& adjacency = network->adjacency();
+		CHECK(neighbours(adjacency.downstreamOffsets, adjacency.downstreamIndices, 0) == utl::vector<std::uint32_t>{ 1 });
+		CHECK(neighbours(adjacency.upstreamOffsets, adjacency.upstreamIndices, 1) == utl::vector<std::uint32_t>{ 0 });
+	}
+}
+
+TEST_CASE("Network leaves and roots follow edge edits") {
+	test::MockNetworkBuilder builder;
+	builder.addNodes(4);
+	builder.addEdge(0, 1);
+	builder.addEdge(1, 2);
+	builder.addEdge(0, { 3, 1 });
+	auto network = builder.get();
+	
+	using Indices = utl::small_vector<std::size_t>;
+	CHECK(network->gatherRootNodes() == Indices{ 0 });
+	CHECK(network->gatherLeafNodes() == Indices{ 2, 3 });
+	CHECK(network->collectNodeEdges(3).inputEdges[1].present);
+	
+	/// Connecting a pin that already has an edge replaces that edge.
+	network->addEdge({ 2, 0, PinKind::output }, { 3, 1, PinKind::input });
+	CHECK(network->edgeCount() == 3);
+	CHECK(network->gatherLeafNodes() == Indices{ 3 });
+	
+	network->removeEdge(0);
+	CHECK(network->gatherRootNodes() == Indices{ 0, 1 });
+	CHECK(network->gatherLeafNodes() == Indices{ 0, 3 });
+	
+	network->removeNode(std::size_t(2));
+	CHECK(network->gatherRootNodes() == Indices{ 0, 1, 2 });
+	CHECK(!network->collectNodeEdges(2).inputEdges[1].present);
+}
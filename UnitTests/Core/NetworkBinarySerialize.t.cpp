@@ -0,0 +1,319 @@
+#include <Catch2/Catch2.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <numeric>
+#include <sstream>
+
+#include "Core/BuildJob.hpp"
+#include "Core/Registry.hpp"
+#include "Core/Network/Network.hpp"
+#include "Core/Network/NetworkSerialize.hpp"
+#include "Core/Network/NodeDependencyMap.hpp"
+
+using namespace worldmachine;
+
+namespace {
+
+	class SerializeTestNode: public ImageNodeImplementationT<SerializeTestNode, "Serialize Test Node"> {
+	public:
+		SerializeTestNode() {
+			serializer().addMember(&value, "Value");
+		}
+		bool displayControls() override { return false; }
+		BuildJob makeBuildJob(NodeDependencyMap) override { return {}; }
+		static NodeDescriptor staticDescriptor() {
+			return {
+				.category = NodeCategory::filter,
+				.pinDescriptorArray = {
+					.input = { { "Input", DataType::float1 } },
+					.output = { { "Height", DataType::float1 }, { "Color", DataType::float3 } }
+				}
+			};
+		}
+
+		float value = 0;
+	};
+
+	WM_RegisterNode(SerializeTestNode);
+
+	/// Same layout as in NetworkBinarySerialize.cpp
+	struct ImageTableEntry {
+		std::uint64_t nodeIndex;
+		std::uint32_t buildType;
+		std::uint32_t outputIndex;
+		std::uint32_t dataType;
+		std::uint32_t reserved;
+		std::uint64_t width, height;
+		std::uint64_t offset;
+		std::uint64_t byteSize;
+	};
+
+	constexpr std::size_t headerSize = 16;
+	constexpr std::size_t chunkHeaderSize = 16;
+
+	std::filesystem::path testFilePath() {
+		return std::filesystem::temp_directory_path() / "NetworkBinarySerializeTest.wmnet";
+	}
+
+	std::string readFile(std::filesystem::path const& path) {
+		std::ifstream file(path, std::ios::binary);
+		std::stringstream sstr;
+		sstr << file.rdbuf();
+		return sstr.str();
+	}
+
+	void writeFile(std::filesystem::path const& path, std::string_view data) {
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		file.write(data.data(), std::streamsize(data.size()));
+	}
+
+	template <typename T>
+	void put(std::string& data, T const& value) {
+		data.append(reinterpret_cast<char const*>(&value), sizeof(T));
+	}
+
+	template <typename T>
+	void putAt(std::string& data, std::size_t position, T const& value) {
+		std::memcpy(data.data() + position, &value, sizeof(T));
+	}
+
+	std::uint32_t fourCC(char const (&tag)[5]) {
+		return std::uint32_t(tag[0]) | std::uint32_t(tag[1]) << 8 | std::uint32_t(tag[2]) << 16 | std::uint32_t(tag[3]) << 24;
+	}
+
+	/// Position of the payload of the chunk with 'tag'
+	std::size_t findChunk(std::string const& data, char const (&tag)[5]) {
+		std::uint32_t chunkCount;
+		std::memcpy(&chunkCount, data.data() + 12, sizeof(chunkCount));
+		std::size_t position = headerSize;
+		for (std::uint32_t i = 0; i < chunkCount; ++i) {
+			std::uint32_t chunkTag;
+			std::uint64_t size;
+			std::memcpy(&chunkTag, data.data() + position, sizeof(chunkTag));
+			std::memcpy(&size, data.data() + position + 8, sizeof(size));
+			if (chunkTag == fourCC(tag)) {
+				return position + chunkHeaderSize;
+			}
+			position += chunkHeaderSize + size;
+		}
+		FAIL("No chunk " << tag);
+		return 0;
+	}
+
+	std::size_t addTestNode(Network& network, std::string name, mtl::float3 position, float value) {
+		auto desc = Registry::instance().createDescriptorFromID(SerializeTestNode::staticID());
+		desc.name = std::move(name);
+		desc.position = position;
+		std::size_t const nodeIndex = network.addNode(desc);
+		static_cast<SerializeTestNode&>(*network.nodes[nodeIndex].implementation).value = value;
+		return nodeIndex;
+	}
+
+	/// Output 'i' counts up from 1000 * i
+	void setTestOutputs(Network& network, std::size_t nodeIndex, BuildType type, mtl::usize2 size) {
+		auto* const impl = static_cast<ImageNodeImplementation*>(network.nodes[nodeIndex].implementation.get());
+		for (std::size_t i = 0; i < 2; ++i) {
+			impl->setLazyOutput(type, i, size, [i](Image& image) {
+				std::iota(image.begin(), image.end(), 1000.0f * i);
+				return true;
+			});
+		}
+	}
+
+	void checkTestOutputs(Network const& network, std::size_t nodeIndex, BuildType type, mtl::usize2 size) {
+		auto const* const impl = static_cast<ImageNodeImplementation const*>(network.nodes[nodeIndex].implementation.get());
+		for (std::size_t i = 0; i < 2; ++i) {
+			Image const& image = impl->getImage(i, type);
+			REQUIRE(image.size() == size);
+			for (std::size_t j = 0; auto value: image) {
+				REQUIRE(value == 1000.0f * i + j++);
+			}
+		}
+	}
+
+}
+
+TEST_CASE("Binary network round trip") {
+	auto const path = testFilePath();
+	auto network = Network::create();
+	std::size_t const a = addTestNode(*network, "A", { 1, 2, 3 }, 0.25f);
+	std::size_t const b = addTestNode(*network, "B", { -4, 5, 0 }, 0.5f);
+	network->addEdge({ a, 0, PinKind::output }, { b, 0, PinKind::input });
+	setTestOutputs(*network, a, BuildType::highResolution, { 8, 4 });
+	setTestOutputs(*network, a, BuildType::preview, { 4, 2 });
+
+	NetworkFileInfo const info = { .resolution = mtl::usize2(64, 32), .previewResolution = mtl::usize2(16, 8) };
+	bool const embed = GENERATE(true, false);
+	REQUIRE(saveNetworkBinary(*network, path, info, embed));
+
+	auto loaded = Network::create();
+	NetworkFileInfo loadedInfo;
+	REQUIRE(loadNetworkFile(*loaded, path, &loadedInfo));
+
+	REQUIRE(loaded->nodeCount() == 2);
+	CHECK(loaded->nodes[0].name == "A");
+	CHECK(loaded->nodes[1].name == "B");
+	CHECK(loaded->nodes[1].position.x == -4);
+	CHECK(loaded->nodes[1].position.y == 5);
+	CHECK(static_cast<SerializeTestNode&>(*loaded->nodes[0].implementation).value == 0.25f);
+	CHECK(static_cast<SerializeTestNode&>(*loaded->nodes[1].implementation).value == 0.5f);
+	REQUIRE(loaded->edgeCount() == 1);
+	CHECK(loaded->edges[0].beginNodeIndex == 0);
+	CHECK(loaded->edges[0].endNodeIndex == 1);
+	CHECK(loadedInfo.resolution == info.resolution);
+	CHECK(loadedInfo.previewResolution == info.previewResolution);
+
+	auto const* const implA = loaded->nodes[0].implementation.get();
+	CHECK(implA->built() == embed);
+	CHECK(implA->previewBuilt() == embed);
+	CHECK(!loaded->nodes[1].implementation->built());
+
+	if (embed) {
+		SECTION("Embedded images are read on first access") {
+			checkTestOutputs(*loaded, 0, BuildType::highResolution, { 8, 4 });
+			checkTestOutputs(*loaded, 0, BuildType::preview, { 4, 2 });
+		}
+		SECTION("Embedded images are not read while loading") {
+			std::filesystem::remove(path);
+			auto const* const impl = static_cast<ImageNodeImplementation const*>(implA);
+			Image const& image = impl->highResImage(0);
+			/// The image is still there, but zeroed as the file is gone.
+			REQUIRE(image.size() == mtl::usize2(8, 4));
+			CHECK(std::all_of(image.begin(), image.end(), [](float x) { return x == 0; }));
+		}
+	}
+	std::filesystem::remove(path);
+}
+
+TEST_CASE("Binary network version 1 image sizes") {
+	auto const path = testFilePath();
+	auto const buildType = std::uint32_t(utl::to_underlying(BuildType::highResolution));
+	auto const float1 = std::uint32_t(utl::to_underlying(DataType::float1));
+	auto const float3 = std::uint32_t(utl::to_underlying(DataType::float3));
+	mtl::usize2 const size = { 3, 2 };
+	std::size_t const pixels = size.x * size.y;
+
+	std::string nodes;
+	put(nodes, std::uint64_t(1));
+	put(nodes, std::uint64_t(SerializeTestNode::staticID().value()));
+	put(nodes, std::uint64_t(1));
+	nodes += "A";
+	put(nodes, 0.0f);
+	put(nodes, 0.0f);
+	put(nodes, 0.0f);
+	put(nodes, std::uint64_t(0));
+
+	std::string edges;
+	put(edges, std::uint64_t(0));
+
+	/// Version 1 sized images by the numeric value of the data type, 4 floats
+	/// per pixel for float3. The pixels come first, the rest is padding.
+	ImageTableEntry height = { 0, buildType, 0, float1, 0, size.x, size.y, 0, pixels * sizeof(float) };
+	ImageTableEntry color  = { 0, buildType, 1, float3, 0, size.x, size.y, 0, pixels * 4 * sizeof(float) };
+	std::string table;
+	put(table, std::uint64_t(2));
+	std::size_t const tablePosition = table.size();
+	put(table, height);
+	put(table, color);
+
+	std::string file = "WMNETBIN";
+	put(file, std::uint32_t(1));
+	put(file, std::uint32_t(4));
+	auto addChunk = [&](char const (&tag)[5], std::string const& payload) {
+		put(file, fourCC(tag));
+		put(file, std::uint32_t(0));
+		put(file, std::uint64_t(payload.size()));
+		file += payload;
+	};
+	addChunk("NODE", nodes);
+	addChunk("EDGE", edges);
+	std::size_t const tablePayload = file.size() + chunkHeaderSize;
+	addChunk("IMGT", table);
+	put(file, fourCC("IMGD"));
+	put(file, std::uint32_t(0));
+	put(file, std::uint64_t(height.byteSize + color.byteSize));
+	height.offset = file.size();
+	for (std::size_t i = 0; i < pixels; ++i) {
+		put(file, float(i));
+	}
+	color.offset = file.size();
+	for (std::size_t i = 0; i < pixels * 4; ++i) {
+		put(file, i < pixels * 3 ? 1000.0f + i : -1.0f);
+	}
+	putAt(file, tablePayload + tablePosition, height);
+	putAt(file, tablePayload + tablePosition + sizeof(ImageTableEntry), color);
+
+	SECTION("Padding is skipped") {
+		writeFile(path, file);
+		auto loaded = Network::create();
+		REQUIRE(loadNetworkFile(*loaded, path));
+		REQUIRE(loaded->nodeCount() == 1);
+		REQUIRE(loaded->nodes[0].implementation->built());
+		checkTestOutputs(*loaded, 0, BuildType::highResolution, size);
+	}
+	SECTION("Padded sizes are invalid in later versions") {
+		putAt(file, 8, std::uint32_t(2));
+		writeFile(path, file);
+		auto loaded = Network::create();
+		REQUIRE(loadNetworkFile(*loaded, path));
+		REQUIRE(loaded->nodeCount() == 1);
+		CHECK(!loaded->nodes[0].implementation->built());
+	}
+	std::filesystem::remove(path);
+}
+
+TEST_CASE("Binary network rejects corrupt files") {
+	auto const path = testFilePath();
+	auto network = Network::create();
+	std::size_t const a = addTestNode(*network, "A", { 0, 0, 0 }, 1);
+	std::size_t const b = addTestNode(*network, "B", { 0, 0, 0 }, 2);
+	network->addEdge({ a, 0, PinKind::output }, { b, 0, PinKind::input });
+	setTestOutputs(*network, a, BuildType::highResolution, { 8, 4 });
+	REQUIRE(saveNetworkBinary(*network, path, {}, true));
+	std::string const original = readFile(path);
+
+	auto load = [&](std::string_view data) {
+		writeFile(path, data);
+		auto loaded = Network::create();
+		return loadNetworkFile(*loaded, path);
+	};
+	REQUIRE(load(original));
+
+	SECTION("Truncated") {
+		/// Past the magic, shorter files are tried as YAML.
+		for (std::size_t size = 8; size < original.size(); size += 7) {
+			INFO("Truncated to " << size << " of " << original.size() << " bytes");
+			CHECK(!load(std::string_view(original).substr(0, size)));
+		}
+	}
+	SECTION("Newer version") {
+		std::string data = original;
+		putAt(data, 8, std::uint32_t(1000));
+		CHECK(!load(data));
+	}
+	SECTION("Chunk larger than the file") {
+		std::string data = original;
+		putAt(data, headerSize + 8, std::uint64_t(original.size()));
+		CHECK(!load(data));
+	}
+	SECTION("Node count larger than the chunk") {
+		std::string data = original;
+		putAt(data, findChunk(data, "NODE"), std::uint64_t(1) << 40);
+		CHECK(!load(data));
+	}
+	SECTION("Images outside of the file are ignored") {
+		std::string data = original;
+		std::size_t const entry = findChunk(data, "IMGT") + sizeof(std::uint64_t);
+		putAt(data, entry + offsetof(ImageTableEntry, offset), std::uint64_t(original.size()));
+		writeFile(path, data);
+		auto loaded = Network::create();
+		REQUIRE(loadNetworkFile(*loaded, path));
+		REQUIRE(loaded->nodeCount() == 2);
+		/// One output is missing, so neither counts.
+		CHECK(!loaded->nodes[0].implementation->built());
+	}
+	std::filesystem::remove(path);
+}
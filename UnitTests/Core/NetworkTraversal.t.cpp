@@ -3,57 +3,11 @@
 #include "Core/Network/Network.hpp"
 #include "Core/Network/NetworkTraversal.hpp"
 
+#include "MockNetworkBuilder.t.hpp"
+
 using namespace worldmachine;
 
-namespace {
-	struct MockNetworkBuilder {
-		
-		struct PinID {
-			PinID(std::size_t nodeIndex, std::size_t pinIndex = 0):
-				nodeIndex(nodeIndex),
-				pinIndex(pinIndex)
-			{}
-			std::size_t nodeIndex;
-			std::size_t pinIndex;
-		};
-		
-		MockNetworkBuilder(): network(Network::create()) {
-			desc = {
-				.pinDescriptorArray = {
-					.input = {
-						PinDescriptor{ "", DataType::float1 },
-						PinDescriptor{ "", DataType::float1 }
-					},
-					.output = {
-						PinDescriptor{ "", DataType::float1 }
-					}
-				}
-			};
-		}
-		
-		utl::unique_ref<Network> get() { return std::move(network); }
-		
-		void addNodes(std::size_t size) {
-			for (std::size_t i = 0; i < size; ++i) {
-				addNode();
-			}
-		}
-		
-		void addNode(std::string_view name = {}) {
-			desc.name = name;
-			network->addNode(desc);
-		}
-		
-		void addEdge(PinID from, PinID to) {
-			network->addEdge(PinIndex{ from.nodeIndex, from.pinIndex, PinKind::output },
-							 PinIndex{ to.nodeIndex, to.pinIndex, PinKind::input });
-		}
-		
-	private:
-		utl::unique_ref<Network> network;
-		NodeDescriptor desc;
-	};
-}
+using test::MockNetworkBuilder;
 
 TEST_CASE("Network Traversal simple") {
 	MockNetworkBuilder builder;
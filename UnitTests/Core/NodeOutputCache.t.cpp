@@ -0,0 +1,56 @@
+#include <Catch2/Catch2.hpp>
+
+#include <array>
+#include <numeric>
+
+#include "Core/NodeOutputCache.hpp"
+
+using namespace worldmachine;
+
+static std::filesystem::path testCacheDirectory() {
+	return std::filesystem::temp_directory_path() / "Worldmachine" / "NodeCacheTest";
+}
+
+TEST_CASE("NodeOutputCache round trip") {
+	NodeOutputCache cache(testCacheDirectory());
+	cache.clear();
+
+	std::array<Image, 2> outputs = { Image(DataType::float1, { 8, 4 }), Image(DataType::float2, { 8, 4 }) };
+	for (auto& image: outputs) {
+		std::iota(image.begin(), image.end(), 0.5f);
+	}
+	auto const key = NodeOutputCache::makeKey("Implementation: 1\nSeed: 42\n");
+	cache.store(key, std::span<Image const>(outputs));
+
+	std::array<Image, 2> loaded = { Image(DataType::float1, { 8, 4 }), Image(DataType::float2, { 8, 4 }) };
+	REQUIRE(cache.load(key, loaded));
+	for (std::size_t i = 0; i < outputs.size(); ++i) {
+		CHECK(std::equal(outputs[i].begin(), outputs[i].end(), loaded[i].begin(), loaded[i].end()));
+	}
+
+	SECTION("Different key misses") {
+		CHECK(!cache.load(NodeOutputCache::makeKey("Implementation: 1\nSeed: 43\n"), loaded));
+	}
+	SECTION("Different resolution misses") {
+		std::array<Image, 2> other = { Image(DataType::float1, { 4, 4 }), Image(DataType::float2, { 4, 4 }) };
+		CHECK(!cache.load(key, other));
+	}
+	SECTION("Trimmed when over capacity") {
+		cache.setCapacity(0);
+		CHECK(!cache.load(key, loaded));
+	}
+	SECTION("Store trims the least recently used entry") {
+		std::uintmax_t entrySize = 0;
+		for (auto const& entry: std::filesystem::directory_iterator(cache.directory())) {
+			entrySize += entry.file_size();
+		}
+		/// Room for one entry, keys of the same length give entries of the same size
+		cache.setCapacity(entrySize);
+		REQUIRE(cache.load(key, loaded));
+		auto const otherKey = NodeOutputCache::makeKey("Implementation: 1\nSeed: 44\n");
+		cache.store(otherKey, std::span<Image const>(outputs));
+		CHECK(cache.load(otherKey, loaded));
+		CHECK(!cache.load(key, loaded));
+	}
+	cache.clear();
+}
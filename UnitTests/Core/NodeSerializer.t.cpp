@@ -0,0 +1,42 @@
+#include <Catch2/Catch2.hpp>
+
+#include "Core/Network/NodeSerializer.hpp"
+
+using namespace worldmachine;
+
+TEST_CASE("NodeSerializer binary round trip") {
+	float scale = 2.5f;
+	int seed = 42;
+	bool invert = true;
+	NodeSerializer source;
+	source.addMember(&scale, "Scale");
+	source.addMember(&seed, "Seed");
+	source.addMember(&invert, "Invert");
+	std::string data;
+	source.serializeBinary(data);
+
+	SECTION("Members are matched by name") {
+		float loadedScale = 0;
+		int loadedSeed = 0;
+		bool loadedInvert = false;
+		NodeSerializer dest;
+		dest.addMember(&loadedInvert, "Invert");
+		dest.addMember(&loadedScale, "Scale");
+		dest.addMember(&loadedSeed, "Seed");
+		dest.deserializeBinary(data);
+		CHECK(loadedScale == scale);
+		CHECK(loadedSeed == seed);
+		CHECK(loadedInvert == invert);
+	}
+	SECTION("Unknown, mismatched and truncated entries are skipped") {
+		bool seedAsBool = false;
+		float missing = 7;
+		NodeSerializer dest;
+		dest.addMember(&seedAsBool, "Seed");
+		dest.addMember(&missing, "Missing");
+		dest.deserializeBinary(data);
+		dest.deserializeBinary(std::string_view(data).substr(0, data.size() - 1));
+		CHECK(seedAsBool == false);
+		CHECK(missing == 7);
+	}
+}
@@ -0,0 +1,60 @@
+#include <Catch2/Catch2.hpp>
+
+#include <cmath>
+#include <utl/vector.hpp>
+
+#include "Core/Image/PointwiseKernels.hpp"
+
+using namespace worldmachine;
+
+static float referenceCombine(CombinerMode mode, float s, float a, float b) {
+	auto mix = [](float x, float y, float t) { return x + (y - x) * t; };
+	switch (mode) {
+		case CombinerMode::avg:      return (1 - s) * a + s * b;
+		case CombinerMode::add:      return a + b * s;
+		case CombinerMode::multiply: return a * mix(1, b, s);
+		case CombinerMode::subtract: return a - b * s;
+		case CombinerMode::divide:   return a / mix(1, b, s);
+		case CombinerMode::min:      return std::min(a, mix(1, b, s));
+		case CombinerMode::max:      return std::max(a, mix(0, b, s));
+		case CombinerMode::pow:      return std::pow(a, mix(1, b, s));
+		case CombinerMode::screen:   return 1 - (1 - a) * (1 - b * s);
+		default:                     return 0;
+	}
+}
+
+TEST_CASE("Pointwise kernels") {
+	/// Not a multiple of any vector width, so the scalar tail runs too
+	std::size_t const count = 37;
+	utl::vector<float> a(count), b(count), dest(count);
+	for (std::size_t i = 0; i < count; ++i) {
+		a[i] = 0.1f + i * 0.01f;
+		b[i] = 0.9f - i * 0.013f;
+	}
+
+	SECTION("combine") {
+		for (int m = 0; m < (int)CombinerMode::COUNT; ++m) {
+			auto const mode = (CombinerMode)m;
+			combine(mode, 0.7f, a.data(), b.data(), dest.data(), count);
+			for (std::size_t i = 0; i < count; ++i) {
+				CHECK(dest[i] == Approx(referenceCombine(mode, 0.7f, a[i], b[i])));
+			}
+		}
+	}
+
+	SECTION("scaleOffset") {
+		scaleOffset(a.data(), dest.data(), count, 2, 1);
+		for (std::size_t i = 0; i < count; ++i) {
+			CHECK(dest[i] == Approx(a[i] * 2 + 1));
+		}
+	}
+
+	SECTION("interleave") {
+		utl::vector<float> interleaved(2 * count);
+		interleave(a.data(), b.data(), interleaved.data(), count);
+		for (std::size_t i = 0; i < count; ++i) {
+			CHECK(interleaved[2 * i] == a[i]);
+			CHECK(interleaved[2 * i + 1] == b[i]);
+		}
+	}
+}
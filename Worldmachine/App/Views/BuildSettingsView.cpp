@@ -2,6 +2,8 @@
 
 #include <imgui/imgui.h>
 #include <mtl/mtl.hpp>
+#include <limits>
+#include <filesystem>
 
 #include "Core/Network/Network.hpp"
 #include "Core/BuildSystem.hpp"
@@ -21,6 +23,44 @@ namespace worldmachine {
 			}
 		}
 		
+		bool rowPipelining = buildSystem->getRowPipelining();
+		if (ImGui::Checkbox("Pipeline Row Bands", &rowPipelining)) {
+			buildSystem->setRowPipelining(rowPipelining);
+		}
+
+		bool progressive = buildSystem->getProgressiveBuilds();
+		if (ImGui::Checkbox("Progressive Builds", &progressive)) {
+			buildSystem->setProgressiveBuilds(progressive);
+		}
+
+		bool cacheOutputs = buildSystem->getOutputCacheDirectory().has_value();
+		if (ImGui::Checkbox("Cache Node Outputs", &cacheOutputs) && !buildSystem->isBuilding()) {
+			buildSystem->setOutputCacheDirectory(cacheOutputs ? NodeOutputCache::defaultDirectory() : std::nullopt);
+		}
+		if (cacheOutputs) {
+			ImGui::SameLine();
+			if (ImGui::Button("Clear")) {
+				buildSystem->clearOutputCache();
+			}
+		}
+
+		bool writeTraces = buildSystem->getTracing();
+		if (ImGui::Checkbox("Write Build Traces", &writeTraces)) {
+			std::error_code ec;
+			auto const directory = std::filesystem::temp_directory_path(ec) / "worldmachine-traces";
+			buildSystem->setTracing(writeTraces && !ec);
+			buildSystem->setTraceDirectory(writeTraces && !ec ? std::optional(directory) : std::nullopt);
+		}
+		if (auto const directory = buildSystem->getTraceDirectory(); writeTraces && directory) {
+			ImGui::TextDisabled("%s", directory->string().c_str());
+		}
+
+		std::size_t const unlimited = std::numeric_limits<std::size_t>::max();
+		int budgetMB = buildSystem->getMemoryBudget() == unlimited ? 0 : int(buildSystem->getMemoryBudget() >> 20);
+		if (ImGui::InputInt("Memory Budget (MB, 0 = unlimited)", &budgetMB) && budgetMB >= 0) {
+			buildSystem->setMemoryBudget(budgetMB == 0 ? unlimited : std::size_t(budgetMB) << 20);
+		}
+
 		setResolution("Build Resolution", true);
 		setResolution("Preview Resolution", false);
 		
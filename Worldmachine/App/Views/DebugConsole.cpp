@@ -68,19 +68,19 @@ namespace worldmachine {
 			ImGui::TableHeadersRow();
 			
 			auto [lock, logs] = globalLog();
-			for (auto& logMessage: logs) {
+			for (auto& record: logs) {
 				ImGui::TableNextRow();
 				auto const& a = getWindow()->appearance();
 				auto textColor = [&](utl::log_level l) { return a.logTextColors[utl::log2((unsigned)l)]; };
-				columnItem(0, textColor(utl::log_level::trace), logMessage.logger_name);
-				columnItem(1, textColor(utl::log_level::trace), utl::time_in_HH_MM_SS_MMM(logMessage.time));
+				columnItem(0, textColor(utl::log_level::trace), logCategoryName(record.category));
+				columnItem(1, textColor(utl::log_level::trace), formatLogTime(record.time));
 				columnItem(2, textColor(utl::log_level::trace),
-						   logMessage.thread_id == std::this_thread::get_id() ?
-						   "main" : utl::format("{}", logMessage.thread_id));
-				columnItem(3, textColor(utl::log_level::trace), logMessage.source_info.file);
-				columnItem(4, textColor(utl::log_level::trace), "{}: {}", utl::qualified_function_name(logMessage.source_info.function),
-						   logMessage.source_info.line);
-				columnItem(5, textColor(logMessage.level), logMessage.message, true);
+						   record.threadID == std::this_thread::get_id() ?
+						   "main" : utl::format("{}", record.threadID));
+				columnItem(3, textColor(utl::log_level::trace), record.file);
+				columnItem(4, textColor(utl::log_level::trace), "{}: {}", utl::qualified_function_name(record.function),
+						   record.line);
+				columnItem(5, textColor(record.level), record.message, true);
 			}
 			if (currentLines != logs.size()) {
 				currentLines = logs.size();
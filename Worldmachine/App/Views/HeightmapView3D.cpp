@@ -37,6 +37,12 @@ namespace worldmachine {
 				renderer->updateHeightmap(img);
 			}
 		}
+		else if (isCompactDataType(img.dataType())) {
+			imageIsHeightmap = true;
+			if (!img.empty()) {
+				renderer->updateHeightmap(decodeImage(img));
+			}
+		}
 		else {
 			imageIsHeightmap = false;
 		}
@@ -46,12 +46,17 @@ namespace worldmachine {
 		// static cast because dynamic_cast has problems across shared lib boundaries.
 		// check above asserts the correct type
 		auto const* const activeImageNode = static_cast<ImageNodeImplementation const*>(activeNode);
+		
+		if (focusNodeID != activeImageNode->nodeID() || focusRegion != visibleRegion()) {
+			focusNodeID = activeImageNode->nodeID();
+			focusRegion = visibleRegion();
+			getWindow()->sendMessage(FocusRequest{ network(), focusNodeID, focusRegion });
+		}
 
-		if (activeImageNode->isBuilding()) {
-			if (activeImageNode->currentBuildType() == BuildType::preview &&
-				currentRenderedNodeID == activeImageNode->nodeID() &&
-				this->hasCachedImage())
-			{
+		bool const built = activeImageNode->built() || activeImageNode->previewBuilt();
+		if (activeImageNode->isBuilding() || (!built && network()->isBuilding())) {
+			/// Keeps showing the last level of a progressive build until the next one is done.
+			if (currentRenderedNodeID == activeImageNode->nodeID() && this->hasCachedImage()) {
 				displayImage();
 				return;
 			}
@@ -89,7 +94,7 @@ namespace worldmachine {
 	}
 	
 	void ImageDisplayView::maybeUpdateImage(Image const& img) {
-		auto const hash = worldmachine::imageHash({ img.data(), img.size().fold(utl::multiplies) },
+		auto const hash = worldmachine::imageHash(img.toFloatSpan(),
 												  1024 << 3);
 		if (this->imageHash != hash) {
 			this->imageHash = hash;
@@ -2,6 +2,8 @@
 
 #include "NodeView.hpp"
 
+#include "Core/BuildSystemFwd.hpp"
+
 namespace worldmachine {
 	
 	
@@ -22,12 +24,16 @@ namespace worldmachine {
 		virtual void updateImage(Image const&) = 0;
 		virtual void displayImage() = 0;
 		virtual bool hasCachedImage() const { return false; }
+		/// Part of the image that is visible, nullopt if all of it is.
+		virtual std::optional<BuildRegion> visibleRegion() const { return std::nullopt; }
 		
 		void maybeUpdateImage(Image const&);
 		
 	private:
 		std::size_t imageHash = 0;
 		utl::UUID currentRenderedNodeID;
+		utl::UUID focusNodeID;
+		std::optional<BuildRegion> focusRegion;
 	};
 	
 }
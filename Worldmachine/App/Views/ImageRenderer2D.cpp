@@ -53,6 +53,10 @@ namespace worldmachine {
 					return PixelFormatR32Float;
 				case DataType::float2:
 					return PixelFormatRG32Float;
+				case DataType::float16:
+					return PixelFormatR16Float;
+				case DataType::unorm16:
+					return PixelFormatR16Unorm;
 				
 				default:
 					return PixelFormatR32Float;
@@ -2,6 +2,7 @@
 
 #include <imgui/imgui.h>
 #include <mtl/mtl.hpp>
+#include <algorithm>
 
 #include "Core/Image/Image.hpp"
 
@@ -28,14 +29,58 @@ namespace worldmachine {
 	void ImageView2D::displayImage() {
 		usize2 const size = renderer->renderedImageSize();
 		auto const ratio = (double2)size / size.fold(utl::max);
-		auto const displaySize = ratio * (this->size() / ratio).fold(utl::min);
+		displaySize = ratio * (this->size() / ratio).fold(utl::min);
 		
+		float const extent = 0.5f / zoomFactor;
 		ImGui::SetCursorPos((this->size() - displaySize) / 2);
-		ImGui::Image(renderer->renderedImage(), displaySize);
+		ImGui::Image(renderer->renderedImage(), displaySize,
+					 ImVec2(center.x - extent, center.y - extent),
+					 ImVec2(center.x + extent, center.y + extent));
 	}
 	
 	bool ImageView2D::hasCachedImage() const {
 		return renderer->renderedImage() != nullptr;
 	}
 	
+	std::optional<BuildRegion> ImageView2D::visibleRegion() const {
+		if (zoomFactor == 1) {
+			return std::nullopt;
+		}
+		float const extent = 0.5f / zoomFactor;
+		return BuildRegion{ center - extent, center + extent };
+	}
+	
+	void ImageView2D::mouseDragged(MouseDragEvent event) {
+		pan(event.offset);
+	}
+	
+	void ImageView2D::scrollWheel(ScrollEvent event) {
+		if (event.isTrackpad) {
+			pan(-event.offset);
+		}
+		else {
+			zoom(utl::signed_pow(event.offset.y, 0.666) / 100);
+		}
+	}
+	
+	void ImageView2D::magnify(MagnificationEvent event) {
+		zoom(event.offset);
+	}
+	
+	void ImageView2D::pan(float2 offset) {
+		if (displaySize.x == 0 || displaySize.y == 0) {
+			return;
+		}
+		/// The image follows the mouse
+		center -= offset / (float2)displaySize / zoomFactor;
+		zoom(0);
+	}
+	
+	void ImageView2D::zoom(float offset) {
+		zoomFactor = std::clamp(zoomFactor + offset * zoomFactor, 1.0f, 64.0f);
+		/// Keep the visible part inside the image
+		float const extent = 0.5f / zoomFactor;
+		center = center.map([&](float c) { return std::clamp(c, extent, 1 - extent); });
+	}
+	
 }
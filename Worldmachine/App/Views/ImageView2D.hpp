@@ -3,6 +3,7 @@
 #include "ImageDisplayView.hpp"
 
 #include <utl/memory.hpp>
+#include <mtl/mtl.hpp>
 
 namespace worldmachine {
 	
@@ -18,8 +19,22 @@ namespace worldmachine {
 		void updateImage(Image const&) override;
 		void displayImage() override;
 		bool hasCachedImage() const override;
+		std::optional<BuildRegion> visibleRegion() const override;
+		
+		/// Input
+		void mouseDragged(MouseDragEvent) override;
+		void scrollWheel(ScrollEvent) override;
+		void magnify(MagnificationEvent) override;
+		
+		void pan(mtl::float2 offset);
+		void zoom(float offset);
+		
 	private:
 		utl::unique_ref<ImageRenderer2D> renderer;
+		/// In normalized image coordinates
+		mtl::float2 center = 0.5;
+		float zoomFactor = 1;
+		mtl::double2 displaySize = 0;
 	};
 	
 }
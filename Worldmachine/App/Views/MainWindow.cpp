@@ -36,6 +36,7 @@ namespace worldmachine {
 		buildSystem->setViewInvalidator([this]{
 			invalidate();
 		});
+		buildSystem->setProgressiveBuilds(true);
 		auto buildSystemListeners = buildSystem->makeListeners();
 		auto ids = getMessenger().register_listeners(buildSystemListeners.begin(), buildSystemListeners.end());
 		for (auto& id: ids) storeListenerID(std::move(id));
@@ -116,6 +117,8 @@ namespace worldmachine {
 			if (ImGui::MenuItem("Save as...")) {
 				showSaveFilePanel();
 			}
+			ImGui::Separator();
+			ImGui::MenuItem("Embed Images in .wmb Files", nullptr, &embedImages);
 			ImGui::EndMenu();
 		}
 		if (ImGui::BeginMenu("View")) {
@@ -183,6 +186,12 @@ namespace worldmachine {
 			return;
 		}
 		
+		if (currentFilePath->extension() == ".wmb") {
+			NetworkFileInfo const info{ buildSystem->getResolution(), buildSystem->getPreviewResolution() };
+			saveNetworkBinary(*network, *currentFilePath, info, embedImages);
+			return;
+		}
+		
 		std::fstream file(*currentFilePath, std::ios::out | std::ios::trunc);
 		if (!file) {
 			WM_Log(warning, "Failed to open file \"{}\"", currentFilePath->string());
@@ -202,15 +211,18 @@ namespace worldmachine {
 	
 	void MainWindow::openFile(std::string_view filename) {
 		currentFilePath = filename;
-		std::fstream file(filename, std::ios::in);
-		if (!file) {
-			WM_Log(warning, "Failed to open file \"{}\"", filename);
+		sendMessage(BuildCancelRequest{});
+		buildSystem->waitForBuild();
+		NetworkFileInfo info;
+		if (!loadNetworkFile(*network, *currentFilePath, &info)) {
 			return;
 		}
-		std::stringstream sstr;
-		sstr << file.rdbuf();
-		std::string contents = std::move(sstr).str();
-		deserializeNetwork(*network, contents);
+		if (info.resolution) {
+			buildSystem->setResolution(*info.resolution);
+		}
+		if (info.previewResolution) {
+			buildSystem->setPreviewResolution(*info.previewResolution);
+		}
 		
 		if (auto* view = dynamic_cast<NetworkView*>(findViewByName("Network View"))) {
 			view->onFileOpen();
@@ -32,6 +32,7 @@ namespace worldmachine {
 		utl::unique_ref<Network> network;
 		utl::unique_ref<BuildSystem> buildSystem;
 		std::optional<std::filesystem::path> currentFilePath;
+		bool embedImages = true;
 		
 #if WM_DEBUGLEVEL
 		bool _showImGuiDemo = false;
@@ -37,11 +37,9 @@ namespace worldmachine {
 		}
 		ImGui::Separator();
 		if (activeNode->displayControls()) {
-			if (network()->isBuilding()) {
-				getWindow()->sendMessage(BuildCancelRequest{});
-			}
-			network()->invalidateNodesDownstream(activeNode->nodeID());
-			
+			/// Cancels only the part of a running preview build that depends on this node.
+			/// The request below is queued and coalesced with further edits until then.
+			getWindow()->sendMessage(InvalidateRequest{ network(), activeNode->nodeID() });
 			getWindow()->sendMessage(BuildRequest{
 				BuildType::preview, network(), { activeDisplayNode->nodeID() }
 			});
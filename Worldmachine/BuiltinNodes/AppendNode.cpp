@@ -3,12 +3,15 @@
 #include <mtl/mtl.hpp>
 #include <imgui/imgui.h>
 
+#include "Core/Image/PointwiseKernels.hpp"
+
 using namespace mtl::short_types;
 
 namespace worldmachine {
 	
 	class AppendNode: public ImageNodeImplementationT<AppendNode, "Append"> {
 	public:
+		AppendNode() { setRowFootprint(0); }
 		bool displayControls() override { return false; };
 		BuildJob makeBuildJob(NodeDependencyMap dependencies) override;
 		static NodeDescriptor staticDescriptor();
@@ -23,11 +26,10 @@ namespace worldmachine {
 		ImageView<float2> dest = this->getBuildDest(0);
 		WM_Assert(dest.size() == inputA.size());
 		WM_Assert(dest.size() == inputB.size());
-		result.add([inputA, inputB, dest]{
-			std::size_t const flatSize = dest.size().fold(utl::multiplies);
-			for (std::size_t i = 0; i < flatSize; ++i) {
-				dest[i] = float2(inputA[i], inputB[i]);
-			}
+		static_assert(sizeof(float2) == 2 * sizeof(float));
+		addPointwiseJobs(result, dest.size(), [inputA, inputB, dest](std::size_t begin, std::size_t end) {
+			interleave(inputA.data() + begin, inputB.data() + begin,
+					   reinterpret_cast<float*>(dest.data() + begin), end - begin);
 		});
 		return result;
 	}
@@ -1,8 +1,22 @@
 #include "BlurNode.hpp"
 
+#include <imgui/imgui.h>
+
+#include "Core/Image/BlurKernels.hpp"
+
+using namespace mtl;
+
 namespace worldmachine {
 	WM_RegisterNode(BlurNode);
 	
+	BlurNode::BlurNode() {
+		/// 1: Gaussian, the outputs used to be left blank
+		setOutputVersion(1);
+		/// The input is read completely before the barrier, the output written after it.
+		setInPlaceInput(0);
+		serializer().addMember(&radius, "Radius");
+	}
+	
 	NodeDescriptor BlurNode::staticDescriptor() {
 		return {
 			.category = NodeCategory::filter,
@@ -13,17 +27,86 @@ namespace worldmachine {
 				},
 				.output = {
 					{ "Primary", DataType::float1 }
+				},
+				.parameterInput = {
+					{ "Radius", DataType::none }
 				}
 			}
 		};
 	}
 	
 	bool BlurNode::displayControls() {
-		return false;
+		return ImGui::DragFloat("Radius", &radius, 0.1, 0, 500);
+	}
+	
+	namespace {
+		
+		struct BuildData {
+			/// The image blurred along rows, stored transposed
+			utl::vector<float> transposed;
+		};
+		
+		/// Rows, or columns in the second pass, handled by one job. One band of the
+		/// transpose writes runs of this many floats.
+		constexpr std::size_t bandSize = 32;
+		
+		/// Blurs 'rowCount' rows of 'rowLength' pixels each and writes them transposed to 'dest'.
+		void blurBand(float const* source, float* dest, std::size_t destStride,
+					  std::size_t rowLength, std::size_t rowCount,
+					  std::array<std::size_t, gaussianBoxCount> const& radii,
+					  CancellationToken const& token)
+		{
+			utl::vector<float> band(rowLength * rowCount);
+			utl::vector<float> scratch(rowLength);
+			for (std::size_t i = 0; i < rowCount; ++i) {
+				if (token.cancelled()) {
+					return;
+				}
+				gaussianBlur(source + i * rowLength, band.data() + i * rowLength, rowLength, radii, scratch.data());
+			}
+			transpose(band.data(), rowLength, dest, destStride, { rowLength, rowCount });
+		}
+		
 	}
 	
-	BuildJob BlurNode::makeBuildJob(NodeDependencyMap) {
-		return {};
+	/// Both passes blur rows, the first one of the input and the second one of
+	/// the transposed result of the first. Blurring a column in place would read
+	/// one cache line per pixel.
+	BuildJob BlurNode::makeBuildJob(NodeDependencyMap dependencies) {
+		ImageView<float> dest = getBuildDest(0);
+		ImageView<float const> input = dependencies.getInput<float>(0);
+		WM_Assert(dest.size() == input.size());
+		usize2 const size = dest.size();
+		
+		float sigma = radius;
+		if (currentBuildType() == BuildType::preview) {
+			usize2 const prevRes = buildResolution(BuildType::preview);
+			usize2 const highRes = buildResolution(BuildType::highResolution);
+			sigma *= (float)prevRes.x / highRes.x;
+		}
+		auto const radii = gaussianBoxRadii(sigma);
+		
+		BuildJob job;
+		auto* const data = new BuildData{ utl::vector<float>(size.x * size.y) };
+		job.onCleanup([data]{
+			delete data;
+		});
+		
+		job.reserve((size.y + bandSize - 1) / bandSize + (size.x + bandSize - 1) / bandSize);
+		for (std::size_t y = 0; y < size.y; y += bandSize) {
+			std::size_t const rows = std::min(bandSize, size.y - y);
+			job.add([=](CancellationToken const& token) {
+				blurBand(&input(0, y), data->transposed.data() + y, size.y, size.x, rows, radii, token);
+			});
+		}
+		job.barrier();
+		for (std::size_t x = 0; x < size.x; x += bandSize) {
+			std::size_t const columns = std::min(bandSize, size.x - x);
+			job.add([=](CancellationToken const& token) {
+				blurBand(data->transposed.data() + x * size.y, &dest(x, 0), size.x, size.y, columns, radii, token);
+			});
+		}
+		return job;
 	}
 	
 }
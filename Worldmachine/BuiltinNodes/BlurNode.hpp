@@ -6,13 +6,16 @@ namespace worldmachine {
 	
 	class BlurNode: public ImageNodeImplementationT<BlurNode, "Blur"> {
 	public:
+		BlurNode();
+		
 		static NodeDescriptor staticDescriptor();
 		
 		bool displayControls() override;
 		BuildJob makeBuildJob(NodeDependencyMap) override;
 		
 	private:
-		
+		/// Standard deviation of the Gaussian in pixels at high resolution
+		float radius = 4;
 	};
 	
 }
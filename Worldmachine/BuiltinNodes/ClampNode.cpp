@@ -2,6 +2,8 @@
 
 #include <imgui/imgui.h>
 
+#include "Core/Image/PointwiseKernels.hpp"
+
 namespace worldmachine {
 	
 	class ClampNode: public ImageNodeImplementationT<ClampNode, "Clamp"> {
@@ -20,6 +22,8 @@ namespace worldmachine {
 	WM_RegisterNode(ClampNode);
 	
 	ClampNode::ClampNode() {
+		setRowFootprint(0);
+		setInPlaceInput(0);
 		serializer().addMember(&min, "Min");
 		serializer().addMember(&max, "Max");
 	}
@@ -34,7 +38,6 @@ namespace worldmachine {
 	}
 	
 	BuildJob ClampNode::makeBuildJob(NodeDependencyMap dependencies) {
-		clearBuildDest();
 		ImageView<float> dest = getBuildDest(0);
 		
 		auto const input = dependencies.getInput<float>(0);
@@ -42,14 +45,9 @@ namespace worldmachine {
 		WM_Assert(input.size() == dest.size());
 		
 		BuildJob result;
-		result.add([input, dest, min = this->min, max = this->max]{
-			float const range = max - min;
-			auto const flatSize = dest.size().fold(utl::multiplies);
-			for (std::size_t i = 0; i < flatSize; ++i) {
-				dest[i] = input[i] * range + min;
-			}
+		addPointwiseJobs(result, dest.size(), [input, dest, min = this->min, max = this->max](std::size_t begin, std::size_t end) {
+			scaleOffset(input.data() + begin, dest.data() + begin, end - begin, max - min, min);
 		});
-		
 		return result;
 		
 	}
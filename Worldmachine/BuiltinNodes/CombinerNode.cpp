@@ -1,17 +1,11 @@
 #include "Core/Plugin.hpp"
 
 #include <imgui/imgui.h>
-#include <utl/math.hpp>
+
+#include "Core/Image/PointwiseKernels.hpp"
 
 namespace worldmachine {
 	
-	enum struct CombinerMode: int {
-		avg = 0,
-		add, multiply, subtract, divide,
-		min, max,
-		pow, screen, COUNT
-	};
-	
 	constexpr char const* const combinerModeNames[] {
 		"Average",
 		"Add",
@@ -39,6 +33,8 @@ namespace worldmachine {
 	WM_RegisterNode(CombinerNode);
 	
 	CombinerNode::CombinerNode() {
+		setRowFootprint(0);
+		setInPlaceInput(0);
 		serializer().addMember((int*)&mode, "Mode");
 		serializer().addMember(&strength, "Strength");
 	}
@@ -53,73 +49,25 @@ namespace worldmachine {
 		WM_Assert(dest.size() == inputA.size());
 		
 		if (!inputB) {
-			result.add([=]{
-				std::memcpy(dest.data(), inputA.data(), dest.size().fold(utl::multiplies) * sizeof(float));
+			if (inputA.data() == dest.data()) {
+				/// Built in place, A is already where it belongs.
+				return result;
+			}
+			addPointwiseJobs(result, dest.size(), [=](std::size_t begin, std::size_t end) {
+				std::memcpy(dest.data() + begin, inputA.data() + begin, (end - begin) * sizeof(float));
 			});
 			return result;
 		}
 		
 		WM_Assert(dest.size() == inputB.size());
 		
-		auto dispatch = [&](utl::invocable_r<float, float, float> auto&& f){
-			result.add([=, strength = strength]{
-				std::size_t const size = dest.size().fold(utl::multiplies);
-				for (std::size_t i = 0; i < size; ++i) {
-					dest[i] = f(inputA[i], inputB[i]);
-				}
-			});
-		};
-		
-		switch (mode) {
-			case CombinerMode::avg:
-				dispatch([weight = strength](float a, float b){
-					return (1.0f - weight) * a + weight * b;
-				});
-				break;
-			case CombinerMode::add:
-				dispatch([strength = strength](float a, float b){
-					return a + b * strength;
-				});
-				break;
-			case CombinerMode::multiply:
-				dispatch([strength = strength](float a, float b){
-					return a * utl::mix(1.0f, b, strength);
-				});
-				break;
-			case CombinerMode::subtract:
-				dispatch([strength = strength](float a, float b){
-					return a - b * strength;
-				});
-				break;
-			case CombinerMode::divide:
-				dispatch([strength = strength](float a, float b){
-					return a / utl::mix(1.0f, b, strength);
-				});
-				break;
-			case CombinerMode::min:
-				dispatch([strength = strength](float a, float b){
-					return std::min(a, utl::mix(1.0f, b, strength));
-				});
-				break;
-			case CombinerMode::max:
-				dispatch([strength = strength](float a, float b){
-					return std::max(a, utl::mix(0.0f, b, strength));
-				});
-				break;
-			case CombinerMode::pow:
-				dispatch([strength = strength](float a, float b){
-					return std::pow(a, utl::mix(1.0f, b, strength));
-				});
-				break;
-			case CombinerMode::screen:
-				dispatch([strength = strength](float a, float b){
-					return utl::screen_blend(a, b * strength);
-				});
-				break;
-			default:
-				WM_Log(error, "Unknown Combiner Mode [{}]", (int)mode);
-				break;
+		if (mode < CombinerMode::avg || mode >= CombinerMode::COUNT) {
+			WM_Log(error, "Unknown Combiner Mode [{}]", (int)mode);
+			return result;
 		}
+		addPointwiseJobs(result, dest.size(), [=, mode = mode, strength = strength](std::size_t begin, std::size_t end) {
+			combine(mode, strength, inputA.data() + begin, inputB.data() + begin, dest.data() + begin, end - begin);
+		});
 		return result;
 	}
 	
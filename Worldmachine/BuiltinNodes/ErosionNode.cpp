@@ -2,6 +2,8 @@
 
 #include <imgui/imgui.h>
 #include <random>
+#include <memory>
+#include <algorithm>
 #include <utl/mdarray.hpp>
 #include <utl/math.hpp>
 
@@ -35,8 +37,6 @@ namespace worldmachine {
 		utl::vector<utl::vector<float>> erosionBrushWeights;
 		
 		utl::mdarray<utl::vector<float>, 2> brushWeights;
-		
-		std::mt19937_64 rng{ std::random_device{}() };
 
 		int currentSeed;
 		int currentErosionRadius;
@@ -48,7 +48,7 @@ namespace worldmachine {
 	
 	class ErosionNode: public ImageNodeImplementationT<ErosionNode, "Erosion"> {
 	public:
-		
+		ErosionNode();
 		
 		bool displayControls() override;
 		BuildJob makeBuildJob(NodeDependencyMap dependencies) override;
@@ -63,9 +63,21 @@ namespace worldmachine {
 	
 	WM_RegisterNode(ErosionNode);
 	
+	ErosionNode::ErosionNode() {
+		/// 1: tiled phases with per-tile seeds
+		setOutputVersion(1);
+		setInPlaceInput(0);
+		serializer().addMember(&params.iterations, "Iterations");
+		serializer().addMember(&params.seed, "Seed");
+		serializer().addMember(&params.erosionRadius, "Radius");
+		serializer().addMember(&params.sedimentCapacityFactor, "Sediment Capacity");
+		serializer().addMember(&params.initialWaterVolume, "Initial Water Volume");
+	}
+	
 	bool ErosionNode::displayControls() {
 		bool result = false;
 		result |= ImGui::DragInt("Iterations", &params.iterations, 1000, 0, 10'000'000);
+		result |= ImGui::InputInt("Seed", &params.seed);
 		result |= ImGui::DragInt("Radius", &params.erosionRadius, 1, 1, 30);
 		result |= ImGui::DragFloat("Sediment Capacity", &params.sedimentCapacityFactor, 0.01, 1, 10);
 		result |= ImGui::DragFloat("Initial Water Volume", &params.initialWaterVolume, 0.01, 0.1, 10);
@@ -86,7 +98,7 @@ namespace worldmachine {
 				},
 				.output = {
 					{ "Default", DataType::float1 },
-					{ "Flowmap", DataType::float1 }
+					{ "Flowmap", DataType::float16 }
 				},
 				.parameterInput = {
 					{ "Scale", DataType::none },
@@ -100,12 +112,26 @@ namespace worldmachine {
 		};
 	}
 	
-	using AtomicFloat = float;//std::atomic<float>;
+	/// Region droplets are spawned in. A droplet moves one pixel per step, so
+	/// everything it reads or writes lies within 'erosionReach' of its region.
+	struct ErosionTile {
+		int2 begin, end;
+	};
 	
-	static void simulateDrops(ImageView<AtomicFloat> dest, ErosionParameters const& p, float2 dropPosition, int numDrops);
-	static std::pair<float, float2> calculateHeightAndGradient(ImageView<AtomicFloat const> nodes, float posX, float posY);
+	static int erosionReach(ErosionParameters const& p) {
+		/// Brush radius around the droplet, plus one for bilinear reads and deposits.
+		return p.maxDropletLifetime + p.erosionRadius + 2;
+	}
 	
+	static void simulateDrops(ImageView<float> dest, ErosionParameters const& p, ErosionTile tile, std::size_t numDrops, std::uint64_t seed, CancellationToken const& token);
+	static std::pair<float, float2> calculateHeightAndGradient(ImageView<float const> nodes, float posX, float posY);
 	
+	static std::uint64_t splitmix64(std::uint64_t x) {
+		x += 0x9e3779b97f4a7c15;
+		x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9;
+		x = (x ^ (x >> 27)) * 0x94d049bb133111eb;
+		return x ^ (x >> 31);
+	}
 	
 	BuildJob ErosionNode::makeBuildJob(NodeDependencyMap dependencies) {
 		ErosionParameters p = this->params;
@@ -125,75 +151,92 @@ namespace worldmachine {
 			if (p.erosionRadius < 1) p.erosionRadius = 1;
 		}
 		
-		
 		BuildJob job;
 		
-		auto* atomicDest = new utl::vector<AtomicFloat>(dest.size().x * dest.size().y);
-		job.onCleanup([dest, atomicDest]{
-			std::copy(atomicDest->begin(), atomicDest->end(), dest.begin());
-			delete atomicDest;
-		});
-		
-		std::memcpy(atomicDest->data(), input.data(), dest.size().fold(utl::multiplies) * sizeof(float));
-		ImageView<AtomicFloat> adv(atomicDest->data(), dest.size());
+		if (input.data() != dest.data()) {
+			std::memcpy(dest.data(), input.data(), dest.size().fold(utl::multiplies) * sizeof(float));
+		}
 		
 		p.init(dest.size());
 		p.iterations = utl::round_up(p.iterations, 200);
 		WM_Log("Starting Erosion with {} iterations", p.iterations);
-//		for (std::size_t i = 0; i < p.iterations; i += 200) {
-			job.add([=]{
-				simulateDrops(adv, p, {}, p.iterations);
-			});
-//		}
 		
+		/*
+		 Tiles are twice the reach wide and run in four phases by the parity of
+		 their coordinates, so tiles of the same phase never touch the same pixels
+		 and need no synchronization. Every tile and round has its own seed, which
+		 makes the result independent of the number of threads and of scheduling.
+		 Droplets are spread over several rounds so no region is eroded all at once.
+		 */
+		int const tileSize = 2 * erosionReach(p);
+		usize2 const size = dest.size();
+		std::size_t const tilesX = (size.x + tileSize - 1) / tileSize;
+		std::size_t const tilesY = (size.y + tileSize - 1) / tileSize;
+		std::size_t const mapArea = size.x * size.y;
+		utl::vector<ErosionTile> tiles;
+		utl::vector<std::size_t> areaPrefix = { 0 };
+		for (std::size_t ty = 0; ty < tilesY; ++ty) {
+			for (std::size_t tx = 0; tx < tilesX; ++tx) {
+				int2 const begin = { int(tx * tileSize), int(ty * tileSize) };
+				int2 const end = { std::min(begin.x + tileSize, (int)size.x), std::min(begin.y + tileSize, (int)size.y) };
+				tiles.push_back({ begin, end });
+				areaPrefix.push_back(areaPrefix.back() + std::size_t(end.x - begin.x) * (end.y - begin.y));
+			}
+		}
 		
+		std::size_t const iterations = p.iterations;
+		std::size_t const dropsPerJob = 256;
+		std::size_t const rounds = std::clamp<std::size_t>(iterations / (tiles.size() * dropsPerJob), 1, 16);
+		auto const shared = std::make_shared<ErosionParameters const>(std::move(p));
+		auto const seed = (std::uint64_t)(std::uint32_t)shared->seed;
+		job.reserve(rounds * tiles.size());
+		for (std::size_t round = 0; round < rounds; ++round) {
+			std::size_t const roundBegin = iterations * round / rounds;
+			std::size_t const roundDrops = iterations * (round + 1) / rounds - roundBegin;
+			for (std::size_t phase = 0; phase < 4; ++phase) {
+				for (std::size_t ty = phase / 2; ty < tilesY; ty += 2) {
+					for (std::size_t tx = phase % 2; tx < tilesX; tx += 2) {
+						std::size_t const tileIndex = ty * tilesX + tx;
+						/// Proportional to the tile area, rounded such that all tiles sum up to 'roundDrops'
+						std::size_t const numDrops = roundDrops * areaPrefix[tileIndex + 1] / mapArea -
+													 roundDrops * areaPrefix[tileIndex] / mapArea;
+						if (numDrops == 0) {
+							continue;
+						}
+						std::uint64_t const tileSeed = splitmix64(seed ^ splitmix64(round * tiles.size() + tileIndex));
+						job.add([=, tile = tiles[tileIndex]](CancellationToken const& token) {
+							simulateDrops(dest, *shared, tile, numDrops, tileSeed, token);
+						});
+					}
+				}
+				job.barrier();
+			}
+		}
 		
 		return job;
 	}
 	
-	static std::atomic<float>& operator+=(std::atomic<float>& atomicFloat, float increment)
-	{
-		float oldValue;
-		float newValue;
-		
-		do
-		{
-			oldValue = atomicFloat.load (std::memory_order_relaxed);
-			newValue = oldValue + increment;
-		} while (! atomicFloat.compare_exchange_weak (oldValue, newValue,
-													  std::memory_order_release,
-													  std::memory_order_relaxed));
-		return atomicFloat;
-	}
-	
-	static std::atomic<float>& operator-=(std::atomic<float>& atomicFloat, float increment)
-	{
-		float oldValue;
-		float newValue;
-		
-		do
-		{
-			oldValue = atomicFloat.load (std::memory_order_relaxed);
-			newValue = oldValue - increment;
-		} while (! atomicFloat.compare_exchange_weak (oldValue, newValue,
-													  std::memory_order_release,
-													  std::memory_order_relaxed));
-		return atomicFloat;
-	}
-	
 	static bool isInfOrNaN(float x) {
 		return std::isinf(x) || std::isnan(x);
 	}
 	
-	static void simulateDrops(ImageView<AtomicFloat> dest, ErosionParameters const& p, float2 dropPosition, int numDrops) {
-		
-		std::mt19937_64 rng(std::random_device{}());
-		std::uniform_int_distribution<> dist(0, dest.size().x - 1);
+	static void simulateDrops(ImageView<float> dest, ErosionParameters const& p, ErosionTile tile, std::size_t numDrops, std::uint64_t seed, CancellationToken const& token) {
+		/// mt19937_64 output is fully specified by the standard, unlike the distributions.
+		std::mt19937_64 rng(seed);
+		auto uniform = [&](int begin, int end) {
+			return begin + float((rng() >> 40) * 0x1.0p-24) * (end - begin);
+		};
+		/// Droplets on the last row or column would leave the map immediately.
+		int2 const spawnEnd = mtl::map(tile.end, (int2)dest.size() - 1, utl::min);
 		
-		for (int iteration = 0; iteration < numDrops; iteration++) {
+		for (std::size_t iteration = 0; iteration < numDrops; iteration++) {
+			/// A droplet lives for at most 'maxDropletLifetime' steps, so this bounds the latency to well below a millisecond.
+			if (iteration % 16 == 0 && token.cancelled()) {
+				return;
+			}
 		
-			float posX = dist(rng);
-			float posY = dist(rng);
+			float posX = uniform(tile.begin.x, std::max(spawnEnd.x, tile.begin.x));
+			float posY = uniform(tile.begin.y, std::max(spawnEnd.y, tile.begin.y));
 			float dirX = 0;
 			float dirY = 0;
 			float speed = p.initialSpeed;
@@ -228,7 +271,7 @@ namespace worldmachine {
 				posY += dirY;
 
 				// Stop simulating droplet if it's not moving or has flowed over edge of map
-				if ((dirX == 0 && dirY == 0) || posX < 0 || posX >= dest.size().x - 1 || posY < 0 || posY >= dest.size().x - 1) {
+				if ((dirX == 0 && dirY == 0) || posX < 0 || posX >= dest.size().x - 1 || posY < 0 || posY >= dest.size().y - 1) {
 					break;
 				}
 
@@ -299,12 +342,12 @@ namespace worldmachine {
 				water *= (1 - p.evaporateSpeed);
 			}
 			
-			WM_Log("Droplet died; sediment = {}", sediment);
+			WM_LogCategory(kernel, trace, "Droplet died; sediment = {}", sediment);
 		}
 	}
 	
 	
-	static std::pair<float, float2> calculateHeightAndGradient(ImageView<AtomicFloat const> nodes, float posX, float posY) {
+	static std::pair<float, float2> calculateHeightAndGradient(ImageView<float const> nodes, float posX, float posY) {
 		int coordX = (int) posX;
 		int coordY = (int) posY;
 
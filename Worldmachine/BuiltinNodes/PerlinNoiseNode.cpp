@@ -2,13 +2,14 @@
 
 #include <imgui/imgui.h>
 #include <mtl/mtl.hpp>
-#include <utl/mdarray.hpp>
 #include <utl/stdio.hpp>
 #include <utl/stopwatch.hpp>
 #include <utl/scope_guard.hpp>
 #include <utl/dynamic_dispatch.hpp>
 #include <utl/math.hpp>
 #include <random>
+#include <algorithm>
+#include <cstdint>
 #include <numeric>
 
 using namespace mtl;
@@ -49,6 +50,9 @@ namespace worldmachine {
 	WM_RegisterNode(PerlinNoiseNode);
 	
 	PerlinNoiseNode::PerlinNoiseNode() {
+		/// 1: hashed lattice
+		setOutputVersion(1);
+		setRowFootprint(0);
 		serializer().addMember(&params.scale, "Scale");
 		serializer().addMember(&params.seed, "Seed");
 		serializer().addMember(&params.levels, "Levels");
@@ -78,88 +82,86 @@ namespace worldmachine {
 		struct BuildData {
 			utl::small_vector<float2, 16> scaleData;
 			utl::small_vector<float, 16> strengthData;
-			utl::vector<utl::mdarray<utl::vector<float>, 2>> pointData;
 		};
-	
-		void perlinNoise(ImageView<float> img, std::size_t yStart, std::size_t yEnd,
-						 int level, float2 levelScale, float levelStrength,
-						 BuildData* data,
-						 utl::invocable_r<float2, float2> auto&& interpolation,
-						 utl::invocable_r<float2, float2, std::size_t, std::size_t> auto&& offsetUV)
+		
+		/// Lattice values are hashed from their integer coordinates instead of
+		/// being stored, so the lattice costs no memory at any scale.
+		constexpr std::uint32_t latticeHash(std::int32_t x, std::int32_t y, std::uint32_t seed) {
+			std::uint32_t h = (std::uint32_t)x * 0x8da6b343u ^ (std::uint32_t)y * 0xd8163841u ^ seed * 0xcb1ab31fu;
+			h ^= h >> 16;
+			h *= 0x7feb352du;
+			h ^= h >> 15;
+			h *= 0x846ca68bu;
+			h ^= h >> 16;
+			return h;
+		}
+		
+		/// In [0, 1). Converts through a signed integer, which vectorizes.
+		constexpr float latticeValue(std::int32_t x, std::int32_t y, std::uint32_t seed) {
+			return (float)(std::int32_t)(latticeHash(x, y, seed) >> 8) * (1.0f / (1 << 24));
+		}
+		
+		/// std::floor only vectorizes without trapping math, this does always.
+		constexpr std::int32_t floorToInt(float x) {
+			std::int32_t const i = (std::int32_t)x;
+			return i - (x < (float)i);
+		}
+		
+		/// Pixels evaluated together. The loop over lanes has a fixed trip count
+		/// and no branches, so it compiles to vector code.
+		constexpr std::int32_t laneCount = 8;
+		
+		/// All levels of one row in a single pass, accumulated in registers.
+		void perlinNoiseRow(float* dest, std::size_t y, usize2 imgSize,
+							int levels, BuildData const* data, std::uint32_t seed,
+							auto&& interpolation)
 		{
-			for (std::size_t y = yStart; y < yEnd; ++y) {
-				for (std::size_t x = 0, xSize = img.size().x; x < xSize; ++x) {
-					float2 const uv = levelScale * float2(x, y) / img.size();
+			float const invWidth = 1.0f / imgSize.x;
+			float const v = (float)y / imgSize.y;
+			for (std::size_t xStart = 0; xStart < imgSize.x; xStart += laneCount) {
+				float const x0 = (float)xStart;
+				float sum[laneCount] = {};
+				for (int level = 0; level < levels; ++level) {
+					float2 const levelScale = data->scaleData[level];
+					float const levelStrength = data->strengthData[level];
+					std::uint32_t const levelSeed = seed + (std::uint32_t)level;
 					
-					float2 const fcoord = interpolation(utl::fract(uv));
-					int2 icoord = utl::floor(uv);
-					if (levelScale.x > img.size().x) {
-						icoord.x = (int)x;
-					}
-					if (levelScale.y > img.size().y) {
-						icoord.y = (int)y;
+					float const uvY = levelScale.y * v;
+					std::int32_t const iy = floorToInt(uvY);
+					float const fy = interpolation(uvY - (float)iy);
+					
+					for (std::int32_t lane = 0; lane < laneCount; ++lane) {
+						float const uvX = levelScale.x * (x0 + (float)lane) * invWidth;
+						std::int32_t const ix = floorToInt(uvX);
+						float const fx = interpolation(uvX - (float)ix);
+						
+						float const lower = utl::mix(latticeValue(ix, iy, levelSeed),
+													 latticeValue(ix + 1, iy, levelSeed), fx);
+						float const upper = utl::mix(latticeValue(ix, iy + 1, levelSeed),
+													 latticeValue(ix + 1, iy + 1, levelSeed), fx);
+						sum[lane] += utl::mix(lower, upper, fy) * levelStrength;
 					}
-					  
-					auto const value = [&]{
-						auto const lower = [&]{
-							auto const left = data->pointData[level](icoord);
-							auto const right = data->pointData[level](icoord + int2{ 1, 0 });
-							return utl::mix(left, right, fcoord.x);
-						}();
-						auto const upper = [&]{
-							auto const left = data->pointData[level](icoord + int2{ 0, 1 });
-							auto const right = data->pointData[level](icoord + int2{ 1, 1 });
-							return utl::mix(left, right, fcoord.x);
-						}();
-						return utl::mix(lower, upper, fcoord.y);
-					}();
-					float& dst = img(x, y);
-					dst += value * levelStrength;
 				}
+				std::size_t const count = std::min<std::size_t>(laneCount, imgSize.x - xStart);
+				std::copy_n(sum, count, dest + xStart);
 			}
 		}
 		
 		void leveledPerlinNoise(ImageView<float> img, std::size_t yStart, std::size_t yEnd,
 								PerlinNoiseParameters params,
-								BuildData* data,
-								auto&& interpolation,
-								utl::invocable_r<float2, float2, std::size_t, std::size_t> auto&& offsetUV)
+								BuildData const* data,
+								CancellationToken const& token,
+								auto&& interpolation)
 		{
-			  for (int i = 0; i < params.levels; ++i) {
-				  perlinNoise(img, yStart, yEnd, i,
-							  data->scaleData[i], data->strengthData[i],
-							  data,
-							  interpolation,
-							  offsetUV);
-			  }
-		}
-		
-		constexpr size_t hash(usize2 s) {
-			size_t result = 0xcbf29ce484222325; // FNV offset basis
-
-			for (char i : s) {
-				result ^= i * 1099511628211ul * 1099511628211ul;
-				result *= 1099511628211ul; // FNV prime
-				result *= 1099511628211ul; // FNV prime
+			for (std::size_t y = yStart; y < yEnd; ++y) {
+				if (token.cancelled()) {
+					return;
+				}
+				perlinNoiseRow(&img(0, y), y, img.size(), params.levels, data,
+							   (std::uint32_t)params.seed, interpolation);
 			}
-
-			return result;
 		}
 		
-		utl::mdarray<utl::vector<float>, 2> calculatePointData(usize2 imgSize, float2 scale, int seed) {
-			utl::mdarray<utl::vector<float>, 2> pointData(std::max((std::size_t)std::ceil(scale.x), imgSize.x) + 1,
-														   std::max((std::size_t)std::ceil(scale.y), imgSize.y) + 1);
-			auto const totalPoints = pointData.size().fold(utl::multiplies);
-			if (totalPoints > 8*8*1024*1024) {
-				throw BuildError(utl::format("we cant calculate this many points ({})", totalPoints));
-			}
-			for (auto index: utl::iota<usize2>(pointData.size())) {
-				std::size_t hashValue = hash(index + seed * 1099511628211ul);
-				pointData[index] = (float)hashValue / ULONG_MAX;
-			}
-			return pointData;
-		};
-		
 	}
 	
 	BuildJob PerlinNoiseNode::makeBuildJob(NodeDependencyMap dependencies) {
@@ -193,33 +195,23 @@ namespace worldmachine {
 			return std::pair{ scales, strength };
 		}();
 		
-		data->pointData.reserve(params.levels);
-		for (int i = 0; i < params.levels; ++i) {
-			data->pointData.emplace_back(calculatePointData(dest.size(), data->scaleData[i], params.seed + i));
-		}
-		
-		
-		auto linear = [](float2 v) {
+		auto linear = [](float v) {
 			return v;
 		};
-		auto cubic = [](float2 f) {
+		auto cubic = [](float f) {
 			return f * f * (3 - 2 * f);
 		};
-		auto quintic = [](float2 f) {
+		auto quintic = [](float f) {
 			return f*f*f*(f*(f*6.0f-15.0f)+10.0f);
 		};
 		
-		auto noUVOffset = [](float2 uv, auto, auto) { return uv; };
-		
 		utl::dispatch(utl::dispatch_arg((int)params.interpolation, linear, cubic, quintic),
-					  utl::dispatch_arg(0, noUVOffset),
-					  [&](auto interpolation, auto uvOffset) {
+					  [&](auto interpolation) {
 			for (std::size_t yStart = 0; yStart < dest.size().y; yStart += rowsPerJob) {
 				std::size_t const yEnd = std::min<std::size_t>(yStart + rowsPerJob, dest.size().y);
-				job.add([=]{
-					leveledPerlinNoise(dest, yStart, yEnd, params, data,
-									   interpolation,
-									   uvOffset);
+				job.add({ yStart, yEnd }, [=](CancellationToken const& token) {
+					leveledPerlinNoise(dest, yStart, yEnd, params, data, token,
+									   interpolation);
 				});
 			}
 		});
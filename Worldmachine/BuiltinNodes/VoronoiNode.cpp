@@ -5,6 +5,10 @@
 #include <mtl/mtl.hpp>
 #include <utl/dynamic_dispatch.hpp>
 #include <random>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
 
 using namespace mtl;
 
@@ -26,6 +30,7 @@ namespace worldmachine {
 		VoronoiDistanceFunction distanceFunction = VoronoiDistanceFunction::euclidian;
 		float p = 1;
 		bool squareHeight = true;
+		bool featureOutputs = false;
 	};
 	
 	
@@ -37,6 +42,12 @@ namespace worldmachine {
 		BuildJob makeBuildJob(NodeDependencyMap dependencies) override;
 		static NodeDescriptor staticDescriptor();
 		
+	private:
+		/// F2 and Cell ID
+		bool outputEnabled(std::size_t index) const override {
+			return index == 0 || params.featureOutputs;
+		}
+		
 	private:
 		VoronoiParameters params{};
 	};
@@ -46,6 +57,7 @@ namespace worldmachine {
 	/// MARK: - Implementation
 	
 	VoronoiNode::VoronoiNode() {
+		setRowFootprint(0);
 		serializer().addMember(&params.scale, "Scale");
 		serializer().addMember(&params.seed, "Seed");
 		serializer().addMember(&params.modulation, "Modulation");
@@ -53,6 +65,7 @@ namespace worldmachine {
 		serializer().addMember((int*)&params.distanceFunction, "Distance Function");
 		serializer().addMember(&params.p, "P");
 		serializer().addMember(&params.squareHeight, "Square Height");
+		serializer().addMember(&params.featureOutputs, "F2 and Cell ID");
 	}
 	
 	bool VoronoiNode::displayControls() {
@@ -69,6 +82,7 @@ namespace worldmachine {
 			result |= ImGui::DragFloat("P", &params.p, 0.01, 1, 100);
 		}
 		result |= ImGui::Checkbox("Square Height", &params.squareHeight);
+		result |= ImGui::Checkbox("F2 and Cell ID", &params.featureOutputs);
 		return result;
 	}
 	
@@ -77,44 +91,227 @@ namespace worldmachine {
 		struct BuildData {
 			utl::mdarray<utl::vector<float3>, 3> pointData;
 		};
-	
-		template <bool squareHeight, bool hasUVOffset>
-		void algorithm(ImageView<float> img, std::size_t yStart, std::size_t yEnd,
+		
+		/// Distance functions return a key that orders like the distance and is
+		/// cheaper to compute, finish() turns the smallest keys into distances.
+		struct EuclidianDistance {
+			float operator()(float x, float y, float z) const { return x * x + y * y + z * z; }
+			float finish(float key) const { return std::sqrt(key); }
+		};
+		
+		struct SumDistance {
+			float operator()(float x, float y, float z) const { return std::abs(x) + std::abs(y) + std::abs(z); }
+			float finish(float key) const { return key; }
+		};
+		
+		struct MaxDistance {
+			float operator()(float x, float y, float z) const {
+				return std::max(std::max(std::abs(x), std::abs(y)), std::abs(z));
+			}
+			float finish(float key) const { return key; }
+		};
+		
+		struct PNormDistance {
+			float p;
+			float operator()(float x, float y, float z) const {
+				return std::pow(std::abs(x), p) + std::pow(std::abs(y), p) + std::pow(std::abs(z), p);
+			}
+			float finish(float key) const { return std::pow(key, 1.0f / p); }
+		};
+		
+		/// Pixels evaluated together. Two AVX vectors, the loops over lanes have a
+		/// fixed trip count and no branches, so they compile to vector code.
+		constexpr std::size_t laneCount = 16;
+		
+		/// Fewer pixels left in a run of one cell are evaluated one by one. Gathering
+		/// the candidates and a mostly empty block cost more than that.
+		constexpr std::size_t minBlockPixels = 4;
+		
+		/// Feature points of the 3x3x3 cells around one cell, relative to that cell's
+		/// origin. Pixels in the same cell share them.
+		struct Candidates {
+			static constexpr int maxCount = 27;
+			float x[maxCount], y[maxCount], z[maxCount], cellID[maxCount];
+			/// Runtime count, this also keeps the compiler from unrolling the loop over
+			/// candidates into the loop over lanes.
+			int count = 0;
+		};
+		
+		float cellID(mtl::int3 index, int seed) {
+			std::uint32_t h = (std::uint32_t)index.x * 0x8da6b343u ^ (std::uint32_t)index.y * 0xd8163841u ^
+			                  (std::uint32_t)index.z * 0xcb1ab31fu ^ (std::uint32_t)seed;
+			h ^= h >> 16;
+			h *= 0x7feb352du;
+			h ^= h >> 15;
+			h *= 0x846ca68bu;
+			h ^= h >> 16;
+			return (float)(h >> 8) / (1 << 24);
+		}
+		
+		/// Only offset UVs leave the point grid
+		bool inPointGrid(mtl::int3 index, BuildData const* data) {
+			auto const size = data->pointData.size();
+			return index.x >= 0 && index.y >= 0 &&
+				(std::size_t)index.x < size.x && (std::size_t)index.y < size.y;
+		}
+		
+		template <bool featureOutputs>
+		void gatherCandidates(Candidates& candidates, mtl::int2 cell, BuildData const* data, int seed) {
+			candidates.count = 0;
+			for (auto [i, j, k] : utl::iota<mtl::int3>(mtl::int3(-1), mtl::int3(2))) {
+				mtl::int3 const index = { cell.x + i + 1, cell.y + j + 1, k + 1 };
+				if (!inPointGrid(index, data)) {
+					continue;
+				}
+				auto const p = data->pointData(index);
+				int const n = candidates.count++;
+				candidates.x[n] = i + p.x;
+				candidates.y[n] = j + p.y;
+				candidates.z[n] = k + p.z;
+				if constexpr (featureOutputs) {
+					candidates.cellID[n] = cellID(index, seed);
+				}
+			}
+		}
+		
+		struct PixelResult {
+			float f1, f2, cellID;
+		};
+		
+		/// One pixel straight from the point grid, for pixels whose neighbours are
+		/// in other cells. Only the nearest cell is hashed.
+		template <bool featureOutputs>
+		PixelResult evaluatePixel(mtl::int2 cell, float fx, float fy, float z,
+								  BuildData const* data, int seed, auto const& distance)
+		{
+			PixelResult result = {
+				std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), 0
+			};
+			mtl::int3 nearest(0);
+			for (auto [i, j, k] : utl::iota<mtl::int3>(mtl::int3(-1), mtl::int3(2))) {
+				mtl::int3 const index = { cell.x + i + 1, cell.y + j + 1, k + 1 };
+				if (!inPointGrid(index, data)) {
+					continue;
+				}
+				auto const p = data->pointData(index);
+				float const key = distance(fx - (i + p.x), fy - (j + p.y), z - (k + p.z));
+				if constexpr (featureOutputs) {
+					result.f2 = std::min(result.f2, std::max(result.f1, key));
+					nearest = key < result.f1 ? index : nearest;
+				}
+				result.f1 = std::min(result.f1, key);
+			}
+			if constexpr (featureOutputs) {
+				result.cellID = cellID(nearest, seed);
+			}
+			return result;
+		}
+		
+		struct BlockResult {
+			float f1[laneCount], f2[laneCount], cellID[laneCount];
+		};
+		
+		/// 'fx' and 'fy' are the positions of 'laneCount' pixels within the cell of 'candidates'.
+		template <bool featureOutputs>
+		void evaluateBlock(float const* fx, float const* fy, float z,
+						   Candidates const& candidates, auto const& distance,
+						   BlockResult& result)
+		{
+			for (std::size_t l = 0; l < laneCount; ++l) {
+				result.f1[l] = std::numeric_limits<float>::max();
+				result.f2[l] = std::numeric_limits<float>::max();
+				result.cellID[l] = 0;
+			}
+			for (int c = 0; c < candidates.count; ++c) {
+				float const cx = candidates.x[c];
+				float const cy = candidates.y[c];
+				float const dz = z - candidates.z[c];
+				for (std::size_t l = 0; l < laneCount; ++l) {
+					float const key = distance(fx[l] - cx, fy[l] - cy, dz);
+					if constexpr (featureOutputs) {
+						result.f2[l] = std::min(result.f2[l], std::max(result.f1[l], key));
+						/// Only written by gatherCandidates<true>()
+						result.cellID[l] = key < result.f1[l] ? candidates.cellID[c] : result.cellID[l];
+					}
+					result.f1[l] = std::min(result.f1[l], key);
+				}
+			}
+		}
+		
+		struct VoronoiDests {
+			ImageView<float> f1, f2, cellID;
+		};
+		
+		template <bool squareHeight, bool featureOutputs>
+		void algorithm(VoronoiDests dest, std::size_t yStart, std::size_t yEnd,
 					   VoronoiParameters params, BuildData const* data,
-					   utl::invocable_r<float, float3, float3> auto&& distanceFunction,
+					   CancellationToken const& token,
+					   auto const& distance,
 					   utl::invocable_r<float2, float2, std::size_t, std::size_t> auto&& offsetUV)
 		{
+			auto const size = dest.f1.size();
+			/// Cell and position within the cell of every pixel of a row. Blocks may
+			/// read past the end of the row, hence the padding.
+			utl::vector<mtl::int2> cells(size.x);
+			utl::vector<float> fx(size.x + laneCount), fy(size.x + laneCount);
+			Candidates candidates;
+			BlockResult block;
+			
+			auto finish = [&](float key) {
+				float const value = distance.finish(key);
+				if constexpr (squareHeight) {
+					return value * value;
+				}
+				else {
+					return value;
+				}
+			};
+			
 			for (std::size_t y = yStart; y < yEnd; ++y) {
-				for (std::size_t x = 0, xSize = img.size().x; x < xSize; ++x) {
-					mtl::float2 const uv = params.scale * mtl::float2(x, y) / img.size();
+				/// A row of a wide image with the pnorm distance is still only a few milliseconds.
+				if (token.cancelled()) {
+					return;
+				}
+				for (std::size_t x = 0; x < size.x; ++x) {
+					mtl::float2 const uv = params.scale * mtl::float2(x, y) / size;
 					mtl::float2 const distUV = offsetUV(uv, x, y);
-					mtl::float2 const fcoord = utl::fract(distUV);
-					mtl::int3 const icoord = mtl::concat(mtl::floor(distUV), 0);
-					
-					float value = std::numeric_limits<float>::max();
-					for (auto [i, j, k] : utl::iota<mtl::int3>(mtl::int3(-1), mtl::int3(2))) {
-						mtl::int3 const index = icoord + mtl::int3(i + 1, j + 1, k + 1);
-					
-						if constexpr (hasUVOffset) {
-							if (!mtl::map(index, data->pointData.size(), utl::less).fold(utl::logical_and)) {
-								continue;
-							}
-							if (!mtl::map(index, mtl::int3{ 0 }, utl::greater_eq).fold(utl::logical_and)) {
-								continue;
+					mtl::float2 const origin = mtl::floor(distUV);
+					cells[x] = { (int)origin.x, (int)origin.y };
+					fx[x] = distUV.x - origin.x;
+					fy[x] = distUV.y - origin.y;
+				}
+				/// Runs of pixels in the same cell share their candidates
+				for (std::size_t begin = 0; begin < size.x;) {
+					std::size_t end = begin + 1;
+					while (end < size.x && cells[end].x == cells[begin].x && cells[end].y == cells[begin].y) {
+						++end;
+					}
+					std::size_t x = begin;
+					if (end - begin >= minBlockPixels) {
+						gatherCandidates<featureOutputs>(candidates, cells[begin], data, params.seed);
+						while (end - x >= minBlockPixels) {
+							evaluateBlock<featureOutputs>(&fx[x], &fy[x], params.modulation, candidates, distance, block);
+							std::size_t const count = std::min(laneCount, end - x);
+							for (std::size_t l = 0; l < count; ++l) {
+								dest.f1(x + l, y) = finish(block.f1[l]);
+								if constexpr (featureOutputs) {
+									dest.f2(x + l, y) = finish(block.f2[l]);
+									dest.cellID(x + l, y) = block.cellID[l];
+								}
 							}
+							x += count;
 						}
-						
-						auto const p = data->pointData(index);
-						auto const dist = distanceFunction(mtl::concat(fcoord, params.modulation) - mtl::float3(i, j, k), p);
-						value = std::min(value, dist);
 					}
-					if constexpr (squareHeight) {
-						img(x, y) = value * value;
-					}
-					else {
-						img(x, y) = value;
+					for (; x < end; ++x) {
+						auto const pixel = evaluatePixel<featureOutputs>(cells[x], fx[x], fy[x], params.modulation,
+																		 data, params.seed, distance);
+						dest.f1(x, y) = finish(pixel.f1);
+						if constexpr (featureOutputs) {
+							dest.f2(x, y) = finish(pixel.f2);
+							dest.cellID(x, y) = pixel.cellID;
+						}
 					}
-					
+					begin = end;
 				}
 			}
 		}
@@ -135,11 +332,11 @@ namespace worldmachine {
 	}
 	
 	BuildJob VoronoiNode::makeBuildJob(NodeDependencyMap dependencies) {
-		ImageView<float> dest = getBuildDest(0);
+		VoronoiDests const dest = { getBuildDest(0), getBuildDest(1), getBuildDest(2) };
 		
 		std::size_t const rowsPerJob = 8;
 		
-		float const aspectRatio = (float)dest.size().x / dest.size().y;
+		float const aspectRatio = (float)dest.f1.size().x / dest.f1.size().y;
 		mtl::float2 const scale = { params.scale * aspectRatio, params.scale };
 		
 		BuildJob job;
@@ -147,56 +344,40 @@ namespace worldmachine {
 		job.onCleanup([data]{
 			delete data;
 		});
-		data->pointData = calculatePointData<float3, 3>(params.seed, int3(scale.map(utl::ceil) + 2, 3));
+		/// Pixels span 'params.scale' cells in both directions, narrow images need
+		/// more columns than 'scale' says.
+		int const columns = (int)std::ceil(std::max(scale.x, params.scale)) + 2;
+		data->pointData = calculatePointData<float3, 3>(params.seed, int3(columns, (int)std::ceil(scale.y) + 2, 3));
 
 		ImageView<float2 const> uvOffsetImage = dependencies.getInput<float2>(0);
 		
+		/// Possible UV Offset functions
+		bool const hasUVOffset = !!uvOffsetImage;
+		auto uvOffset = [uvOffsetImage,
+						 strength = params.uvOffsetStrength] (mtl::float2 uv, std::size_t x, std::size_t y)
+		{
+			return uv + strength * (uvOffsetImage(x, y) - 0.5f);
+		};
+		auto noUVOffset = [](float2 uv, std::size_t, std::size_t){ return uv; };
 		
-		for (std::size_t yStart = 0; yStart < dest.size().y; yStart += rowsPerJob) {
-			std::size_t const yEnd = std::min<std::size_t>(yStart + rowsPerJob, dest.size().y);
-			
-			/// Possible UV Offset functions
-			bool const hasUVOffset = !!uvOffsetImage;
-			auto uvOffset = [uvOffsetImage,
-							 strength = params.uvOffsetStrength] (mtl::float2 uv, std::size_t x, std::size_t y)
-			{
-				return uv + strength * (uvOffsetImage(x, y) - 0.5f);
-			};
-			auto noUVOffset = [](float2 uv, std::size_t, std::size_t){ return uv; };
-			
-			/// Possible Distance Functions
-			auto euclDist = [](float3 const& a, float3 const& b) {
-				return mtl::fast_distance(a, b);
-			};
-			auto sumDist = [](float3 const& a, float3 const& b) {
-				return (a - b).map(utl::abs).fold(utl::plus);
-			};
-			auto maxDist = [](float3 const& a, float3 const& b) {
-				return (a - b).map(utl::abs).fold(utl::max);
-			};
-			auto pnormDist = [p = params.p](float3 const& a, float3 const& b) {
-				// basically mtl::fast_pnorm(a - b)
-				return std::pow((a - b).map(utl::abs).map([&](auto const& x) {
-					return std::pow(x, p);
-				}).fold(utl::plus), 1.0f / p);
-			};
-			
-			utl::dispatch(utl::dispatch_arg((int)params.distanceFunction,
-											euclDist, sumDist, maxDist, pnormDist),
-						  utl::dispatch_arg(hasUVOffset, noUVOffset, uvOffset),
-						  utl::dispatch_condition(hasUVOffset),
-						  utl::dispatch_condition(params.squareHeight),
-						  [&](auto distanceFunction,
-							  auto uvOffset,
-							  auto hasUVOffset,
-							  auto squareHeight) {
-								  static constexpr bool SH = decltype(squareHeight)::value;
-								  static constexpr bool O = decltype(hasUVOffset)::value;
-								  job.add([=, params = params] {
-								      algorithm<SH, O>(dest, yStart, yEnd, params, data, distanceFunction, uvOffset);
-								    });
+		utl::dispatch(utl::dispatch_arg((int)params.distanceFunction,
+										EuclidianDistance{}, SumDistance{}, MaxDistance{}, PNormDistance{ params.p }),
+					  utl::dispatch_arg(hasUVOffset, noUVOffset, uvOffset),
+					  utl::dispatch_condition(params.featureOutputs),
+					  utl::dispatch_condition(params.squareHeight),
+					  [&](auto distance,
+						  auto uvOffset,
+						  auto featureOutputs,
+						  auto squareHeight) {
+			static constexpr bool SH = decltype(squareHeight)::value;
+			static constexpr bool F = decltype(featureOutputs)::value;
+			for (std::size_t yStart = 0; yStart < dest.f1.size().y; yStart += rowsPerJob) {
+				std::size_t const yEnd = std::min<std::size_t>(yStart + rowsPerJob, dest.f1.size().y);
+				job.add({ yStart, yEnd }, [=, params = params](CancellationToken const& token) {
+					algorithm<SH, F>(dest, yStart, yEnd, params, data, token, distance, uvOffset);
 				});
-		}
+			}
+		});
 		return job;
 	}
 	
@@ -209,7 +390,9 @@ namespace worldmachine {
 					{ "UV Offset", DataType::float2 }
 				},
 				.output = {
-					{ "Default", DataType::float1 }
+					{ "Default", DataType::float1 },
+					{ "F2", DataType::float1 },
+					{ "Cell ID", DataType::float1 }
 				},
 				.parameterInput = {
 					{ "Scale", DataType::none },
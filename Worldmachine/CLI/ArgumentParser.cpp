@@ -0,0 +1,72 @@
+#include "ArgumentParser.hpp"
+
+#include <charconv>
+#include <iostream>
+
+namespace worldmachine {
+
+	std::optional<std::size_t> parseNumber(std::string_view str) {
+		std::size_t result = 0;
+		auto const [end, ec] = std::from_chars(str.data(), str.data() + str.size(), result);
+		if (ec != std::errc{} || end != str.data() + str.size() || result == 0) {
+			return std::nullopt;
+		}
+		return result;
+	}
+	
+	bool ArgumentParser::next() {
+		if (index + 1 >= argc) {
+			return false;
+		}
+		++index;
+		return true;
+	}
+	
+	std::optional<std::string_view> ArgumentParser::value() {
+		if (index + 1 >= argc) {
+			std::cerr << "Missing value for " << current() << "\n";
+			return std::nullopt;
+		}
+		return argv[++index];
+	}
+	
+	std::optional<std::size_t> ArgumentParser::number() {
+		std::string_view const option = current();
+		auto const v = value();
+		if (!v) {
+			return std::nullopt;
+		}
+		auto const n = parseNumber(*v);
+		if (!n) {
+			std::cerr << "Invalid number '" << *v << "' for " << option << "\n";
+		}
+		return n;
+	}
+	
+	bool ArgumentParser::number(std::size_t& dest) {
+		auto const n = number();
+		if (!n) {
+			return false;
+		}
+		dest = *n;
+		return true;
+	}
+	
+	std::filesystem::path defaultPluginPath(char const* argv0) {
+#if defined(WM_PLATFORM_MACOS)
+		char const* const name = "libWMBuiltinNodes.dylib";
+#elif defined(WM_PLATFORM_WINDOWS)
+		char const* const name = "WMBuiltinNodes.dll";
+#else
+		char const* const name = "libWMBuiltinNodes.so";
+#endif
+		std::error_code ec;
+#if defined(__linux__)
+		if (auto path = std::filesystem::read_symlink("/proc/self/exe", ec); !ec) {
+			return path.parent_path() / name;
+		}
+#endif
+		return std::filesystem::absolute(argv0, ec).parent_path() / name;
+	}
+
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <optional>
+#include <string_view>
+
+/// Shared by wmbuild and wmbench, the benchmarks compile this file too.
+
+namespace worldmachine {
+
+	/// Decimal number greater than 0
+	std::optional<std::size_t> parseNumber(std::string_view);
+	
+	/// Walks the arguments passed to main(). Errors are printed to std::cerr.
+	class ArgumentParser {
+	public:
+		ArgumentParser(int argc, char const* const* argv): argc(argc), argv(argv) {}
+		
+		/// Advances to the next argument, false after the last one
+		bool next();
+		
+		/// The argument next() advanced to
+		std::string_view current() const { return argv[index]; }
+		
+		/// Consumes the argument following the current option
+		std::optional<std::string_view> value();
+		
+		/// Consumes the argument following the current option as a number
+		std::optional<std::size_t> number();
+		
+		/// Leaves 'dest' untouched on failure
+		bool number(std::size_t& dest);
+		
+	private:
+		int argc;
+		char const* const* argv;
+		int index = 0;
+	};
+	
+	/// The builtin node plugin, expected next to the executable
+	std::filesystem::path defaultPluginPath(char const* argv0);
+
+}
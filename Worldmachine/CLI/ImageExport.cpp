@@ -0,0 +1,106 @@
+#include "ImageExport.hpp"
+
+#include <fstream>
+#include <bit>
+#include <cstdint>
+#include <algorithm>
+#include <cmath>
+
+#include "Core/Debug.hpp"
+#include "Core/Image/Image.hpp"
+
+namespace worldmachine {
+
+	std::optional<ImageFileFormat> imageFileFormatFromString(std::string_view str) {
+		if (str == "pfm") return ImageFileFormat::pfm;
+		if (str == "pgm" || str == "pgm16") return ImageFileFormat::pgm16;
+		if (str == "raw") return ImageFileFormat::raw;
+		return std::nullopt;
+	}
+
+	std::string_view fileExtension(ImageFileFormat format) {
+		switch (format) {
+			case ImageFileFormat::pfm:   return ".pfm";
+			case ImageFileFormat::pgm16: return ".pgm";
+			case ImageFileFormat::raw:   return ".raw";
+		}
+		return "";
+	}
+
+	static std::size_t channelCount(Image const& image) {
+		return image.dataTypeSize() / sizeof(float);
+	}
+
+	static bool writePFM(Image const& image, std::ofstream& file) {
+		std::size_t const channels = channelCount(image);
+		if (channels != 1 && channels != 3) {
+			return false;
+		}
+		auto const size = image.size();
+		/// Negative scale means little endian
+		file << (channels == 1 ? "Pf" : "PF") << "\n" << size.x << " " << size.y << "\n"
+			 << (std::endian::native == std::endian::little ? "-1.0" : "1.0") << "\n";
+		/// PFM stores rows bottom to top
+		for (std::size_t y = size.y; y-- > 0;) {
+			float const* row = image.data() + y * size.x * channels;
+			file.write(reinterpret_cast<char const*>(row), std::streamsize(size.x * channels * sizeof(float)));
+		}
+		return true;
+	}
+
+	static bool writePGM16(Image const& image, std::ofstream& file) {
+		if (channelCount(image) != 1) {
+			return false;
+		}
+		auto const size = image.size();
+		file << "P5\n" << size.x << " " << size.y << "\n65535\n";
+		for (std::size_t i = 0, end = size.x * size.y; i < end; ++i) {
+			auto const value = (std::uint16_t)std::lround(std::clamp(image.data()[i], 0.0f, 1.0f) * 65535.0f);
+			/// PGM is big endian
+			char const bytes[2] = { char(value >> 8), char(value & 0xFF) };
+			file.write(bytes, 2);
+		}
+		return true;
+	}
+
+	static bool writeRaw(Image const& image, std::ofstream& file) {
+		auto const size = image.size();
+		std::size_t const floatCount = size.x * size.y * channelCount(image);
+		if constexpr (std::endian::native == std::endian::little) {
+			file.write(reinterpret_cast<char const*>(image.data()), std::streamsize(floatCount * sizeof(float)));
+		}
+		else {
+			for (std::size_t i = 0; i < floatCount; ++i) {
+				auto const bits = std::bit_cast<std::uint32_t>(image.data()[i]);
+				char const bytes[4] = { char(bits), char(bits >> 8), char(bits >> 16), char(bits >> 24) };
+				file.write(bytes, 4);
+			}
+		}
+		return true;
+	}
+
+	bool exportImage(Image const& image, std::filesystem::path const& path, ImageFileFormat format) {
+		if (isCompactDataType(image.dataType())) {
+			return exportImage(decodeImage(image), path, format);
+		}
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		if (!file) {
+			WM_Log(error, "Failed to open \"{}\" for writing", path.string());
+			return false;
+		}
+		bool supported = false;
+		switch (format) {
+			case ImageFileFormat::pfm:   supported = writePFM(image, file); break;
+			case ImageFileFormat::pgm16: supported = writePGM16(image, file); break;
+			case ImageFileFormat::raw:   supported = writeRaw(image, file); break;
+		}
+		if (!supported) {
+			WM_Log(error, "Format '{}' can't store {} channel images", fileExtension(format), channelCount(image));
+			file.close();
+			std::filesystem::remove(path);
+			return false;
+		}
+		return (bool)file;
+	}
+
+}
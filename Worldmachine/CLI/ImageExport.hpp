@@ -0,0 +1,26 @@
+#pragma once
+
+#include <filesystem>
+#include <optional>
+#include <string_view>
+
+namespace worldmachine {
+
+	class Image;
+
+	enum struct ImageFileFormat {
+		/// Portable float map, 1 or 3 channels
+		pfm,
+		/// 16 bit binary greymap, 1 channel, values clamped to [0, 1]
+		pgm16,
+		/// Headerless little endian float32, channels interleaved
+		raw
+	};
+
+	std::optional<ImageFileFormat> imageFileFormatFromString(std::string_view);
+	std::string_view fileExtension(ImageFileFormat);
+
+	/// Returns false if the format can't represent the image or the file couldn't be written.
+	bool exportImage(Image const&, std::filesystem::path const&, ImageFileFormat);
+
+}
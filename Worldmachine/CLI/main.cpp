@@ -0,0 +1,239 @@
+#include <iostream>
+#include <optional>
+#include <filesystem>
+#include <string_view>
+#include <utl/vector.hpp>
+#include <utl/messenger.hpp>
+#include <utl/scope_guard.hpp>
+
+#include "Core/Debug.hpp"
+#include "Core/PluginManager.hpp"
+#include "Core/BuildSystem.hpp"
+#include "Core/Network/Network.hpp"
+#include "Core/Network/NetworkSerialize.hpp"
+#include "Core/Network/NodeImplementation.hpp"
+
+#include "ArgumentParser.hpp"
+#include "ImageExport.hpp"
+
+using namespace worldmachine;
+
+namespace {
+
+	struct Options {
+		std::filesystem::path networkFile;
+		std::filesystem::path outputDirectory = ".";
+		std::optional<std::filesystem::path> plugin;
+		std::optional<mtl::usize2> resolution;
+		std::optional<std::size_t> threads;
+		std::optional<std::filesystem::path> trace;
+		utl::vector<std::string> nodes;
+		ImageFileFormat format = ImageFileFormat::pfm;
+		bool useCache = true;
+	};
+
+	constexpr char const* usage = R"(usage: wmbuild <network file> [options]
+
+Builds the leaf nodes of a network without a GUI and writes their outputs as
+'<output-dir>/<node name>_<output index>.<ext>'.
+
+options:
+  -o, --output <dir>          Output directory, default '.'
+  -r, --resolution <N | WxH>  Build resolution, default the one stored in the file or 1024
+  -j, --threads <N>           Number of worker threads, default all cores
+  -n, --node <name>           Build this node instead of all leaves, may be repeated
+  -f, --format <pfm|pgm|raw>  Output file format, default pfm
+      --plugin <path>         Node plugin to load, default the builtin nodes next to this executable
+      --no-cache              Don't read or write the node output cache
+      --trace <file>          Write a Chrome trace of the build, open it in Perfetto or chrome://tracing
+  -h, --help                  Print this message
+)";
+
+	std::optional<mtl::usize2> parseResolution(std::string_view str) {
+		auto const x = str.find('x');
+		if (x == std::string_view::npos) {
+			auto const n = parseNumber(str);
+			return n ? std::optional(mtl::usize2(*n, *n)) : std::nullopt;
+		}
+		auto const w = parseNumber(str.substr(0, x));
+		auto const h = parseNumber(str.substr(x + 1));
+		return w && h ? std::optional(mtl::usize2(*w, *h)) : std::nullopt;
+	}
+
+	std::optional<Options> parseOptions(int argc, char const* const* argv) {
+		Options options;
+		bool haveFile = false;
+		for (ArgumentParser args(argc, argv); args.next();) {
+			std::string_view const arg = args.current();
+			if (arg == "-h" || arg == "--help") {
+				return std::nullopt;
+			}
+			else if (arg == "-o" || arg == "--output") {
+				auto v = args.value(); if (!v) return std::nullopt;
+				options.outputDirectory = *v;
+			}
+			else if (arg == "-r" || arg == "--resolution") {
+				auto v = args.value(); if (!v) return std::nullopt;
+				auto resolution = parseResolution(*v);
+				if (!resolution) {
+					std::cerr << "Invalid resolution '" << *v << "'\n";
+					return std::nullopt;
+				}
+				options.resolution = *resolution;
+			}
+			else if (arg == "-j" || arg == "--threads") {
+				options.threads = args.number();
+				if (!options.threads) return std::nullopt;
+			}
+			else if (arg == "-n" || arg == "--node") {
+				auto v = args.value(); if (!v) return std::nullopt;
+				options.nodes.push_back(std::string(*v));
+			}
+			else if (arg == "-f" || arg == "--format") {
+				auto v = args.value(); if (!v) return std::nullopt;
+				auto format = imageFileFormatFromString(*v);
+				if (!format) {
+					std::cerr << "Unknown format '" << *v << "'\n";
+					return std::nullopt;
+				}
+				options.format = *format;
+			}
+			else if (arg == "--plugin") {
+				auto v = args.value(); if (!v) return std::nullopt;
+				options.plugin = *v;
+			}
+			else if (arg == "--trace") {
+				auto v = args.value(); if (!v) return std::nullopt;
+				options.trace = *v;
+			}
+			else if (arg == "--no-cache") {
+				options.useCache = false;
+			}
+			else if (!arg.starts_with("-") && !haveFile) {
+				options.networkFile = arg;
+				haveFile = true;
+			}
+			else {
+				std::cerr << "Unexpected argument '" << arg << "'\n";
+				return std::nullopt;
+			}
+		}
+		if (!haveFile) {
+			return std::nullopt;
+		}
+		return options;
+	}
+
+	/// Node names may contain anything
+	std::string sanitizeFileName(std::string_view name) {
+		std::string result(name);
+		for (char& c: result) {
+			if (c == '/' || c == '\\' || c == ':' || c == ' ') {
+				c = '_';
+			}
+		}
+		return result;
+	}
+
+}
+
+int main(int argc, char const* const* argv) {
+	/// Log records are printed by a background thread, get them out before we exit.
+	utl::scope_guard flushGuard = []{ flushLog(); };
+	auto const options = parseOptions(argc, argv);
+	if (!options) {
+		std::cerr << usage;
+		return 2;
+	}
+
+	auto& plugins = PluginManager::instance();
+	auto const pluginPath = options->plugin.value_or(defaultPluginPath(argv[0]));
+	plugins.loadPlugin(pluginPath);
+	if (plugins.getLoadedPlugins().empty()) {
+		std::cerr << "Failed to load node plugin " << pluginPath << "\n";
+		return 1;
+	}
+
+	auto network = Network::create();
+	NetworkFileInfo fileInfo;
+	if (!loadNetworkFile(*network, options->networkFile, &fileInfo)) {
+		std::cerr << "Failed to parse " << options->networkFile << "\n";
+		return 1;
+	}
+
+	utl::vector<std::size_t> targets;
+	if (options->nodes.empty()) {
+		auto const leaves = network->gatherLeafNodes();
+		targets.assign(leaves.begin(), leaves.end());
+	}
+	for (auto const& name: options->nodes) {
+		std::size_t nodeIndex = 0;
+		while (nodeIndex < network->nodeCount() && network->nodes[nodeIndex].name != name) {
+			++nodeIndex;
+		}
+		if (nodeIndex == network->nodeCount()) {
+			std::cerr << "No node named '" << name << "'\n";
+			return 1;
+		}
+		targets.push_back(nodeIndex);
+	}
+
+	auto buildSystem = BuildSystem::create();
+	auto const resolution = options->resolution.value_or(fileInfo.resolution.value_or(mtl::usize2(1024)));
+	if (fileInfo.resolution && *fileInfo.resolution != resolution) {
+		/// Embedded images have the wrong size.
+		network->invalidateAllNodes(BuildType::highResolution);
+	}
+	buildSystem->setResolution(resolution);
+	if (options->threads) {
+		buildSystem->setNumberOfThreads(*options->threads);
+	}
+	if (!options->useCache) {
+		buildSystem->setOutputCacheDirectory(std::nullopt);
+	}
+	buildSystem->setTracing(options->trace.has_value());
+
+	utl::messenger messenger;
+	auto listeners = buildSystem->makeListeners();
+	[[maybe_unused]] auto listenerIDs = messenger.register_listeners(listeners.begin(), listeners.end());
+	auto const targetIDs = network->IDsFromIndices(targets);
+	messenger.send_message(BuildRequest{
+		BuildType::highResolution,
+		network.get(),
+		utl::vector<utl::UUID>(targetIDs.begin(), targetIDs.end())
+	});
+	buildSystem->waitForBuild();
+	if (options->trace) {
+		if (auto const trace = buildSystem->lastTrace(); !trace || !trace->writeChromeTrace(*options->trace)) {
+			std::cerr << "Failed to write the build trace to " << *options->trace << "\n";
+		}
+	}
+
+	std::error_code ec;
+	std::filesystem::create_directories(options->outputDirectory, ec);
+	int result = 0;
+	for (std::size_t const nodeIndex: targets) {
+		auto const& name = network->nodes[nodeIndex].name;
+		auto const* impl = network->nodes[nodeIndex].implementation.get();
+		if (impl->type() != NodeType::image || !impl->built()) {
+			std::cerr << "Node '" << name << "' was not built\n";
+			result = 1;
+			continue;
+		}
+		auto const* imageNode = static_cast<ImageNodeImplementation const*>(impl);
+		std::size_t const outputCount = network->nodes[nodeIndex].pinDescriptorArray.output.size();
+		if (outputCount == 0) {
+			WM_Log(warning, "Node '{}' has no outputs", name);
+		}
+		for (std::size_t i = 0; i < outputCount; ++i) {
+			auto path = options->outputDirectory / (sanitizeFileName(name) + "_" + std::to_string(i));
+			path += fileExtension(options->format);
+			if (!exportImage(imageNode->highResImage(i), path, options->format)) {
+				result = 1;
+				continue;
+			}
+			std::cout << path.string() << "\n";
+		}
+	}
+	return result;
+}
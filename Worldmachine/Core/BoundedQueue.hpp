@@ -0,0 +1,89 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+#include "Core/Debug.hpp"
+
+namespace worldmachine {
+
+	/// Fixed capacity queue for many producers and one consumer. Pushing never
+	/// blocks and never takes a lock, it fails if the queue is full. Each cell
+	/// carries a sequence number telling whether it is free for the producer
+	/// that claimed its position or filled for the consumer.
+	template <typename T>
+	class BoundedQueue {
+	public:
+		/// 'capacity' must be a power of two.
+		explicit BoundedQueue(std::size_t capacity):
+			cells(std::make_unique<Cell[]>(capacity)),
+			mask(capacity - 1)
+		{
+			WM_Expect(capacity >= 2 && (capacity & (capacity - 1)) == 0);
+			for (std::size_t i = 0; i < capacity; ++i) {
+				cells[i].sequence.store(i, std::memory_order_relaxed);
+			}
+		}
+
+		BoundedQueue(BoundedQueue const&) = delete;
+		BoundedQueue& operator=(BoundedQueue const&) = delete;
+
+		std::size_t capacity() const { return mask + 1; }
+
+		/// Any thread. Leaves 'value' untouched and returns false if the queue is full.
+		bool tryPush(T&& value) {
+			std::size_t position = enqueuePosition.load(std::memory_order_relaxed);
+			while (true) {
+				Cell& cell = cells[position & mask];
+				std::size_t const sequence = cell.sequence.load(std::memory_order_acquire);
+				auto const difference = (std::intptr_t)sequence - (std::intptr_t)position;
+				if (difference == 0) {
+					if (enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+						cell.value = std::move(value);
+						cell.sequence.store(position + 1, std::memory_order_release);
+						return true;
+					}
+				}
+				else if (difference < 0) {
+					/// The consumer has not freed this cell yet
+					return false;
+				}
+				else {
+					position = enqueuePosition.load(std::memory_order_relaxed);
+				}
+			}
+		}
+
+		/// Consumer thread only
+		bool tryPop(T& value) {
+			Cell& cell = cells[dequeuePosition & mask];
+			std::size_t const sequence = cell.sequence.load(std::memory_order_acquire);
+			if ((std::intptr_t)sequence - (std::intptr_t)(dequeuePosition + 1) < 0) {
+				return false;
+			}
+			value = std::move(cell.value);
+			cell.sequence.store(dequeuePosition + capacity(), std::memory_order_release);
+			++dequeuePosition;
+			return true;
+		}
+
+		/// Number of successful pushes so far
+		std::size_t pushed() const { return enqueuePosition.load(std::memory_order_acquire); }
+
+	private:
+		struct Cell {
+			std::atomic<std::size_t> sequence;
+			T value;
+		};
+
+		std::unique_ptr<Cell[]> cells;
+		std::size_t mask;
+		/// Producers and the consumer write different cache lines
+		alignas(64) std::atomic<std::size_t> enqueuePosition = 0;
+		alignas(64) std::size_t dequeuePosition = 0;
+	};
+
+}
@@ -1,21 +1,75 @@
 #pragma once
 
+#include <atomic>
+#include <optional>
+#include <algorithm>
+#include <concepts>
 #include <utl/vector.hpp>
 #include <utl/functional.hpp>
 
 namespace worldmachine {
-	
+
+	/// Half open range of output rows
+	struct RowRange {
+		std::size_t begin, end;
+	};
+
+	/// Passed to jobs that accept it. Long running kernels should poll it every
+	/// few milliseconds of work and return early once it is set, the output of
+	/// a cancelled job is discarded.
+	class CancellationToken {
+	public:
+		CancellationToken() = default;
+		CancellationToken(std::atomic_bool const* build, std::atomic_bool const* node):
+			build(build), node(node) {}
+
+		bool cancelled() const {
+			return (build && build->load(std::memory_order_relaxed)) ||
+				   (node && node->load(std::memory_order_relaxed));
+		}
+
+	private:
+		std::atomic_bool const* build = nullptr;
+		std::atomic_bool const* node = nullptr;
+	};
+
 	class BuildJob {
 		friend class BuildSystem;
+
+		using Function = utl::function<void(CancellationToken const&)>;
+
+		struct Entry {
+			Function function;
+			std::optional<RowRange> rows;
+		};
+
 	public:
-		void add(utl::function<void()> f) {
-			jobs.push_back(std::move(f));
+		/// 'f' is invocable either with no arguments or with a 'CancellationToken const&'.
+		template <typename F>
+		void add(F&& f) {
+			jobs.push_back({ wrap(std::forward<F>(f)), std::nullopt });
+		}
+
+		/// Adds a job that writes exactly the output rows in 'rows'. If all jobs
+		/// of a node are added this way, downstream nodes that declare a row
+		/// footprint can start on a band as soon as the rows it reads are done.
+		/// The rows must be final when the job returns.
+		template <typename F>
+		void add(RowRange rows, F&& f) {
+			jobs.push_back({ wrap(std::forward<F>(f)), rows });
+		}
+
+		/// Jobs added after this call start only once all jobs added before it have finished.
+		void barrier() {
+			if (!jobs.empty() && (barriers.empty() || barriers.back() != jobs.size())) {
+				barriers.push_back(jobs.size());
+			}
 		}
 		
 		void reserve(std::size_t size) {
 			jobs.reserve(size);
 		}
-		
+
 		void onCompletion(utl::function<void()> f) {
 			completionHandler = std::move(f);
 		}
@@ -25,18 +79,42 @@ namespace worldmachine {
 		void onCleanup(utl::function<void()> f) {
 			cleanupHandler = std::move(f);
 		}
-		
+
 	private:
+		template <typename F>
+		static Function wrap(F&& f) {
+			if constexpr (std::invocable<F&, CancellationToken const&>) {
+				return Function(std::forward<F>(f));
+			}
+			else {
+				return [f = std::forward<F>(f)](CancellationToken const&) mutable { f(); };
+			}
+		}
+
 		bool hasJobs() const { return index < jobs.size(); }
-		utl::function<void()> consumeOne() {
+		Entry consumeOne() {
 			return std::move(jobs[index++]);
 		}
 		
+		/// Index one past the last job that may run before the next barrier
+		std::size_t phaseEnd() const {
+			auto const itr = std::upper_bound(barriers.begin(), barriers.end(), index);
+			return itr == barriers.end() ? jobs.size() : *itr;
+		}
+
 		float oneProgress() const { return 1.0f / jobs.size(); }
-		
-		utl::vector<utl::function<void()>> jobs;
+
+		/// True iff every job declares its rows and no handler touches the output afterwards
+		bool rowBanded() const {
+			return !completionHandler && barriers.empty() && std::all_of(jobs.begin(), jobs.end(), [](Entry const& e) {
+				return e.rows.has_value();
+			});
+		}
+
+		utl::vector<Entry> jobs;
+		utl::vector<std::size_t> barriers;
 		utl::function<void()> completionHandler, failureHandler, cleanupHandler;
 		std::size_t index = 0;
 	};
-	
+
 }
@@ -0,0 +1,149 @@
+#include "BuildPlan.hpp"
+
+#include <numeric>
+#include <algorithm>
+
+#include "Core/Debug.hpp"
+#include "Core/Network/Network.hpp"
+
+namespace worldmachine {
+
+	namespace {
+		/// Builds a CSR adjacency from (from, to) pairs: targets of 'from' live in [offsets[from], offsets[from + 1])
+		void buildCSR(std::size_t vertexCount,
+					  std::span<std::pair<std::uint32_t, std::uint32_t> const> pairs,
+					  utl::vector<std::uint32_t>& offsets,
+					  utl::vector<std::uint32_t>& targets)
+		{
+			offsets.assign(vertexCount + 1, 0);
+			for (auto [from, to]: pairs) {
+				++offsets[from + 1];
+			}
+			std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+			targets.resize(pairs.size());
+			utl::vector<std::uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+			for (auto [from, to]: pairs) {
+				targets[cursor[from]++] = to;
+			}
+		}
+	}
+
+	BuildPlan::BuildPlan(Network const* network,
+						 std::span<std::size_t const> leafIndices,
+						 utl::function<bool(std::size_t)> const& isBuilt)
+	{
+		std::size_t const nodeCount = network->nodeCount();
+
+		auto const& adjacency = network->adjacency();
+		auto const& upstreamOffsets = adjacency.upstreamOffsets;
+		auto const& upstream = adjacency.upstreamIndices;
+
+		/// Gather all unbuilt nodes upstream of the leaves. A built node has
+		/// only built nodes upstream, so we don't need to look past it.
+		constexpr auto npos = std::uint32_t(-1);
+		utl::vector<std::uint32_t> localIndex(nodeCount, npos);
+		utl::vector<bool> visited(nodeCount);
+		utl::vector<std::size_t> members;
+		utl::small_vector<std::size_t> stack(leafIndices.begin(), leafIndices.end());
+		while (!stack.empty()) {
+			std::size_t const nodeIndex = stack.back();
+			stack.pop_back();
+			if (visited[nodeIndex]) {
+				continue;
+			}
+			visited[nodeIndex] = true;
+			if (isBuilt(nodeIndex)) {
+				_builtDependencies.push_back(nodeIndex);
+				continue;
+			}
+			localIndex[nodeIndex] = (std::uint32_t)members.size();
+			members.push_back(nodeIndex);
+			for (auto i = upstreamOffsets[nodeIndex]; i < upstreamOffsets[nodeIndex + 1]; ++i) {
+				stack.push_back(upstream[i]);
+			}
+		}
+
+		/// Edges between members. Parallel edges are kept on purpose, each one
+		/// counts as a predecessor and is released once.
+		utl::vector<std::pair<std::uint32_t, std::uint32_t>> localPairs;
+		for (std::size_t nodeIndex: members) {
+			auto const to = localIndex[nodeIndex];
+			for (auto i = upstreamOffsets[nodeIndex]; i < upstreamOffsets[nodeIndex + 1]; ++i) {
+				auto const from = localIndex[upstream[i]];
+				if (from != npos) {
+					localPairs.push_back({ from, to });
+				}
+			}
+		}
+		utl::vector<std::uint32_t> localOffsets, localSuccessors;
+		buildCSR(members.size(), localPairs, localOffsets, localSuccessors);
+
+		/// Kahn's algorithm
+		utl::vector<std::uint32_t> inDegree(members.size(), 0);
+		for (auto [from, to]: localPairs) {
+			++inDegree[to];
+		}
+		utl::vector<std::uint32_t> order;
+		order.reserve(members.size());
+		for (std::uint32_t i = 0; i < members.size(); ++i) {
+			if (inDegree[i] == 0) {
+				order.push_back(i);
+			}
+		}
+		utl::vector<std::uint32_t> remaining = inDegree;
+		for (std::size_t head = 0; head < order.size(); ++head) {
+			auto const current = order[head];
+			for (auto i = localOffsets[current]; i < localOffsets[current + 1]; ++i) {
+				if (--remaining[localSuccessors[i]] == 0) {
+					order.push_back(localSuccessors[i]);
+				}
+			}
+		}
+		WM_Assert(order.size() == members.size(), "Network must be acyclic");
+
+		/// Renumber everything in topological order.
+		utl::vector<std::uint32_t> planIndexOf(members.size());
+		_nodeIndices.reserve(members.size());
+		for (std::uint32_t planIndex = 0; auto local: order) {
+			planIndexOf[local] = planIndex++;
+			_nodeIndices.push_back(members[local]);
+		}
+		for (auto& [from, to]: localPairs) {
+			from = planIndexOf[from];
+			to = planIndexOf[to];
+		}
+		buildCSR(members.size(), localPairs, _successorOffsets, _successors);
+		for (auto& [from, to]: localPairs) {
+			std::swap(from, to);
+		}
+		buildCSR(members.size(), localPairs, _predecessorOffsets, _predecessors);
+
+		_state = std::make_unique<NodeState[]>(members.size());
+		for (std::uint32_t local = 0; local < members.size(); ++local) {
+			auto const planIndex = planIndexOf[local];
+			_state[planIndex].unbuiltPredecessors = inDegree[local];
+			if (inDegree[local] == 0) {
+				_roots.push_back(planIndex);
+			}
+		}
+	}
+
+	void BuildPlan::prioritize(std::size_t nodeIndex) {
+		auto const itr = std::find(_nodeIndices.begin(), _nodeIndices.end(), nodeIndex);
+		if (itr == _nodeIndices.end()) {
+			return;
+		}
+		/// Predecessors have smaller plan indices, so one backwards sweep reaches all of them.
+		std::size_t const target = std::size_t(itr - _nodeIndices.begin());
+		_state[target].priority = true;
+		for (std::size_t planIndex = target + 1; planIndex-- > 0;) {
+			if (!_state[planIndex].priority) {
+				continue;
+			}
+			for (std::uint32_t const predecessor: predecessors(planIndex)) {
+				_state[predecessor].priority = true;
+			}
+		}
+	}
+
+}
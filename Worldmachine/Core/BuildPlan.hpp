@@ -0,0 +1,115 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <span>
+#include <cstdint>
+#include <utl/vector.hpp>
+#include <utl/functional.hpp>
+
+#include "BuildJob.hpp"
+
+namespace worldmachine {
+
+	class Network;
+
+	/// Dependency graph of a single build, computed once when the build starts.
+	/// Contains every unbuilt node upstream of the requested leaves. Plan indices
+	/// are assigned in topological order, successors and predecessors are stored
+	/// in CSR form.
+	class BuildPlan {
+	public:
+		/// Job of a downstream node waiting for rows of its upstream nodes.
+		struct PendingTile {
+			RowRange footprint;
+			std::atomic<std::uint32_t> missingSources = 1;
+			bool priority = false;
+			utl::function<void()> task;
+		};
+		
+		struct NodeState {
+			std::atomic<std::uint32_t> unbuiltPredecessors = 0;
+			std::atomic<std::size_t> remainingJobs = 0;
+			std::atomic_bool incomplete = false;
+			/// An upstream node was edited during the build. The node stops
+			/// as soon as possible and is not marked built.
+			std::atomic_bool stale = false;
+			/// Fraction of this node's jobs that have run, UINT_MAX being all of them.
+			/// Published to the network at a throttled rate.
+			std::atomic<std::uint32_t> progress = 0;
+			/// Set once before any successor is released. If true, successors with
+			/// a row footprint were released when this node started, not when it finished.
+			std::atomic_bool rowBanded = false;
+			bool loadedFromCache = false;
+			/// Successors in this plan that have not finished reading our outputs yet
+			std::atomic<std::uint32_t> pendingConsumers = 0;
+			/// True iff all downstream nodes in the network are part of this plan
+			bool evictable = false;
+			/// Requested or looked at by the user, outputs are never handed to an in-place consumer
+			bool requested = false;
+			/// Upstream of the node the user is looking at, see prioritize()
+			bool priority = false;
+			/// Rows of the outputs needed by the requested region. Jobs of row
+			/// banded nodes outside of them are skipped.
+			RowRange neededRows{ 0, 0 };
+			/// Outputs are only valid in 'neededRows', because rows were skipped here or upstream.
+			bool partial = false;
+			BuildJob job;
+			
+			std::mutex rowMutex;
+			utl::vector<bool> rowDone;
+			utl::vector<std::shared_ptr<PendingTile>> waitingTiles;
+		};
+
+	public:
+		BuildPlan(Network const* network,
+				  std::span<std::size_t const> leafIndices,
+				  utl::function<bool(std::size_t)> const& isBuilt);
+
+		std::size_t size() const { return _nodeIndices.size(); }
+		bool empty() const { return size() == 0; }
+
+		/// Node indices in topological order
+		std::span<std::size_t const> nodeIndices() const { return _nodeIndices; }
+		std::size_t nodeIndex(std::size_t planIndex) const { return _nodeIndices[planIndex]; }
+
+		/// Already built nodes that feed directly into a node of this plan
+		std::span<std::size_t const> builtDependencies() const { return _builtDependencies; }
+
+		std::span<std::uint32_t const> successors(std::size_t planIndex) const {
+			return { _successors.data() + _successorOffsets[planIndex],
+					 _successors.data() + _successorOffsets[planIndex + 1] };
+		}
+
+		std::span<std::uint32_t const> predecessors(std::size_t planIndex) const {
+			return { _predecessors.data() + _predecessorOffsets[planIndex],
+					 _predecessors.data() + _predecessorOffsets[planIndex + 1] };
+		}
+		
+		/// Plan indices without unbuilt predecessors
+		std::span<std::uint32_t const> roots() const { return _roots; }
+
+		NodeState& state(std::size_t planIndex) { return _state[planIndex]; }
+
+		/// Sets 'priority' on the node and everything upstream of it in this plan.
+		/// Does nothing if the node is not part of the plan.
+		void prioritize(std::size_t nodeIndex);
+
+		/// Returns true iff this released the last unbuilt predecessor, i.e. the node is ready.
+		bool releasePredecessor(std::size_t planIndex) {
+			return --_state[planIndex].unbuiltPredecessors == 0;
+		}
+
+	private:
+		utl::vector<std::size_t> _nodeIndices;
+		utl::vector<std::size_t> _builtDependencies;
+		utl::vector<std::uint32_t> _successorOffsets;
+		utl::vector<std::uint32_t> _successors;
+		utl::vector<std::uint32_t> _predecessorOffsets;
+		utl::vector<std::uint32_t> _predecessors;
+		utl::vector<std::uint32_t> _roots;
+		std::unique_ptr<NodeState[]> _state;
+	};
+
+}
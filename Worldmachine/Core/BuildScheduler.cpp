@@ -0,0 +1,156 @@
+#include "BuildScheduler.hpp"
+
+#include "Core/Debug.hpp"
+
+namespace worldmachine {
+
+	namespace {
+		thread_local BuildScheduler const* tlsScheduler = nullptr;
+		thread_local long tlsWorkerIndex = -1;
+	}
+
+	BuildScheduler::BuildScheduler(std::size_t numThreads) {
+		startWorkers(numThreads);
+	}
+
+	BuildScheduler::~BuildScheduler() {
+		stopWorkers();
+	}
+
+	void BuildScheduler::setNumThreads(std::size_t numThreads) {
+		WM_Expect(numThreads > 0);
+		WM_Expect(pendingTasks == 0, "Can't resize the thread pool while tasks are in flight");
+		if (numThreads == this->numThreads()) {
+			return;
+		}
+		stopWorkers();
+		startWorkers(numThreads);
+	}
+
+	void BuildScheduler::push(Task task, Priority priority) {
+		WM_Assert(!workers.empty());
+		++pendingTasks;
+		if (priority == Priority::high) {
+			std::lock_guard lock(priorityMutex);
+			priorityTasks.push_back(std::move(task));
+			++priorityTaskCount;
+			++queuedTasks;
+		}
+		else {
+			long const self = currentWorkerIndex();
+			std::size_t const index = self >= 0 ? (std::size_t)self : roundRobin++ % workers.size();
+			auto& worker = *workers[index];
+			std::lock_guard lock(worker.mutex);
+			worker.tasks.push_back(std::move(task));
+			/// Counted under the queue lock so a pop can never observe the task before the count.
+			++queuedTasks;
+		}
+		{
+			/// Taking the sleep mutex orders this notify after any in-progress predicate check.
+			std::lock_guard lock(sleepMutex);
+		}
+		sleepCV.notify_one();
+	}
+
+	void BuildScheduler::waitIdle() {
+		WM_Expect(currentWorkerIndex() == -1, "Waiting from a worker would deadlock");
+		std::unique_lock lock(sleepMutex);
+		idleCV.wait(lock, [this]{ return pendingTasks == 0; });
+	}
+
+	long BuildScheduler::currentWorkerIndex() const {
+		return tlsScheduler == this ? tlsWorkerIndex : -1;
+	}
+
+	void BuildScheduler::startWorkers(std::size_t numThreads) {
+		WM_Assert(workers.empty());
+		terminate = false;
+		workers.reserve(numThreads);
+		for (std::size_t i = 0; i < numThreads; ++i) {
+			workers.push_back(std::make_unique<Worker>());
+		}
+		/// Launch only after all queues exist so thieves never see a partially built pool.
+		for (std::size_t i = 0; i < numThreads; ++i) {
+			workers[i]->thread = std::thread([this, i]{ workerMain(i); });
+		}
+	}
+
+	void BuildScheduler::stopWorkers() {
+		{
+			std::lock_guard lock(sleepMutex);
+			terminate = true;
+		}
+		sleepCV.notify_all();
+		for (auto& worker: workers) {
+			if (worker->thread.joinable()) {
+				worker->thread.join();
+			}
+		}
+		workers.clear();
+	}
+
+	void BuildScheduler::workerMain(std::size_t index) {
+		tlsScheduler = this;
+		tlsWorkerIndex = (long)index;
+		while (true) {
+			Task task;
+			if (tryPopPriority(task) || tryPop(index, task) || trySteal(index, task)) {
+				task();
+				if (--pendingTasks == 0) {
+					std::lock_guard lock(sleepMutex);
+					idleCV.notify_all();
+				}
+				continue;
+			}
+			std::unique_lock lock(sleepMutex);
+			sleepCV.wait(lock, [this]{ return terminate || queuedTasks > 0; });
+			if (terminate && queuedTasks == 0) {
+				return;
+			}
+		}
+	}
+
+	bool BuildScheduler::tryPopPriority(Task& task) {
+		if (priorityTaskCount.load(std::memory_order_relaxed) == 0) {
+			return false;
+		}
+		std::lock_guard lock(priorityMutex);
+		if (priorityTasks.empty()) {
+			return false;
+		}
+		task = std::move(priorityTasks.front());
+		priorityTasks.pop_front();
+		--priorityTaskCount;
+		--queuedTasks;
+		return true;
+	}
+
+	bool BuildScheduler::tryPop(std::size_t index, Task& task) {
+		auto& worker = *workers[index];
+		std::lock_guard lock(worker.mutex);
+		if (worker.tasks.empty()) {
+			return false;
+		}
+		task = std::move(worker.tasks.back());
+		worker.tasks.pop_back();
+		--queuedTasks;
+		return true;
+	}
+
+	bool BuildScheduler::trySteal(std::size_t thiefIndex, Task& task) {
+		std::size_t const count = workers.size();
+		for (std::size_t offset = 1; offset < count; ++offset) {
+			auto& victim = *workers[(thiefIndex + offset) % count];
+			std::lock_guard lock(victim.mutex);
+			if (victim.tasks.empty()) {
+				continue;
+			}
+			task = std::move(victim.tasks.front());
+			victim.tasks.pop_front();
+			--queuedTasks;
+			return true;
+		}
+		return false;
+	}
+
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <utl/vector.hpp>
+#include <utl/functional.hpp>
+
+namespace worldmachine {
+
+	/// Pool of worker threads, each owning a double ended task queue.
+	/// Workers push to and pop from the back of their own queue (LIFO, keeps
+	/// continuations hot in cache) and steal from the front of the other
+	/// queues when they run dry.
+	class BuildScheduler {
+	public:
+		using Task = utl::function<void()>;
+
+		enum class Priority {
+			normal,
+			/// Taken by the next idle worker before any other task, in FIFO order.
+			high
+		};
+
+	public:
+		explicit BuildScheduler(std::size_t numThreads);
+		~BuildScheduler();
+
+		BuildScheduler(BuildScheduler const&) = delete;
+		BuildScheduler& operator=(BuildScheduler const&) = delete;
+
+		std::size_t numThreads() const { return workers.size(); }
+
+		/// Must not be called while tasks are in flight.
+		void setNumThreads(std::size_t);
+
+		/// Called from a worker thread the task goes to the back of that
+		/// worker's queue, otherwise queues are filled round robin. High
+		/// priority tasks go to a queue shared by all workers.
+		void push(Task, Priority = Priority::normal);
+
+		/// Blocks until every task pushed so far, including tasks pushed by
+		/// those tasks, has run.
+		void waitIdle();
+
+		/// Index of the calling worker thread in this scheduler or -1.
+		long currentWorkerIndex() const;
+
+	private:
+		struct Worker {
+			std::mutex mutex;
+			std::deque<Task> tasks;
+			std::thread thread;
+		};
+
+		void startWorkers(std::size_t numThreads);
+		void stopWorkers();
+		void workerMain(std::size_t index);
+		bool tryPopPriority(Task& task);
+		bool tryPop(std::size_t index, Task& task);
+		bool trySteal(std::size_t thiefIndex, Task& task);
+
+	private:
+		utl::vector<std::unique_ptr<Worker>> workers;
+		std::mutex priorityMutex;
+		std::deque<Task> priorityTasks;
+		/// Lets workers skip the priority lock while the queue is empty, which it is most of the time.
+		std::atomic<std::size_t> priorityTaskCount = 0;
+		std::mutex sleepMutex;
+		std::condition_variable sleepCV;
+		std::condition_variable idleCV;
+		std::atomic<std::size_t> queuedTasks = 0;
+		std::atomic<std::size_t> pendingTasks = 0;
+		std::atomic<std::size_t> roundRobin = 0;
+		bool terminate = false;
+	};
+
+}
@@ -2,20 +2,23 @@
 #include "BuildJob.hpp"
 
 #include <span>
+#include <cmath>
+#include <algorithm>
+#include <sstream>
 #include <utl/hashset.hpp>
+#include <utl/hashmap.hpp>
+#include <yaml-cpp/yaml.h>
 
 #include "Core/Debug.hpp"
+#include "Core/Image/ImagePool.hpp"
 #include "Core/Network/Network.hpp"
 #include "Core/Network/NodeImplementation.hpp"
 #include "Core/Network/NodeDependencyMap.hpp"
 #include "Core/Network/NetworkTraversal.hpp"
 
 
-#if 1
-#define LOG_COORD(...) WM_Log(__VA_ARGS__)
-#else
-#define LOG_COORD(...)
-#endif
+/// Compiled out unless WM_LOGLEVEL_SCHEDULER enables the level
+#define LOG_SCHEDULER(level, ...) WM_LogCategory(scheduler, level, __VA_ARGS__)
 
 namespace worldmachine {
 	
@@ -60,24 +63,56 @@ namespace worldmachine {
 		}
 	}
 	
-	static void traverseUnique(Network const* network,
-							   std::span<std::size_t const> nodeIndices,
-							   utl::invocable<std::size_t> auto&& f)
+	/// Describes everything the outputs of a node depend on. Upstream nodes
+	/// contribute through their own key hash, so the text stays small.
+	static std::uint64_t makeCacheKey(Network const* network,
+									  std::size_t nodeIndex,
+									  BuildType type,
+									  mtl::usize2 resolution,
+									  mtl::usize2 previewResolution,
+									  utl::hashmap<std::size_t, NodeOutputCache::Key>& keys)
 	{
-		utl::hashset<std::size_t> visited;
-		visited.reserve(nodeIndices.size());
-		for (auto leafIndex: nodeIndices) {
-			for (std::size_t const nodeIndex: utl::reverse(NetworkTraversalView(network, leafIndex))) {
-				if (visited.insert(nodeIndex).second) {
-					f(nodeIndex);
+		if (auto itr = keys.find(nodeIndex); itr != keys.end()) {
+			return itr->second.hash;
+		}
+		auto const* impl = network->nodes[nodeIndex].implementation.get();
+		
+		YAML::Emitter parameters;
+		parameters << YAML::BeginMap;
+		impl->serializer().serialize(parameters);
+		parameters << YAML::EndMap;
+		
+		std::stringstream text;
+		text << "Implementation: " << impl->implementationID().value() << "\n";
+		text << "OutputVersion: " << impl->outputVersion() << "\n";
+		text << "BuildType: " << utl::to_underlying(type) << "\n";
+		/// Both resolutions, preview builds of some nodes scale with the ratio.
+		text << "Resolution: " << resolution.x << "x" << resolution.y << "\n";
+		text << "PreviewResolution: " << previewResolution.x << "x" << previewResolution.y << "\n";
+		text << parameters.c_str() << "\n";
+		
+		auto const edges = network->collectNodeEdges(nodeIndex);
+		auto addInputs = [&](auto const& edgeCollection, char const* kind) {
+			for (auto& edge: edgeCollection) {
+				if (!edge.present) {
+					continue;
 				}
+				auto const upstream = makeCacheKey(network, edge.beginNodeIndex, type, resolution, previewResolution, keys);
+				text << kind << " " << edge.endPinIndex << ": " << upstream << "/" << edge.beginPinIndex << "\n";
 			}
-		}
+		};
+		addInputs(edges.inputEdges, "Input");
+		addInputs(edges.maskInputEdges, "MaskInput");
 		
+		auto key = NodeOutputCache::makeKey(text.str());
+		auto const hash = key.hash;
+		keys.insert({ nodeIndex, std::move(key) });
+		return hash;
 	}
 	
 	BuildSystem::BuildSystem() {
-		
+		setOutputCacheDirectory(NodeOutputCache::defaultDirectory());
+		requestThread = std::thread([this]{ requestLoop(); });
 	}
 	
 	utl::unique_ref<BuildSystem> BuildSystem::create() {
@@ -85,58 +120,217 @@ namespace worldmachine {
 	}
 	
 	BuildSystem::~BuildSystem() {
+		{
+			std::lock_guard lock(buildMutex);
+			shuttingDown = true;
+			pendingRequests.clear();
+			pendingLevels.clear();
+		}
+		buildFinishedCV.notify_all();
+		requestThread.join();
 		if (isBuilding()) {
 			cancelCurrentBuild();
 		}
-		if (coordThread.joinable()) {
-			coordThread.join();
+		scheduler.waitIdle();
+	}
+	
+	std::optional<std::filesystem::path> BuildSystem::getOutputCacheDirectory() const {
+		if (!outputCache) {
+			return std::nullopt;
 		}
+		return outputCache->directory();
+	}
+	
+	void BuildSystem::setOutputCacheDirectory(std::optional<std::filesystem::path> directory) {
+		WM_Assert(!isBuilding());
+		if (!directory) {
+			outputCache = nullptr;
+		}
+		else if (!outputCache || outputCache->directory() != *directory) {
+			outputCache = std::make_unique<NodeOutputCache>(std::move(*directory));
+		}
+	}
+	
+	void BuildSystem::clearOutputCache() {
+		if (outputCache) {
+			outputCache->clear();
+		}
+	}
+	
+	std::shared_ptr<BuildTrace const> BuildSystem::lastTrace() const {
+		std::lock_guard lock(traceMutex);
+		return _lastTrace;
+	}
+	
+	std::optional<std::filesystem::path> BuildSystem::getTraceDirectory() const {
+		std::lock_guard lock(traceMutex);
+		return traceDirectory;
+	}
+	
+	void BuildSystem::setTraceDirectory(std::optional<std::filesystem::path> directory) {
+		std::lock_guard lock(traceMutex);
+		traceDirectory = std::move(directory);
+	}
+	
+	std::size_t BuildSystem::getMemoryBudget() const {
+		return ImagePool::instance().budget();
+	}
+	
+	void BuildSystem::setMemoryBudget(std::size_t bytes) {
+		ImagePool::instance().setBudget(bytes);
 	}
 	
 	utl::vector<utl::listener> BuildSystem::makeListeners() {
 		utl::vector<utl::listener> result;
 		result.push_back(utl::make_listener([this](BuildRequest r) {
-			this->build(r.buildType, r.network, std::move(r.nodes));
+			this->request(std::move(r));
 		}));
 		result.push_back(utl::make_listener([this](BuildCancelRequest){
 			cancelCurrentBuild();
 		}));
+		result.push_back(utl::make_listener([this](InvalidateRequest r){
+			invalidate(r.network, r.nodeID);
+		}));
+		result.push_back(utl::make_listener([this](FocusRequest r){
+			std::lock_guard lock(buildMutex);
+			focusNetwork = r.network;
+			focusNodeID = r.nodeID;
+			focusRegion = r.region;
+		}));
 		
 		return result;
 	}
 	
-	utl::small_vector<utl::UUID, 8> BuildSystem::gatherUnbuiltRoots(Network const* network,
-																	std::span<utl::UUID const> leaves) const
-	{
-		utl::hashset<utl::UUID> unbuiltRoots;
-		
-		auto const indices = network->indicesFromIDs(leaves);
-		for (auto const index: indices) {
-			for (std::size_t const nodeIndex: utl::reverse(NetworkTraversalView(network, index))) {
-				auto const nodeID = network->IDFromIndex(nodeIndex);
-				if (allUpstreamNodesAreBuilt(network, nodeIndex) &&
-					!buildingNodes.contains(nodeID) &&
-					!builtNodes.contains(nodeID))
-				{
-					unbuiltRoots.insert(network->IDFromIndex(nodeIndex));
+	void BuildSystem::request(BuildRequest r) {
+		std::unique_lock lock(buildMutex);
+		if (!isBuilding() && pendingRequests.empty() && pendingLevels.empty() && !startingBuild) {
+			pendingLevels = makeLevels(std::move(r));
+			auto level = popLevel();
+			startingBuild = true;
+			lock.unlock();
+			build(std::move(level));
+			lock.lock();
+			startingBuild = false;
+			/// Further levels are started by requestLoop().
+			buildFinishedCV.notify_all();
+			return;
+		}
+		if (!pendingLevels.empty()) {
+			/// What is left of the running request goes first and starts over at its coarsest level,
+			/// merged with the new request if that is for the same network and build type.
+			auto& last = pendingLevels.back();
+			enqueue(BuildRequest(last.type, last.network, std::move(last.nodes)), /* first = */ true);
+			pendingLevels.clear();
+		}
+		enqueue(std::move(r), /* first = */ false);
+		buildFinishedCV.notify_all();
+	}
+	
+	void BuildSystem::enqueue(BuildRequest r, bool first) {
+		auto const itr = std::find_if(pendingRequests.begin(), pendingRequests.end(), [&](BuildRequest const& pending) {
+			return pending.network == r.network && pending.buildType == r.buildType;
+		});
+		if (itr == pendingRequests.end()) {
+			pendingRequests.insert(first ? pendingRequests.begin() : pendingRequests.end(), std::move(r));
+			return;
+		}
+		/// Coalesce, no target nodes means all leaves.
+		auto& nodes = itr->nodes;
+		if (nodes.empty() || r.nodes.empty()) {
+			nodes.clear();
+			return;
+		}
+		for (auto id: r.nodes) {
+			if (std::find(nodes.begin(), nodes.end(), id) == nodes.end()) {
+				nodes.push_back(id);
+			}
+		}
+	}
+	
+	void BuildSystem::requestLoop() {
+		std::unique_lock lock(buildMutex);
+		while (true) {
+			buildFinishedCV.wait(lock, [&]{
+				return shuttingDown || ((!pendingRequests.empty() || !pendingLevels.empty()) && !isBuilding() && !startingBuild);
+			});
+			if (shuttingDown) {
+				return;
+			}
+			if (pendingLevels.empty()) {
+				pendingLevels = makeLevels(std::move(pendingRequests.front()));
+				pendingRequests.erase(pendingRequests.begin());
+			}
+			auto level = popLevel();
+			startingBuild = true;
+			lock.unlock();
+			/// Not on a worker, build() waits for the workers to go idle.
+			build(std::move(level));
+			lock.lock();
+			startingBuild = false;
+			buildFinishedCV.notify_all();
+		}
+	}
+	
+	auto BuildSystem::makeLevels(BuildRequest r) const -> utl::vector<BuildLevel> {
+		utl::vector<BuildLevel> levels;
+		if (progressiveBuilds) {
+			mtl::usize2 const target = r.buildType == BuildType::highResolution ? resolution : previewResolution;
+			/// Same aspect ratio as the preview
+			mtl::usize2 const coarse = (previewResolution * coarsePreviewSize / previewResolution.fold(utl::max)).map([](std::size_t x) {
+				return std::max<std::size_t>(x, 1);
+			});
+			for (mtl::usize2 const level: { coarse, previewResolution }) {
+				std::size_t const area = level.fold(utl::multiplies);
+				if (area >= target.fold(utl::multiplies)) {
 					break;
 				}
+				if (!levels.empty() && area <= levels.back().previewResolution.fold(utl::multiplies)) {
+					continue;
+				}
+				levels.push_back({ BuildType::preview, r.network, r.nodes, level, /* coarse = */ true });
 			}
 		}
-		
-		utl::small_vector<utl::UUID, 8> result(unbuiltRoots.begin(), unbuiltRoots.end());
-		return result;
+		bool const coversFocus = r.nodes.empty() || std::find(r.nodes.begin(), r.nodes.end(), focusNodeID) != r.nodes.end();
+		if (focusRegion && focusNetwork == r.network && coversFocus) {
+			/// What the user is looking at first, the last level fills in the rest.
+			levels.push_back({ r.buildType, r.network, { focusNodeID }, previewResolution, /* coarse = */ false, focusRegion });
+		}
+		levels.push_back({ r.buildType, r.network, std::move(r.nodes), previewResolution, /* coarse = */ false });
+		return levels;
+	}
+	
+	auto BuildSystem::popLevel() -> BuildLevel {
+		WM_Assert(!pendingLevels.empty());
+		BuildLevel level = std::move(pendingLevels.front());
+		pendingLevels.erase(pendingLevels.begin());
+		return level;
 	}
 	
-	bool BuildSystem::allUpstreamNodesAreBuilt(Network const* network, std::size_t nodeIndex) const {
-		for (std::size_t const upstreamIndex: utl::reverse(NetworkTraversalView(network, nodeIndex))) {
-			if (upstreamIndex != nodeIndex &&
-				!builtNodes.contains(network->IDFromIndex(upstreamIndex)))
-			{
-				return false;
+	void BuildSystem::invalidate(Network* network, utl::UUID nodeID) {
+		std::unique_lock lock(buildMutex);
+		/// The plan is complete once build() has returned.
+		buildFinishedCV.wait(lock, [&]{ return !startingBuild; });
+		bool const partialCancel = isBuilding() && currentNetwork == network;
+		network->locked([&]{
+			long const nodeIndex = network->indexFromID(nodeID);
+			WM_Assert(nodeIndex >= 0);
+			if (partialCancel) {
+				utl::vector<bool> downstream(network->nodeCount());
+				for (std::size_t const index: NetworkTraversalView(network, nodeIndex).unique()) {
+					downstream[index] = true;
+				}
+				std::size_t staleCount = 0;
+				for (std::size_t planIndex = 0; planIndex < plan->size(); ++planIndex) {
+					if (downstream[plan->nodeIndex(planIndex)]) {
+						plan->state(planIndex).stale = true;
+						++staleCount;
+					}
+				}
+				LOG_SCHEDULER(debug, "Cancelling {} nodes downstream of '{}'", staleCount, network->nodes[nodeIndex].name);
 			}
-		}
-		return true;
+			/// Under the same lock as nodeBuildFinished, so stale nodes never end up marked built.
+			network->invalidateNodesDownstream((std::size_t)nodeIndex);
+		});
 	}
 	
 	utl::vector<utl::UUID> BuildSystem::performSanityChecks(Network const* network,
@@ -147,17 +341,6 @@ namespace worldmachine {
 		return initial;
 	}
 	
-	std::size_t BuildSystem::calculateTotalTargetBuildCount(Network const* network,
-															std::span<utl::UUID const> leaves) const
-	{
-		auto const indices = network->indicesFromIDs(leaves);
-		std::size_t result = 0;
-		traverseUnique(network, indices, [&](std::size_t) {
-			++result;
-		});
-		return result;
-	}
-	
 	NodeDependencyMap BuildSystem::gatherDependencies(Network* network,
 													  std::size_t nodeIndex,
 													  BuildType buildType)
@@ -165,6 +348,7 @@ namespace worldmachine {
 		auto const edges = network->collectNodeEdges(nodeIndex);
 		
 		NodeDependencyMap dependencies;
+		dependencies.consumer = network->nodes[nodeIndex].implementation.get();
 		
 		[&](auto const&... ec){
 			return ([&](auto const& edgeCollection){
@@ -174,7 +358,8 @@ namespace worldmachine {
 						auto const inputNodeIndex = edge.beginNodeIndex;
 						WM_BoundsCheck(inputNodeIndex, 0, network->nodes.size());
 						auto const testFlag = buildType == BuildType::highResolution ? NodeFlags::built : NodeFlags::previewBuilt;
-						WM_Assert(!!(network->nodes[inputNodeIndex].flags & testFlag), "upstream node should have been build by now");
+						WM_Assert(!!(network->nodes[inputNodeIndex].flags & (testFlag | NodeFlags::building)),
+								  "upstream node should have been built or be building with pipelined rows by now");
 						auto desc = network->nodes[nodeIndex].pinDescriptorArray.get(edge.endPinKind)[edge.endPinIndex];
 						dependencies.inputs.insert(decltype(dependencies.inputs)::value_type{
 							std::pair{ edge.endPinIndex, edge.endPinKind },
@@ -196,22 +381,402 @@ namespace worldmachine {
 		return dependencies;
 	}
 	
-	void BuildSystem::nodeBuildFinished(Network* network, utl::UUID nodeID, bool success) {
+	/// Bit i is set if output i of the node feeds another node
+	static std::uint64_t connectedOutputs(Network const* network, std::size_t nodeIndex) {
+		std::uint64_t result = 0;
+		for (std::uint32_t const edgeIndex: network->nodes[nodeIndex].edgeIndices.outgoing) {
+			std::size_t const pinIndex = network->edges[edgeIndex].beginPinIndex;
+			if (pinIndex < 64) {
+				result |= std::uint64_t(1) << pinIndex;
+			}
+		}
+		return result;
+	}
+	
+	void BuildSystem::startNode(std::size_t planIndex) {
+		Network* const network = currentNetwork;
+		auto& state = plan->state(planIndex);
+		std::size_t const nodeIndex = plan->nodeIndex(planIndex);
+		
+		if (cancelled || state.stale) {
+			/// Never started, nothing to clean up.
+			retireNode();
+			return;
+		}
+		
+		if (currentTrace) {
+			currentTrace->nodes[planIndex].begin = BuildTrace::Clock::now();
+		}
+		
+		auto* const impl = network->nodes[nodeIndex].implementation.get();
+		WM_Assert(impl->currentBuildType() == this->currentBuildType());
+		WM_Assert(impl->currentBuildResolution() == this->currentBuildResolution());
+		
+		network->locked([&]{
+			network->nodes[nodeIndex].flags |= NodeFlags::building;
+		});
+		impl->_isBuilding = true;
+		
+		try {
+			auto dependencies = gatherDependencies(network, nodeIndex, currentBuildType());
+			if (impl->type() == NodeType::image) {
+				static_cast<ImageNodeImplementation*>(impl)->clearBuildDest(connectedOutputs(network, nodeIndex));
+			}
+			if (loadFromCache(planIndex)) {
+				LOG_SCHEDULER(debug, "Loaded '{}' from the node cache", network->nodes[nodeIndex].name);
+				if (currentTrace) {
+					currentTrace->nodes[planIndex].loadedFromCache = true;
+				}
+				nodeBuildFinished(planIndex, true);
+				return;
+			}
+			/// Only once we know the node runs, a cache hit keeps the upstream output.
+			if (impl->type() == NodeType::image) {
+				buildInPlace(planIndex, dependencies);
+			}
+			state.job = impl->makeBuildJob(std::move(dependencies));
+		}
+		catch (BuildError const& e) {
+			WM_Log(error, "Build Error: '{}'", e.what());
+			cancelled = true;
+			nodeBuildFinished(planIndex, false);
+			return;
+		}
+		
+		auto& buildJob = state.job;
+		std::size_t const height = currentBuildResolution().y;
+		state.rowBanded = currentRowPipelining && buildJob.rowBanded();
+		if (state.rowBanded) {
+			state.rowDone.assign(height, false);
+			/// Our buffers exist now, so pipelined successors can register their bands.
+			releaseSuccessors(planIndex, /* early = */ true);
+		}
+		
+		if (!buildJob.hasJobs()) {
+			nodeBuildFinished(planIndex, true);
+			return;
+		}
+		
+		dispatchPhase(planIndex);
+	}
+	
+	void BuildSystem::dispatchPhase(std::size_t planIndex) {
+		Network* const network = currentNetwork;
+		auto& state = plan->state(planIndex);
+		auto& buildJob = state.job;
+		std::size_t const nodeIndex = plan->nodeIndex(planIndex);
+		std::size_t const height = currentBuildResolution().y;
+		
+		auto const oneProgress = buildJob.oneProgress();
+		std::size_t const end = buildJob.phaseEnd();
+		bool const skipOutside = state.partial && buildJob.rowBanded();
+		/// Counted before the first dispatch, the next phase is started by whichever job finishes last.
+		/// That job may already consume the next phase while we are still here, so 'buildJob.index'
+		/// must not be read again once the last job of this phase is dispatched.
+		std::size_t const count = end - buildJob.index;
+		state.remainingJobs = count;
+		for (std::size_t i = 0; i < count; ++i) {
+			auto [oneJob, jobRows] = buildJob.consumeOne();
+			RowRange const rows = jobRows.value_or(RowRange{ 0, height });
+			/// Outside of the region, left blank until the rest is filled in. Still dispatched
+			/// so pipelined successors and the job count see the rows completed.
+			bool const skip = skipOutside && (rows.end <= state.neededRows.begin || rows.begin >= state.neededRows.end);
+			auto const queued = currentTrace ? BuildTrace::Clock::now() : BuildTrace::Clock::time_point{};
+			dispatchTile(planIndex, rows, [=, this, &state, &buildJob, oneJob = std::move(oneJob)] {
+				auto const begin = currentTrace ? BuildTrace::Clock::now() : BuildTrace::Clock::time_point{};
+				if (!cancelled && !state.stale && !skip) {
+					oneJob(CancellationToken(&cancelled, &state.stale));
+				}
+				if (currentTrace) {
+					/// Before the job count drops, the last job may end the build.
+					recordJob(planIndex, rows, queued, begin);
+				}
+				/// Also catches jobs that returned early because they polled the token.
+				if (!cancelled && !state.stale) {
+					state.progress.fetch_add(std::uint32_t(oneProgress * UINT_MAX), std::memory_order_relaxed);
+					_info._progress.fetch_add(std::uint32_t(oneProgress * UINT_MAX / totalTargetBuildCount), std::memory_order_relaxed);
+					maybePublishProgress();
+				}
+				else {
+					state.incomplete = true;
+				}
+				if (state.rowBanded) {
+					completeRows(planIndex, rows);
+				}
+				if (--state.remainingJobs != 0) {
+					return;
+				}
+				if (buildJob.hasJobs() && !state.incomplete && !cancelled && !state.stale) {
+					dispatchPhase(planIndex);
+				}
+				else {
+					nodeBuildFinished(planIndex, !state.incomplete && !buildJob.hasJobs());
+				}
+			});
+		}
+	}
+	
+	void BuildSystem::maybePublishProgress() {
+		auto const now = std::chrono::steady_clock::now().time_since_epoch().count();
+		auto last = lastProgressPublish.load(std::memory_order_relaxed);
+		auto const interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(progressPublishInterval).count();
+		if (now - last < interval) {
+			return;
+		}
+		/// Only one worker publishes per interval.
+		if (!lastProgressPublish.compare_exchange_strong(last, now, std::memory_order_relaxed)) {
+			return;
+		}
+		publishProgress();
+	}
+	
+	void BuildSystem::publishProgress() {
+		Network* const network = currentNetwork;
+		/// Don't wait for the UI, the next interval will catch up.
+		std::unique_lock lock(network->_mutex, std::try_to_lock);
+		if (!lock) {
+			return;
+		}
+		for (std::size_t planIndex = 0; planIndex < plan->size(); ++planIndex) {
+			std::size_t const nodeIndex = plan->nodeIndex(planIndex);
+			/// Building is cleared under this lock when the node finishes, so we never resurrect a finished bar.
+			if (!test(network->nodes[nodeIndex].flags & NodeFlags::building)) {
+				continue;
+			}
+			auto const progress = plan->state(planIndex).progress.load(std::memory_order_relaxed);
+			network->nodes[nodeIndex].buildProgress = (float)((double)progress / UINT_MAX);
+		}
+		network->_buildInfo._progress = _info._progress.load(std::memory_order_relaxed);
+		lock.unlock();
+		invalidateView();
+	}
+	
+	bool BuildSystem::loadFromCache(std::size_t planIndex) {
+		if (!outputCache || cacheKeys.empty()) {
+			return false;
+		}
+		auto* const impl = currentNetwork->nodes[plan->nodeIndex(planIndex)].implementation.get();
+		if (impl->type() != NodeType::image) {
+			return false;
+		}
+		auto const outputs = static_cast<ImageNodeImplementation*>(impl)->buildDests();
+		if (outputs.empty() || !outputCache->load(cacheKeys[planIndex], outputs)) {
+			return false;
+		}
+		plan->state(planIndex).loadedFromCache = true;
+		return true;
+	}
+	
+	void BuildSystem::storeToCache(std::size_t planIndex) {
+		if (!outputCache || cacheKeys.empty() || plan->state(planIndex).loadedFromCache) {
+			return;
+		}
+		auto* const impl = currentNetwork->nodes[plan->nodeIndex(planIndex)].implementation.get();
+		if (impl->type() != NodeType::image) {
+			return;
+		}
+		auto const outputs = static_cast<ImageNodeImplementation*>(impl)->buildDests();
+		if (!outputs.empty()) {
+			outputCache->store(cacheKeys[planIndex], outputs);
+		}
+	}
+	
+	bool BuildSystem::isPipelined(std::size_t planIndex, std::size_t successor) const {
+		/// Compact outputs are converted as a whole when the successor starts.
+		auto const& outputs = currentNetwork->nodes[plan->nodeIndex(planIndex)].pinDescriptorArray.output;
+		bool const compactOutputs = std::any_of(outputs.begin(), outputs.end(), [](auto const& pin) {
+			return isCompactDataType(pin.dataType());
+		});
+		return plan->state(planIndex).rowBanded && !compactOutputs &&
+			currentNetwork->nodes[plan->nodeIndex(successor)].implementation->rowFootprint().has_value();
+	}
+	
+	void BuildSystem::releaseSuccessors(std::size_t planIndex, bool early) {
+		/// Ready successors go onto this worker's own queue so their inputs are still warm in cache.
+		for (std::uint32_t const successor: plan->successors(planIndex)) {
+			if (isPipelined(planIndex, successor) != early) {
+				continue;
+			}
+			if (plan->releasePredecessor(successor)) {
+				++activeNodes;
+				scheduler.push([this, successor]{ startNode(successor); }, taskPriority(successor));
+			}
+		}
+	}
+	
+	BuildScheduler::Priority BuildSystem::taskPriority(std::size_t planIndex) const {
+		return plan->state(planIndex).priority ? BuildScheduler::Priority::high : BuildScheduler::Priority::normal;
+	}
+	
+	static RowRange rowHull(RowRange a, RowRange b) {
+		if (a.begin == a.end) {
+			return b;
+		}
+		if (b.begin == b.end) {
+			return a;
+		}
+		return { std::min(a.begin, b.begin), std::max(a.end, b.end) };
+	}
+	
+	void BuildSystem::planRegion(std::optional<BuildRegion> region, std::span<std::size_t const> targetIndices) {
+		std::size_t const height = currentBuildResolution().y;
+		RowRange const allRows{ 0, height };
+		if (!region) {
+			for (std::size_t planIndex = 0; planIndex < plan->size(); ++planIndex) {
+				plan->state(planIndex).neededRows = allRows;
+			}
+			return;
+		}
+		/// Jobs are row bands, so only the vertical extent of the region saves work.
+		std::size_t const regionBegin = std::min((std::size_t)std::floor(std::clamp(region->begin.y, 0.0f, 1.0f) * height), height - 1);
+		std::size_t const regionEnd = std::max((std::size_t)std::ceil(std::clamp(region->end.y, 0.0f, 1.0f) * height), regionBegin + 1);
+		auto const planIndices = plan->nodeIndices();
+		for (std::size_t const nodeIndex: targetIndices) {
+			auto const itr = std::find(planIndices.begin(), planIndices.end(), nodeIndex);
+			if (itr != planIndices.end()) {
+				auto& rows = plan->state(itr - planIndices.begin()).neededRows;
+				rows = rowHull(rows, { regionBegin, regionEnd });
+			}
+		}
+		/// Successors first, each one widens what its inputs need by its halo.
+		for (std::size_t planIndex = plan->size(); planIndex-- > 0;) {
+			RowRange const needed = plan->state(planIndex).neededRows;
+			if (needed.begin == needed.end) {
+				continue;
+			}
+			auto const halo = currentNetwork->nodes[plan->nodeIndex(planIndex)].implementation->rowFootprint();
+			RowRange const read = halo ?
+				RowRange{ needed.begin - std::min(needed.begin, *halo), std::min(needed.end + *halo, height) } :
+				allRows;
+			for (std::uint32_t const predecessor: plan->predecessors(planIndex)) {
+				auto& rows = plan->state(predecessor).neededRows;
+				rows = rowHull(rows, read);
+			}
+		}
+		/// Predecessors first. Nodes that compute all rows from partial inputs are partial as well.
+		std::size_t partialCount = 0;
+		for (std::size_t planIndex = 0; planIndex < plan->size(); ++planIndex) {
+			auto& state = plan->state(planIndex);
+			auto const predecessors = plan->predecessors(planIndex);
+			state.partial = state.neededRows.begin != 0 || state.neededRows.end != height ||
+				std::any_of(predecessors.begin(), predecessors.end(), [&](std::uint32_t predecessor) {
+					return plan->state(predecessor).partial;
+				});
+			partialCount += state.partial;
+		}
+		LOG_SCHEDULER(debug, "Building rows [{}, {}) of the focused node, {} of {} nodes partially",
+					  regionBegin, regionEnd, partialCount, plan->size());
+	}
+	
+	static bool rowsDone(BuildPlan::NodeState const& state, RowRange rows) {
+		return std::all_of(state.rowDone.begin() + rows.begin,
+						   state.rowDone.begin() + rows.end,
+						   [](bool done) { return done; });
+	}
+	
+	void BuildSystem::dispatchTile(std::size_t planIndex, RowRange rows, utl::function<void()> task) {
+		auto const halo = currentNetwork->nodes[plan->nodeIndex(planIndex)].implementation->rowFootprint();
+		if (!halo) {
+			/// All our predecessors released us when they finished.
+			scheduler.push(std::move(task), taskPriority(planIndex));
+			return;
+		}
+		std::size_t const height = currentBuildResolution().y;
+		auto tile = std::make_shared<BuildPlan::PendingTile>();
+		tile->footprint = {
+			rows.begin - std::min(rows.begin, *halo),
+			std::min(rows.end + *halo, height)
+		};
+		tile->task = std::move(task);
+		tile->priority = plan->state(planIndex).priority;
+		for (std::uint32_t const predecessor: plan->predecessors(planIndex)) {
+			auto& source = plan->state(predecessor);
+			if (!source.rowBanded) {
+				continue;
+			}
+			std::lock_guard lock(source.rowMutex);
+			if (!rowsDone(source, tile->footprint)) {
+				++tile->missingSources;
+				source.waitingTiles.push_back(tile);
+			}
+		}
+		/// Drop the guard count we started with
+		if (--tile->missingSources == 0) {
+			scheduler.push(std::move(tile->task), taskPriority(planIndex));
+		}
+	}
+	
+	void BuildSystem::completeRows(std::size_t planIndex, RowRange rows) {
+		auto& state = plan->state(planIndex);
+		utl::small_vector<std::shared_ptr<BuildPlan::PendingTile>> ready;
+		{
+			std::lock_guard lock(state.rowMutex);
+			std::fill(state.rowDone.begin() + rows.begin, state.rowDone.begin() + rows.end, true);
+			for (auto i = state.waitingTiles.begin(); i != state.waitingTiles.end();) {
+				auto& tile = *i;
+				if (!rowsDone(state, tile->footprint)) {
+					++i;
+					continue;
+				}
+				if (--tile->missingSources == 0) {
+					ready.push_back(tile);
+				}
+				i = state.waitingTiles.erase(i);
+			}
+		}
+		for (auto& tile: ready) {
+			scheduler.push(std::move(tile->task), tile->priority ? BuildScheduler::Priority::high : BuildScheduler::Priority::normal);
+		}
+	}
+	
+	void BuildSystem::nodeBuildFinished(std::size_t planIndex, bool success) {
+		Network* const network = currentNetwork;
+		auto& buildJob = plan->state(planIndex).job;
+		std::size_t const nodeIndex = plan->nodeIndex(planIndex);
+		
+		if (currentTrace) {
+			currentTrace->nodes[planIndex].end = BuildTrace::Clock::now();
+		}
+		if (success && buildJob.completionHandler) {
+			buildJob.completionHandler();
+		}
+		if (!success && buildJob.failureHandler) {
+			buildJob.failureHandler();
+		}
+		if (buildJob.cleanupHandler) {
+			buildJob.cleanupHandler();
+		}
+		network->nodes[nodeIndex].implementation->_decodedInputs.clear();
+		/// A complete result from the cache is not partial, even if we only needed a region.
+		bool const partial = plan->state(planIndex).partial && !plan->state(planIndex).loadedFromCache;
+		if (success && !partial) {
+			/// After the handlers, they may still write to the outputs.
+			storeToCache(planIndex);
+		}
+		
 		network->locked([&]{
-			auto const nodeIndex = network->indexFromID(nodeID);
+			if (plan->state(planIndex).stale) {
+				success = false;
+			}
 			network->nodes[nodeIndex].buildProgress = 0;
 			auto* const impl = network->nodes[nodeIndex].implementation.get();
 			impl->_isBuilding = false;
-			if (currentBuildType() == BuildType::preview)
+			if (currentBuildType() == BuildType::preview) {
 				impl->_previewBuilt = success;
-			if (currentBuildType() == BuildType::highResolution)
+				impl->_previewPartial = partial;
+			}
+			if (currentBuildType() == BuildType::highResolution) {
 				impl->_built = success;
+				impl->_partial = partial;
+			}
 			if (success) {
 				if (currentBuildType() == BuildType::highResolution) {
 					network->nodes[nodeIndex].flags |= NodeFlags::built;
+					impl->_highresBuiltResolution = currentBuildResolution();
 				}
 				else {
 					network->nodes[nodeIndex].flags |= NodeFlags::previewBuilt;
+					impl->_previewBuiltResolution = currentBuildResolution();
 				}
 			}
 			network->nodes[nodeIndex].flags &= ~NodeFlags::building;
@@ -222,177 +787,152 @@ namespace worldmachine {
 				WM_Log(warning, "Cancelled build of '{}' [index = {}]", network->nodes[nodeIndex].name, nodeIndex);
 			}
 		});
+		network->_buildInfo._progress = _info._progress.load(std::memory_order_relaxed);
+		invalidateView();
 		
-		
-		
-		std::unique_lock lock(coordMutex);
-		[[maybe_unused]] auto const eraseResult = buildingNodes.erase(nodeID);
-		WM_Assert(eraseResult == 1, "This node must have been in 'buildingNodes'");
-		[[maybe_unused]] auto const insertResult = builtNodes.insert(nodeID).second;
-		WM_Assert(insertResult, "This node mustn't have been in 'builtNodes'");
-		++nodeBuildsCompleted;
-		signal = Signal::start;
-		coordCV.notify_one();
+		if (plan->state(planIndex).rowBanded) {
+			/// Also wakes up bands of pipelined successors if we failed, they will see the cancellation.
+			completeRows(planIndex, { 0, currentBuildResolution().y });
+		}
+		if (success) {
+			++nodeBuildsCompleted;
+			releaseInputs(planIndex);
+			releaseSuccessors(planIndex, /* early = */ false);
+		}
+		retireNode();
 	}
 	
-	void BuildSystem::buildCoordinator(Network* network,
-									   utl::vector<utl::UUID> nodes)
-	{
-		std::unique_lock lock(coordMutex);
-		while (true) {
-			switch (signal) {
-				case Signal::sleep:
-					LOG_COORD(info, "coordinator wakeup: case Signal::sleep:");
-					coordSleep(lock);
-					break;
-					
-				case Signal::start: {
-					LOG_COORD(info, "coordinator wakeup: case Signal::start:");
-					coordStart(network, nodes);
-					break;
-				}
-					
-				case Signal::finished:
-					LOG_COORD(info, "coordinator wakeup: case Signal::finished:");
-					mainCV.notify_one();
-					return;
-					
-				case Signal::cancelBuild:
-					LOG_COORD(info, "coordinator wakeup: case Signal::cancelBuild");
-					coordCancel(network, lock);
-					return;
-					
-				case Signal::none:
-					WM_DebugBreak("Signal must never be none");
-					break;
+	void BuildSystem::releaseInputs(std::size_t planIndex) {
+		for (std::uint32_t const predecessor: plan->predecessors(planIndex)) {
+			auto& source = plan->state(predecessor);
+			if (--source.pendingConsumers == 0 && source.evictable) {
+				evict(predecessor);
+			}
+		}
+		if (currentBuildType() == BuildType::highResolution && ImagePool::instance().overBudget()) {
+			/// Views show the high resolution image from now on.
+			std::size_t const nodeIndex = plan->nodeIndex(planIndex);
+			auto* const impl = currentNetwork->nodes[nodeIndex].implementation.get();
+			if (impl->type() == NodeType::image) {
+				currentNetwork->locked([&]{
+					currentNetwork->nodes[nodeIndex].flags &= ~NodeFlags::previewBuilt;
+					impl->_previewBuilt = false;
+				});
+				static_cast<ImageNodeImplementation*>(impl)->releaseOutputs(BuildType::preview);
 			}
 		}
-		LOG_COORD(warning, "Finished build");
 	}
 	
-	void BuildSystem::coordSleep(std::unique_lock<std::mutex>& lock) {
-		coordCV.wait(lock, [this]{ return signal != Signal::sleep; });
+	void BuildSystem::evict(std::size_t planIndex) {
+		if (!ImagePool::instance().overBudget()) {
+			return;
+		}
+		Network* const network = currentNetwork;
+		std::size_t const nodeIndex = plan->nodeIndex(planIndex);
+		auto* const impl = network->nodes[nodeIndex].implementation.get();
+		if (impl->type() != NodeType::image) {
+			return;
+		}
+		/// Unset the flags first so nobody starts reading what we are about to release.
+		/// The next build brings the node back, from the output cache if enabled.
+		auto const builtFlag = currentBuildType() == BuildType::highResolution ? NodeFlags::built : NodeFlags::previewBuilt;
+		network->locked([&]{
+			network->nodes[nodeIndex].flags &= ~builtFlag;
+			if (currentBuildType() == BuildType::highResolution)
+				impl->_built = false;
+			else
+				impl->_previewBuilt = false;
+		});
+		static_cast<ImageNodeImplementation*>(impl)->releaseOutputs(currentBuildType());
+		LOG_SCHEDULER(debug, "Released outputs of '{}' to stay within the memory budget", network->nodes[nodeIndex].name);
 	}
 	
-	void BuildSystem::coordStart(Network* network, std::span<utl::UUID const> nodes) {
-		if (totalTargetBuildCount == nodeBuildsCompleted) {
-			// we are done!
-			WM_Assert(buildingNodes.empty());
-			cleanup(network);
-			signal = Signal::finished;
+	void BuildSystem::buildInPlace(std::size_t planIndex, NodeDependencyMap& dependencies) {
+		Network* const network = currentNetwork;
+		std::size_t const nodeIndex = plan->nodeIndex(planIndex);
+		auto* const impl = static_cast<ImageNodeImplementation*>(network->nodes[nodeIndex].implementation.get());
+		auto const input = impl->inPlaceInput();
+		/// Previews are kept, every node view shows them.
+		if (!input || currentBuildType() != BuildType::highResolution || plan->state(planIndex).partial) {
 			return;
 		}
-		
-		auto const unbuildRoots = gatherUnbuiltRoots(network, nodes);
-		if (unbuildRoots.empty()) {
-			LOG_COORD(debug, "No unbuilt roots, going back to sleep");
-			signal = Signal::sleep;
+		/// Costs the upstream output, which then has to be loaded or rebuilt for the next edit downstream.
+		if (!ImagePool::instance().overBudget()) {
 			return;
 		}
-		
-		buildingNodes.insert(unbuildRoots.begin(), unbuildRoots.end());
-		
-		LOG_COORD(debug, "Unbuild roots are:");
-		for ([[maybe_unused]] auto id: unbuildRoots) {
-			LOG_COORD("    {} [index = {}, id = {}]", network->nodes[network->indexFromID(id)].name,
-					  network->indexFromID(id), id);
+		auto const itr = dependencies.inputs.find({ *input, PinKind::input });
+		if (itr == dependencies.inputs.end() || itr->second.node->type() != NodeType::image) {
+			return;
 		}
-		
-		// gather all the current build jobs
-		utl::hashmap<utl::UUID, BuildJob> currentBuildJobs;
-		try {
-			for (auto id: unbuildRoots) {
-				std::size_t const nodeIndex = network->indexFromID(id);
-				auto* impl = network->nodes[nodeIndex].implementation.get();
-				WM_Assert(impl->currentBuildType() == this->currentBuildType());
-				WM_Assert(impl->currentBuildResolution() == this->currentBuildResolution());
-				
-				if (impl->type() == NodeType::image) {
-					static_cast<ImageNodeImplementation*>(impl)->clearBuildDest();
-				}
-				[[maybe_unused]] bool const insertResult = currentBuildJobs.insert({
-					id, impl->makeBuildJob(gatherDependencies(network, nodeIndex, currentBuildType()))
-				}).second;
-				WM_Assert(insertResult, "Node was build already");
-			}
+		auto* const sourceImpl = static_cast<ImageNodeImplementation*>(itr->second.node);
+		/// Not found if built by an earlier build, its outputs may be needed again.
+		auto const predecessors = plan->predecessors(planIndex);
+		auto const source = std::find_if(predecessors.begin(), predecessors.end(), [&](std::uint32_t p) {
+			return network->nodes[plan->nodeIndex(p)].implementation.get() == sourceImpl;
+		});
+		if (source == predecessors.end()) {
+			return;
 		}
-		catch (BuildError const& e) {
-			WM_Log(error, "Build Error: '{}'", e.what());
-			signal = Signal::cancelBuild;
+		auto const& sourceState = plan->state(*source);
+		if (!sourceState.evictable || sourceState.requested || sourceState.partial ||
+			plan->successors(*source).size() != 1 || isPipelined(*source, planIndex))
+		{
 			return;
 		}
-		
-		// dispatch all current build jobs
-		for (auto& [nodeID, buildJob]: currentBuildJobs) {
-			utl::dispatch_group g;
-			std::size_t const nodeIndex = network->indexFromID(nodeID);
-			network->locked([&]{
-				network->nodes[nodeIndex].flags |= NodeFlags::building;
-			});
-			
-			
-			auto const oneProgress = buildJob.oneProgress();
-			while (buildJob.hasJobs()) {
-				auto oneJob = buildJob.consumeOne();
-				auto jobWrapper = [=, oneJob = std::move(oneJob)] {
-					oneJob();
-					network->locked([&]{
-						network->nodes[nodeIndex].buildProgress += oneProgress;
-					});
-					_info._progress += std::uint32_t(oneProgress * UINT_MAX / totalTargetBuildCount);
-					network->_buildInfo._progress += std::uint32_t(oneProgress * UINT_MAX / totalTargetBuildCount);
-					invalidateView();
-				};
-				g.add(std::move(jobWrapper));
-			}
-			g.on_completion([this, network, nodeID = nodeID,
-							 nodeCompletionHandler = std::move(buildJob.completionHandler),
-							 nodeCleanupHandler = buildJob.cleanupHandler]{
-				if (nodeCompletionHandler)
-					nodeCompletionHandler();
-				if (nodeCleanupHandler)
-					nodeCleanupHandler();
-				nodeBuildFinished(network, nodeID, true);
-			});
-			g.on_failure([this, network, nodeID = nodeID, nodeCleanupHandler = buildJob.cleanupHandler]{
-				if (nodeCleanupHandler)
-					nodeCleanupHandler();
-				nodeBuildFinished(network, nodeID, false);
-			});
-			network->nodes[nodeIndex].implementation->_isBuilding = true;
-			dispatchQueue.async(std::move(g));
+		Image& sourceImage = sourceImpl->buildDests()[itr->second.outputIndex];
+		auto const& outputs = network->nodes[nodeIndex].pinDescriptorArray.output;
+		if (outputs.empty() || outputs[0].dataType() != sourceImage.dataType() ||
+			isCompactDataType(sourceImage.dataType()) || sourceImage.size() != currentBuildResolution())
+		{
+			return;
 		}
-		signal = Signal::sleep;
+		/// Unset the flags first so nobody starts reading what we are about to take.
+		std::size_t const sourceIndex = plan->nodeIndex(*source);
+		network->locked([&]{
+			network->nodes[sourceIndex].flags &= ~NodeFlags::built;
+			sourceImpl->_built = false;
+		});
+		impl->adoptBuildDest(sourceImage);
+		/// The input is read from where it lives now.
+		itr->second = { impl, 0 };
+		LOG_SCHEDULER(debug, "Building '{}' in the output buffer of '{}'",
+					  network->nodes[nodeIndex].name, network->nodes[sourceIndex].name);
 	}
 	
-	void BuildSystem::coordCancel(Network* network, std::unique_lock<std::mutex>& lock) {
-		lock.unlock();
-		dispatchQueue.cancel_current_tasks();
-		lock.lock();
-		LOG_COORD(debug, "locking network");
-		network->locked([&]{
-			for (auto id: buildingNodes) {
-				network->nodes[network->indexFromID(id)].buildProgress = 0;
+	void BuildSystem::retireNode() {
+		/// Successors are counted before we get here, so reaching zero means no more work can appear.
+		if (--activeNodes == 0) {
+			finishBuild();
+		}
+	}
+	
+	void BuildSystem::finishBuild() {
+		std::shared_ptr<BuildTrace const> trace;
+		{
+			std::lock_guard lock(buildMutex);
+			if (cancelled) {
+				pendingLevels.clear();
 			}
-		});
-		LOG_COORD(debug, "cleanup");
-		cleanup(network);
-		LOG_COORD(debug, "done");
-		mainCV.notify_one();
+			trace = cleanup(currentNetwork);
+		}
+		buildFinishedCV.notify_all();
+		if (trace) {
+			writeTrace(*trace);
+		}
 	}
 	
-	void BuildSystem::build(BuildType type,
-							Network* network,
-							utl::vector<utl::UUID> nodes)
-	{
+	void BuildSystem::build(BuildLevel level) {
+		BuildType const type = level.type;
+		Network* const network = level.network;
+		auto nodes = std::move(level.nodes);
 		WM_Expect(type != BuildType::none);
 		if (isBuilding()) {
 			WM_Log(error, "We are already building, ignoring this request");
 			return;
 		}
 		
-		WM_Assert(builtNodes.empty());
-		WM_Assert(buildingNodes.empty());
+		/// Workers may still be returning from the last task of the previous build.
+		scheduler.waitIdle();
 		
 		if (nodes.empty()) {
 			nodes = network->IDsFromIndices(network->gatherLeafNodes());
@@ -401,12 +941,27 @@ namespace worldmachine {
 		_info._type = type;
 		_info._progress = 0;
 		network->_buildInfo = _info;
-		signal = Signal::start;
-		builtNodes.clear();
-		if (coordThread.joinable()) {
-			coordThread.join();
-		}
+		currentNetwork = network;
+		currentPreviewResolution = level.previewResolution;
+		cancelled = false;
+		currentRowPipelining = rowPipelining;
+		nodeBuildsCompleted = 0;
 		stopwatch.reset();
+		currentTrace = nullptr;
+		if (tracing) {
+			currentTrace = std::make_unique<BuildTrace>();
+			currentTrace->begin = BuildTrace::Clock::now();
+			currentTrace->type = type;
+			currentTrace->resolution = currentBuildResolution();
+			currentTrace->workerCount = scheduler.numThreads();
+			workerJobs.resize(scheduler.numThreads());
+			for (auto& jobs: workerJobs) {
+				jobs.clear();
+			}
+			buildThreadJobs.clear();
+		}
+		/// Before inner nodes are pruned, those are looked at as well.
+		auto const requestedIndices = network->indicesFromIDs(nodes);
 		nodes = performSanityChecks(network, std::move(nodes));
 		if (nodes.empty()) {
 			WM_Log(warning, "'nodes' was empty. Not building anything");
@@ -414,66 +969,221 @@ namespace worldmachine {
 			return;
 		}
 		
-		totalTargetBuildCount = calculateTotalTargetBuildCount(network, nodes);
-		traverseUnique(network, network->indicesFromIDs(nodes),
-					   [this, network](std::size_t nodeIndex){
-			auto flags = network->nodes[nodeIndex].flags;
-			WM_Assert(!(flags & NodeFlags::building), "This node should not be building right now");
-			auto const isBuiltFlag = _info.type() == BuildType::highResolution ? NodeFlags::built : NodeFlags::previewBuilt;
-			if (test(flags & isBuiltFlag)) {
-				builtNodes.insert(network->IDFromIndex(nodeIndex));
-				++nodeBuildsCompleted;
-				_info._progress += UINT_MAX / totalTargetBuildCount;
+		if (level.coarse) {
+			std::size_t const area = level.previewResolution.fold(utl::multiplies);
+			bool const havePreviews = network->locked([&]{
+				return std::all_of(nodes.begin(), nodes.end(), [&](utl::UUID id) {
+					std::size_t const nodeIndex = network->indexFromID(id);
+					auto const* impl = network->nodes[nodeIndex].implementation.get();
+					return test(network->nodes[nodeIndex].flags & NodeFlags::previewBuilt) &&
+						impl->_previewBuiltResolution.fold(utl::multiplies) >= area;
+				});
+			});
+			if (havePreviews) {
+				LOG_SCHEDULER(debug, "Skipping the {}x{} level, all targets have a preview at least as fine",
+							  level.previewResolution.x, level.previewResolution.y);
+				cleanup(network);
+				return;
 			}
+		}
+		
+		auto const isBuiltFlag = type == BuildType::highResolution ? NodeFlags::built : NodeFlags::previewBuilt;
+		mtl::usize2 const buildResolution = currentBuildResolution();
+		auto const targetIndices = network->indicesFromIDs(nodes);
+		plan = std::make_unique<BuildPlan>(network, targetIndices, [&](std::size_t nodeIndex) {
+			/// Outputs of another resolution, e.g. of a coarser level, or of a region only count as unbuilt.
+			auto const* impl = network->nodes[nodeIndex].implementation.get();
+			bool const highRes = type == BuildType::highResolution;
+			auto const builtResolution = highRes ? impl->_highresBuiltResolution : impl->_previewBuiltResolution;
+			bool const partial = highRes ? impl->_partial : impl->_previewPartial;
+			return test(network->nodes[nodeIndex].flags & isBuiltFlag) && builtResolution == buildResolution && !partial;
+		});
+		/// Clear the flags of nodes built at another resolution, their outputs are about to be reallocated.
+		network->locked([&]{
+			for (std::size_t const nodeIndex: plan->nodeIndices()) {
+				network->nodes[nodeIndex].flags &= ~isBuiltFlag;
+				auto* const impl = network->nodes[nodeIndex].implementation.get();
+				(type == BuildType::highResolution ? impl->_built : impl->_previewBuilt) = false;
+			}
+		});
+		planRegion(level.region, targetIndices);
+		long focusIndex = -1;
+		if (auto const focus = locked([&]{ return std::pair(focusNetwork, focusNodeID); }); focus.first == network) {
+			focusIndex = network->indexFromID(focus.second);
+			if (focusIndex >= 0) {
+				plan->prioritize((std::size_t)focusIndex);
+			}
+		}
+		
+		auto prepareNode = [this, network](std::size_t nodeIndex) {
+			WM_Assert(!(network->nodes[nodeIndex].flags & NodeFlags::building), "This node should not be building right now");
 			auto* const impl = network->nodes[nodeIndex].implementation.get();
-			
 			impl->_currentBuildType = this->currentBuildType();
-			impl->_previewBuildResolution = this->previewResolution;
+			impl->_previewBuildResolution = this->currentPreviewResolution;
 			impl->_highresBuildResolution = this->resolution;
-		});
-		LOG_COORD(debug, "Sanity checks completed. Now Building {} Nodes. Leaf nodes are:", totalTargetBuildCount);
+		};
+		for (std::size_t const nodeIndex: plan->nodeIndices()) {
+			prepareNode(nodeIndex);
+		}
+		for (std::size_t const nodeIndex: plan->builtDependencies()) {
+			prepareNode(nodeIndex);
+		}
+		
+		/// Consumers outside of this plan may still need a node's outputs later.
+		utl::vector<std::uint32_t> outDegree(network->nodeCount(), 0);
+		for (auto beginNodeIndex: network->edges.view<Edge::members::beginNodeIndex>()) {
+			++outDegree[beginNodeIndex];
+		}
+		for (std::size_t planIndex = 0; planIndex < plan->size(); ++planIndex) {
+			auto& state = plan->state(planIndex);
+			auto const consumers = plan->successors(planIndex).size();
+			state.pendingConsumers = (std::uint32_t)consumers;
+			state.evictable = consumers > 0 && outDegree[plan->nodeIndex(planIndex)] == consumers;
+			std::size_t const nodeIndex = plan->nodeIndex(planIndex);
+			state.requested = (long)nodeIndex == focusIndex ||
+				std::find(requestedIndices.begin(), requestedIndices.end(), nodeIndex) != requestedIndices.end();
+		}
+		
+		cacheKeys.clear();
+		/// Previews are rebuilt on every edit and cheap to redo, storing them would only put disk
+		/// writes in the way of the next preview.
+		if (outputCache && type == BuildType::highResolution) {
+			/// Parameters may only be read on this thread, so all keys are computed up front.
+			utl::hashmap<std::size_t, NodeOutputCache::Key> keys;
+			cacheKeys.reserve(plan->size());
+			for (std::size_t const nodeIndex: plan->nodeIndices()) {
+				makeCacheKey(network, nodeIndex, type, resolution, currentPreviewResolution, keys);
+				cacheKeys.push_back(keys.find(nodeIndex)->second);
+			}
+		}
+		
+		totalTargetBuildCount = plan->size();
+		if (plan->empty()) {
+			LOG_SCHEDULER(debug, "All requested nodes are built already");
+			cleanup(network);
+			return;
+		}
+		
+		LOG_SCHEDULER(debug, "Sanity checks completed. Now Building {} Nodes. Leaf nodes are:", totalTargetBuildCount);
 		for ([[maybe_unused]] auto id: nodes) {
-			LOG_COORD("    {}", network->nodes[network->indexFromID(id)].name);
+			LOG_SCHEDULER(debug, "    {}", network->nodes[network->indexFromID(id)].name);
 		}
-		LOG_COORD(debug, "Starting coordinator");
-		coordThread = std::thread([=, nodes = std::move(nodes)]{
-			buildCoordinator(network, std::move(nodes));
+		
+		if (currentTrace) {
+			for (std::size_t const nodeIndex: plan->nodeIndices()) {
+				currentTrace->nodes.push_back({ .id = network->nodes[nodeIndex].id, .name = network->nodes[nodeIndex].name });
+			}
+			currentTrace->planned = BuildTrace::Clock::now();
+		}
+		
+		/// Count all roots before dispatching the first one, otherwise a
+		/// quick root could bring the count to zero and end the build early.
+		activeNodes = plan->roots().size();
+		for (std::uint32_t const root: plan->roots()) {
+			scheduler.push([this, root]{ startNode(root); }, taskPriority(root));
+		}
+	}
+	
+	void BuildSystem::waitForBuild() {
+		std::unique_lock lock(buildMutex);
+		buildFinishedCV.wait(lock, [&]{
+			return !isBuilding() && pendingRequests.empty() && pendingLevels.empty() && !startingBuild;
 		});
 	}
 	
 	void BuildSystem::cancelCurrentBuild() {
-		std::unique_lock lock(coordMutex);
-		signal = Signal::cancelBuild;
-		coordCV.notify_one();
-		
-		mainCV.wait(lock, [&]{
+		std::unique_lock lock(buildMutex);
+		pendingRequests.clear();
+		pendingLevels.clear();
+		buildFinishedCV.wait(lock, [&]{ return !startingBuild; });
+		if (!isBuilding()) {
+			return;
+		}
+		cancelled = true;
+		buildFinishedCV.wait(lock, [&]{
 			return !isBuilding();
 		});
-		
-		dispatchQueue.wait_for_current_tasks();
 	}
 	
 	
-	void BuildSystem::cleanup(Network* network) {
-		builtNodes.clear();
-		buildingNodes.clear();
+	std::shared_ptr<BuildTrace const> BuildSystem::cleanup(Network* network) {
 		_info = {};
 		network->_buildInfo = {};
 		totalTargetBuildCount = 0;
-		nodeBuildsCompleted = 0;
-		if (signal == Signal::finished || signal == Signal::start) {
+		std::shared_ptr<BuildTrace const> trace;
+		if (currentTrace) {
+			trace = finishTrace();
+		}
+		if (!cancelled) {
 			WM_Log(info, "Build finished in {}s",
 				   double(stopwatch.elapsed_time()) / 1'000'000'000);
 		}
-		else if (signal == Signal::cancelBuild) {
+		else {
 			WM_Log(warning, "Build cancelled. {}s elapsed",
 				   double(stopwatch.elapsed_time()) / 1'000'000'000);
 		}
-		else {
-			WM_DebugBreak("Invalid signal");
+		return trace;
+	}
+	
+	void BuildSystem::recordJob(std::size_t planIndex, RowRange rows,
+								BuildTrace::Clock::time_point queued, BuildTrace::Clock::time_point begin)
+	{
+		long const worker = scheduler.currentWorkerIndex();
+		BuildTrace::Job const job = {
+			.node = (std::uint32_t)planIndex,
+			.worker = worker >= 0 ? (std::uint32_t)worker : BuildTrace::Job::buildThread,
+			.rows = rows,
+			.queued = queued,
+			.begin = begin,
+			.end = BuildTrace::Clock::now()
+		};
+		if (worker < 0) {
+			/// Rare, but may come from more than one thread.
+			std::lock_guard lock(buildThreadJobsMutex);
+			buildThreadJobs.push_back(job);
+			return;
 		}
+		workerJobs[(std::size_t)worker].push_back(job);
+	}
+	
+	std::shared_ptr<BuildTrace const> BuildSystem::finishTrace() {
+		std::shared_ptr<BuildTrace> trace = std::move(currentTrace);
+		if (trace->nodes.empty()) {
+			/// Nothing was built
+			return nullptr;
+		}
+		trace->end = BuildTrace::Clock::now();
+		trace->cancelled = cancelled;
+		for (auto& jobs: workerJobs) {
+			trace->jobs.insert(trace->jobs.end(), jobs.begin(), jobs.end());
+			jobs.clear();
+		}
+		{
+			std::lock_guard lock(buildThreadJobsMutex);
+			trace->jobs.insert(trace->jobs.end(), buildThreadJobs.begin(), buildThreadJobs.end());
+			buildThreadJobs.clear();
+		}
+		trace->summarize();
 		
+		std::lock_guard lock(traceMutex);
+		_lastTrace = trace;
+		return traceDirectory ? trace : nullptr;
 	}
 	
+	void BuildSystem::writeTrace(BuildTrace const& trace) {
+		std::filesystem::path path;
+		{
+			std::lock_guard lock(traceMutex);
+			if (!traceDirectory) {
+				return;
+			}
+			path = *traceDirectory / utl::format("build-{}.trace.json", ++traceCount);
+		}
+		std::error_code ec;
+		std::filesystem::create_directories(path.parent_path(), ec);
+		if (trace.writeChromeTrace(path)) {
+			WM_Log(info, "Wrote build trace to \"{}\"", path.string());
+		}
+	}
 	
 }
@@ -2,18 +2,25 @@
 
 #include "Core/Debug.hpp"
 #include "BuildSystemFwd.hpp"
+#include "BuildScheduler.hpp"
+#include "BuildPlan.hpp"
+#include "BuildTrace.hpp"
+#include "NodeOutputCache.hpp"
 
 #include <thread>
+#include <chrono>
 #include <mutex>
 #include <atomic>
 #include <condition_variable>
 #include <span>
+#include <memory>
+#include <optional>
+#include <filesystem>
 #include <utl/functional.hpp>
 #include <utl/vector.hpp>
 #include <utl/hashset.hpp>
 #include <utl/hashmap.hpp>
 #include <utl/UUID.hpp>
-#include <utl/dispatch_queue.hpp>
 #include <mtl/mtl.hpp>
 #include <utl/stopwatch.hpp>
 #include <utl/messenger.hpp>
@@ -25,10 +32,6 @@ namespace worldmachine {
 	class NodeDependencyMap;
 	
 	class BuildSystem {
-		enum struct Signal {
-			none = 0, sleep, start, finished, cancelBuild
-		};
-		
 		BuildSystem(); // private
 		
 	public:
@@ -39,13 +42,16 @@ namespace worldmachine {
 		bool isBuilding() const { return _info.isBuilding(); }
 		BuildType currentBuildType() const { return _info.type(); }
 		
+		/// Blocks until the current build and all queued requests have finished or were cancelled.
+		void waitForBuild();
+		
 		
 		void setViewInvalidator(utl::function<void()> f) {
 			_invalidateView = f;
 		}
 		
 		auto locked(utl::invocable auto&& f) {
-			std::unique_lock lock(coordMutex);
+			std::unique_lock lock(buildMutex);
 			return f();
 		}
 		
@@ -55,42 +61,121 @@ namespace worldmachine {
 		void setPreviewResolution(mtl::usize2 resolution) { WM_Assert(!isBuilding()); this->previewResolution = resolution; }
 		
 		std::size_t getNumberOfThreads() const {
-			return dispatchQueue.num_threads();
+			return scheduler.numThreads();
 		}
 		void setNumberOfThreads(std::size_t n) {
-			dispatchQueue.set_num_threads(n);
+			WM_Assert(!isBuilding());
+			scheduler.setNumThreads(n);
 		}
 		
+		/// Builds requested nodes at 'coarsePreviewSize' and at the preview resolution
+		/// before the requested resolution. Each level is published as it finishes,
+		/// an edit during a build starts over at the coarsest level. Off by default.
+		bool getProgressiveBuilds() const { return progressiveBuilds; }
+		void setProgressiveBuilds(bool value) { progressiveBuilds = value; }
+		
+		/// Longer edge of the coarsest level of progressive builds
+		static constexpr std::size_t coarsePreviewSize = 64;
+		
+		/// Lets row banded nodes feed downstream nodes band by band instead of
+		/// node by node. Takes effect with the next build.
+		bool getRowPipelining() const { return rowPipelining; }
+		void setRowPipelining(bool value) { rowPipelining = value; }
+		
+		/// High resolution node outputs are written to and looked up in this directory,
+		/// keyed on their parameters, resolution and inputs. nullopt disables the cache.
+		std::optional<std::filesystem::path> getOutputCacheDirectory() const;
+		void setOutputCacheDirectory(std::optional<std::filesystem::path>);
+		void clearOutputCache();
+		
+		/// Once node outputs exceed this many bytes, intermediate outputs are
+		/// released as soon as all their consumers in the current build are done.
+		std::size_t getMemoryBudget() const;
+		void setMemoryBudget(std::size_t bytes);
+		
+		/// Records when every node and job of the following builds ran, on which worker
+		/// and how long jobs waited in the queue. Off by default.
+		bool getTracing() const { return tracing; }
+		void setTracing(bool value) { tracing = value; }
+		
+		/// Trace of the last traced build, null if there was none
+		std::shared_ptr<BuildTrace const> lastTrace() const;
+		
+		/// If set, every traced build is also written to this directory as Chrome trace JSON.
+		std::optional<std::filesystem::path> getTraceDirectory() const;
+		void setTraceDirectory(std::optional<std::filesystem::path>);
+		
 		double progress() const { return _info.progress(); }
 		
 		utl::vector<utl::listener> makeListeners();
 		
 	private:
-		void build(BuildType, Network* network, utl::vector<utl::UUID> nodes);
+		/// One build of a request. Progressive requests are split into several.
+		struct BuildLevel {
+			BuildType type;
+			Network* network;
+			utl::vector<utl::UUID> nodes;
+			mtl::usize2 previewResolution;
+			/// Coarser than requested. Skipped if all target nodes have a preview already.
+			bool coarse = false;
+			/// Only this region of the targets is built, see FocusRequest.
+			std::optional<BuildRegion> region;
+		};
+		
+		/// Starts a build right away if idle. Otherwise the request is queued, merged with
+		/// a queued request for the same network and build type, and started once the
+		/// builds queued before it have finished.
+		void request(BuildRequest);
+		/// Requires 'buildMutex'
+		void enqueue(BuildRequest, bool first);
+		void requestLoop();
+		utl::vector<BuildLevel> makeLevels(BuildRequest) const;
+		BuildLevel popLevel();
+		void invalidate(Network* network, utl::UUID nodeID);
+		
+		void build(BuildLevel);
 		void cancelCurrentBuild();
 		
-		void buildCoordinator(Network* network,
-							  utl::vector<utl::UUID> nodes);
-		void coordSleep(std::unique_lock<std::mutex>&);
-		void coordStart(Network*, std::span<utl::UUID const> nodes);
-		void coordCancel(Network* network, std::unique_lock<std::mutex>&);
+		void startNode(std::size_t planIndex);
+		void dispatchPhase(std::size_t planIndex);
+		void nodeBuildFinished(std::size_t planIndex, bool success);
+		void releaseSuccessors(std::size_t planIndex, bool early);
+		void dispatchTile(std::size_t planIndex, RowRange rows, utl::function<void()> task);
+		void completeRows(std::size_t planIndex, RowRange rows);
+		bool isPipelined(std::size_t planIndex, std::size_t successor) const;
+		/// Sets up 'neededRows' and 'partial' of all plan nodes
+		void planRegion(std::optional<BuildRegion>, std::span<std::size_t const> targetIndices);
+		BuildScheduler::Priority taskPriority(std::size_t planIndex) const;
+		void retireNode();
+		void finishBuild();
+		
+		/// Copies per node progress to the network and redraws, at most once per 'progressPublishInterval'
+		void maybePublishProgress();
+		void publishProgress();
 		
 		utl::vector<utl::UUID> performSanityChecks(Network const* network,
 												   utl::vector<utl::UUID>) const;
 		
-		utl::small_vector<utl::UUID, 8> gatherUnbuiltRoots(Network const* network,
-														   std::span<utl::UUID const> leaves) const;
-		
-		bool allUpstreamNodesAreBuilt(Network const* network, std::size_t nodeIndex) const;
-		
-		std::size_t calculateTotalTargetBuildCount(Network const*,
-												   std::span<utl::UUID const>) const;
-		
 		NodeDependencyMap gatherDependencies(Network*, std::size_t nodeIndex, BuildType);
 		
-		void nodeBuildFinished(Network* network, utl::UUID nodeID, bool success);
-		
-		void cleanup(Network*);
+		void releaseInputs(std::size_t planIndex);
+		void evict(std::size_t planIndex);
+		/// Hands the upstream buffer of NodeImplementation::inPlaceInput() to the
+		/// node if nothing else reads it, and points 'dependencies' at it. Like evict(),
+		/// only while over the memory budget, the upstream node is unbuilt afterwards.
+		/// Only after a cache miss, the outputs must already be allocated.
+		void buildInPlace(std::size_t planIndex, NodeDependencyMap& dependencies);
+		
+		bool loadFromCache(std::size_t planIndex);
+		void storeToCache(std::size_t planIndex);
+		
+		/// Returns the trace of the build if it is to be written, see writeTrace()
+		std::shared_ptr<BuildTrace const> cleanup(Network*);
+		void recordJob(std::size_t planIndex, RowRange rows,
+					   BuildTrace::Clock::time_point queued, BuildTrace::Clock::time_point begin);
+		std::shared_ptr<BuildTrace const> finishTrace();
+		/// Writes the trace to the trace directory. Called without holding 'buildMutex' so request() never waits for the disk.
+		void writeTrace(BuildTrace const&);
 		
 		void invalidateView() {
 			if (_invalidateView)
@@ -99,27 +184,61 @@ namespace worldmachine {
 		
 		mtl::usize2 currentBuildResolution() const {
 			return _info.type() == BuildType::highResolution ?
-				resolution : previewResolution;
+				resolution : currentPreviewResolution;
 		}
 		
 	private:
-		std::thread coordThread;
-		std::mutex coordMutex;
-		std::condition_variable coordCV;
-		std::condition_variable mainCV;
+		std::mutex buildMutex;
+		std::condition_variable buildFinishedCV;
+		/// Guarded by 'buildMutex'. At most one per network and build type, oldest first.
+		utl::vector<BuildRequest> pendingRequests;
+		/// Remaining levels of the current request, next one first
+		utl::vector<BuildLevel> pendingLevels;
+		Network* focusNetwork = nullptr;
+		utl::UUID focusNodeID;
+		std::optional<BuildRegion> focusRegion;
+		bool startingBuild = false;
+		bool shuttingDown = false;
+		std::thread requestThread;
 		
 #if WM_DEBUGLEVEL
-		utl::concurrent_dispatch_queue dispatchQueue{2};
+		BuildScheduler scheduler{ 2 };
 #else
-		utl::concurrent_dispatch_queue dispatchQueue;
+		BuildScheduler scheduler{ std::max(1u, std::thread::hardware_concurrency()) };
 #endif
-		utl::hashset<utl::UUID> builtNodes;
-		utl::hashset<utl::UUID> buildingNodes;
+		/// State of the current build. Set up by build() before any node is dispatched.
+		Network* currentNetwork = nullptr;
+		std::unique_ptr<BuildPlan> plan;
+		std::atomic<std::size_t> activeNodes = 0;
+		std::atomic<std::size_t> nodeBuildsCompleted = 0;
+		std::atomic_bool cancelled = false;
+		bool rowPipelining = true;
+		bool progressiveBuilds = false;
+		/// Preview resolution of the current level
+		mtl::usize2 currentPreviewResolution = 0;
+		bool currentRowPipelining = false;
+		std::unique_ptr<NodeOutputCache> outputCache;
+		/// Indexed by plan index, empty if the cache is disabled or not used by the current build
+		utl::vector<NodeOutputCache::Key> cacheKeys;
+		
+		std::atomic_bool tracing = false;
+		/// Of the current build, null if it is not traced
+		std::unique_ptr<BuildTrace> currentTrace;
+		/// Jobs of the current trace by worker index, so workers never contend
+		utl::vector<utl::vector<BuildTrace::Job>> workerJobs;
+		/// Jobs of the current trace that ran off the worker pool, guarded by 'buildThreadJobsMutex'
+		utl::vector<BuildTrace::Job> buildThreadJobs;
+		std::mutex buildThreadJobsMutex;
+		mutable std::mutex traceMutex;
+		/// Guarded by 'traceMutex'
+		std::shared_ptr<BuildTrace const> _lastTrace;
+		std::optional<std::filesystem::path> traceDirectory;
+		std::size_t traceCount = 0;
 		
 		utl::function<void()> _invalidateView;
+		static constexpr std::chrono::milliseconds progressPublishInterval{ 33 };
+		std::atomic<std::chrono::steady_clock::rep> lastProgressPublish = 0;
 		std::size_t totalTargetBuildCount = 0;
-		std::size_t nodeBuildsCompleted = 0;
-		Signal signal = Signal::start;
 		mtl::usize2 resolution = WM_DEBUGLEVEL == 2 ? 256 : 1024;
 		mtl::usize2 previewResolution = WM_DEBUGLEVEL == 2 ? 64 : 256;
 		utl::precise_stopwatch stopwatch;
@@ -3,6 +3,8 @@
 #include <exception>
 
 #include <atomic>
+#include <optional>
+#include <mtl/mtl.hpp>
 #include <utl/common.hpp>
 #include <utl/messenger.hpp>
 #include <utl/vector.hpp>
@@ -68,4 +70,35 @@ namespace worldmachine {
 		
 	};
 	
+	/// Rectangle of an output in normalized coordinates, (0, 0) being the first pixel
+	struct BuildRegion {
+		mtl::float2 begin = 0, end = 1;
+		
+		bool operator==(BuildRegion const&) const = default;
+	};
+	
+	/// The node whose output the user is looking at. From the next build on, nodes
+	/// upstream of it are scheduled ahead of all other nodes. If 'region' is set,
+	/// requests covering the node first build only what is needed for that region.
+	struct FocusRequest: utl::message<FocusRequest> {
+		FocusRequest(Network* network, utl::UUID nodeID, std::optional<BuildRegion> region = std::nullopt):
+			network(network), nodeID(nodeID), region(region)
+		{}
+		
+		Network* network;
+		utl::UUID nodeID;
+		std::optional<BuildRegion> region;
+	};
+	
+	/// Invalidates all nodes downstream of 'nodeID', e.g. after a parameter edit.
+	/// Of a running build only the nodes downstream of 'nodeID' are cancelled.
+	struct InvalidateRequest: utl::message<InvalidateRequest> {
+		InvalidateRequest(Network* network, utl::UUID nodeID):
+			network(network), nodeID(nodeID)
+		{}
+		
+		Network* network;
+		utl::UUID nodeID;
+	};
+	
 }
@@ -0,0 +1,114 @@
+#include "BuildTrace.hpp"
+
+#include <ostream>
+#include <fstream>
+#include <algorithm>
+
+#include "Core/Debug.hpp"
+
+namespace worldmachine {
+
+	void BuildTrace::summarize() {
+		std::sort(jobs.begin(), jobs.end(), [](Job const& a, Job const& b) { return a.begin < b.begin; });
+		for (auto& node: nodes) {
+			node.jobCount = 0;
+			node.jobTime = {};
+			node.queueWaitTime = {};
+		}
+		for (auto const& job: jobs) {
+			auto& node = nodes[job.node];
+			++node.jobCount;
+			node.jobTime += job.end - job.begin;
+			node.queueWaitTime += job.begin - job.queued;
+			node.end = std::max(node.end, job.end);
+		}
+	}
+
+	/// Node names may contain anything
+	static void writeJSONString(std::ostream& str, std::string_view text) {
+		str << '"';
+		for (char const c: text) {
+			switch (c) {
+				case '"':  str << "\\\""; break;
+				case '\\': str << "\\\\"; break;
+				case '\n': str << "\\n"; break;
+				case '\t': str << "\\t"; break;
+				default:
+					if ((unsigned char)c < 0x20) {
+						str << ' ';
+					}
+					else {
+						str << c;
+					}
+			}
+		}
+		str << '"';
+	}
+
+	void BuildTrace::writeChromeTrace(std::ostream& str) const {
+		/// Timestamps in microseconds since the start of the build. Thread 0 is the
+		/// thread that planned the build and runs jobs off the pool, thread i + 1 is worker i.
+		auto micros = [&](Clock::time_point t) {
+			return std::chrono::duration<double, std::micro>(t - begin).count();
+		};
+		bool first = true;
+		auto event = [&]() -> std::ostream& {
+			str << (first ? "\n  " : ",\n  ");
+			first = false;
+			return str;
+		};
+
+		str << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+		event() << R"({"ph": "M", "pid": 1, "tid": 0, "name": "thread_name", "args": {"name": "Build"}})";
+		for (std::size_t i = 0; i < workerCount; ++i) {
+			event() << R"({"ph": "M", "pid": 1, "tid": )" << i + 1
+					<< R"(, "name": "thread_name", "args": {"name": "Worker )" << i << "\"}}";
+		}
+
+		event() << R"({"ph": "X", "pid": 1, "tid": 0, "cat": "build", "name": "Plan", "ts": )" << micros(begin)
+				<< ", \"dur\": " << micros(planned) - micros(begin) << "}";
+		event() << R"({"ph": "X", "pid": 1, "tid": 0, "cat": "build", "name": )";
+		writeJSONString(str, cancelled ? "Build (cancelled)" : "Build");
+		str << ", \"ts\": " << micros(begin) << ", \"dur\": " << micros(end) - micros(begin)
+			<< ", \"args\": {\"resolution\": \"" << resolution.x << "x" << resolution.y << "\"}}";
+
+		for (auto const& job: jobs) {
+			std::size_t const tid = job.worker == Job::buildThread ? 0 : std::size_t(job.worker) + 1;
+			event() << R"({"ph": "X", "pid": 1, "cat": "job", "tid": )" << tid << ", \"name\": ";
+			writeJSONString(str, nodes[job.node].name);
+			str << ", \"ts\": " << micros(job.begin) << ", \"dur\": " << micros(job.end) - micros(job.begin)
+				<< ", \"args\": {\"rows\": \"" << job.rows.begin << "-" << job.rows.end
+				<< "\", \"queueWaitUs\": " << micros(job.begin) - micros(job.queued) << "}}";
+		}
+
+		/// Nodes overlap each other, async events get a track each.
+		for (std::size_t i = 0; i < nodes.size(); ++i) {
+			auto const& node = nodes[i];
+			if (node.begin == Clock::time_point{}) {
+				continue;
+			}
+			event() << R"({"ph": "b", "pid": 1, "tid": 0, "cat": "node", "id": )" << i << ", \"name\": ";
+			writeJSONString(str, node.name);
+			str << ", \"ts\": " << micros(node.begin)
+				<< ", \"args\": {\"jobs\": " << node.jobCount
+				<< ", \"jobMs\": " << std::chrono::duration<double, std::milli>(node.jobTime).count()
+				<< ", \"queueWaitMs\": " << std::chrono::duration<double, std::milli>(node.queueWaitTime).count()
+				<< ", \"fromCache\": " << (node.loadedFromCache ? "true" : "false") << "}}";
+			event() << R"({"ph": "e", "pid": 1, "tid": 0, "cat": "node", "id": )" << i << ", \"name\": ";
+			writeJSONString(str, node.name);
+			str << ", \"ts\": " << micros(std::max(node.end, node.begin)) << "}";
+		}
+		str << "\n]}\n";
+	}
+
+	bool BuildTrace::writeChromeTrace(std::filesystem::path const& path) const {
+		std::ofstream file(path, std::ios::trunc);
+		if (!file) {
+			WM_Log(error, "Failed to open \"{}\" for writing", path.string());
+			return false;
+		}
+		writeChromeTrace(file);
+		return (bool)file;
+	}
+
+}
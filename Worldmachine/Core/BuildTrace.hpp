@@ -0,0 +1,67 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <filesystem>
+#include <utl/vector.hpp>
+#include <utl/UUID.hpp>
+#include <mtl/mtl.hpp>
+
+#include "BuildSystemFwd.hpp"
+#include "BuildJob.hpp"
+
+namespace worldmachine {
+
+	/// Timing of one build, recorded by the BuildSystem while tracing is enabled.
+	/// Can be written as Chrome trace JSON, which chrome://tracing and Perfetto open.
+	struct BuildTrace {
+		using Clock = std::chrono::steady_clock;
+
+		struct Node {
+			utl::UUID id;
+			std::string name;
+			/// From the start of the node to the end of its last job, zero if it never started
+			Clock::time_point begin, end;
+			std::size_t jobCount = 0;
+			/// Sum over all jobs of the node
+			Clock::duration jobTime{};
+			Clock::duration queueWaitTime{};
+			bool loadedFromCache = false;
+		};
+
+		struct Job {
+			/// 'worker' of jobs that ran off the worker pool, they go on the track of the build thread
+			static constexpr std::uint32_t buildThread = std::uint32_t(-1);
+			
+			/// Index into 'nodes'
+			std::uint32_t node;
+			/// Index of the scheduler worker that ran the job, or 'buildThread'
+			std::uint32_t worker;
+			RowRange rows;
+			/// 'begin - queued' is the queue wait, including any wait for rows of pipelined inputs.
+			Clock::time_point queued, begin, end;
+		};
+
+		BuildType type = BuildType::none;
+		mtl::usize2 resolution = 0;
+		std::size_t workerCount = 0;
+		bool cancelled = false;
+		Clock::time_point begin;
+		/// End of planning, the first node starts after this
+		Clock::time_point planned;
+		Clock::time_point end;
+		/// In plan order
+		utl::vector<Node> nodes;
+		/// Sorted by start time
+		utl::vector<Job> jobs;
+
+		/// Fills in the per node totals from 'jobs'
+		void summarize();
+
+		void writeChromeTrace(std::ostream&) const;
+		bool writeChromeTrace(std::filesystem::path const&) const;
+	};
+
+}
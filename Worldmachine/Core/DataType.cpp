@@ -16,7 +16,9 @@ namespace worldmachine {
 			"float2",
 			"float3",
 			"float4",
-			"integer"
+			"integer",
+			"float16",
+			"unorm16"
 		}[utl::log2(Int)];
 	}
 	
@@ -32,6 +34,9 @@ namespace worldmachine {
 		if (t == DataType::integer) {
 			return sizeof(int);
 		}
+		if (isCompactDataType(t)) {
+			return sizeof(std::uint16_t);
+		}
 		WM_DebugBreak("Unknown Data Type");
 	}
 	
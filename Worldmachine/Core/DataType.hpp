@@ -3,6 +3,8 @@
 #include "Core/Base.hpp"
 
 #include <iosfwd>
+#include <bit>
+#include <cstdint>
 #include <mtl/mtl.hpp>
 #include <utl/common.hpp>
 #include <utl/utility.hpp>
@@ -17,7 +19,11 @@ namespace worldmachine {
 		float2  = 1 << 1,
 		float3  = 1 << 2,
 		float4  = 1 << 3,
-		integer = 1 << 4
+		integer = 1 << 4,
+		
+		/// Compact scalar types. Stored in 16 bits, read as float1.
+		float16 = 1 << 5,
+		unorm16 = 1 << 6
 	};
 
 	UTL_ENUM_OPERATORS(DataType);
@@ -25,6 +31,80 @@ namespace worldmachine {
 	std::ostream& operator<<(std::ostream& str, DataType t);
 
 	std::size_t dataTypeSize(DataType t);
+	
+	inline bool isCompactDataType(DataType t) {
+		return t == DataType::float16 || t == DataType::unorm16;
+	}
+	
+	/// Type of the values read from images of type 't'
+	inline DataType decodedDataType(DataType t) {
+		return isCompactDataType(t) ? DataType::float1 : t;
+	}
+	
+	/// MARK: Float16
+	/// IEEE 754 half precision. Converts to and from float, so ImageView<Float16>
+	/// can be read and written like ImageView<float>.
+	struct Float16 {
+		Float16() = default;
+		Float16(float value): bits(encode(value)) {}
+		operator float() const { return decode(bits); }
+		
+		/// Rounds to nearest even, overflows to infinity.
+		static std::uint16_t encode(float value) {
+			std::uint32_t x = std::bit_cast<std::uint32_t>(value);
+			std::uint16_t const sign = std::uint16_t((x >> 16) & 0x8000);
+			x &= 0x7FFFFFFF;
+			if (x >= 0x47800000) {
+				/// Too large, infinity or NaN
+				return std::uint16_t(sign | (x > 0x7F800000 ? 0x7E00 : 0x7C00));
+			}
+			if (x < 0x38800000) {
+				/// Subnormal, let the FPU round by aligning the mantissa to that of 0.5
+				float const aligned = std::bit_cast<float>(x) + 0.5f;
+				return std::uint16_t(sign | (std::bit_cast<std::uint32_t>(aligned) - 0x3F000000));
+			}
+			/// Rebias the exponent and round, ties go to the even mantissa.
+			std::uint32_t const mantissaOdd = (x >> 13) & 1;
+			x += 0xC8000FFF + mantissaOdd;
+			return std::uint16_t(sign | (x >> 13));
+		}
+		
+		static float decode(std::uint16_t bits) {
+			std::uint32_t const sign = std::uint32_t(bits & 0x8000) << 16;
+			std::uint32_t const exponent = (bits >> 10) & 0x1F;
+			std::uint32_t const mantissa = bits & 0x3FF;
+			if (exponent == 0) {
+				float const magnitude = float(mantissa) * 0x1p-24f;
+				return std::bit_cast<float>(std::bit_cast<std::uint32_t>(magnitude) | sign);
+			}
+			if (exponent == 0x1F) {
+				return std::bit_cast<float>(sign | 0x7F800000 | mantissa << 13);
+			}
+			return std::bit_cast<float>(sign | (exponent + 112) << 23 | mantissa << 13);
+		}
+		
+		std::uint16_t bits = 0;
+	};
+	
+	/// MARK: UNorm16
+	/// Fixed point in [0, 1]. Values outside are clamped on write.
+	struct UNorm16 {
+		UNorm16() = default;
+		UNorm16(float value): bits(encode(value)) {}
+		operator float() const { return decode(bits); }
+		
+		static std::uint16_t encode(float value) {
+			/// Also maps NaN to 0
+			float const clamped = value > 0 ? (value < 1 ? value : 1) : 0;
+			return std::uint16_t(clamped * 65535.0f + 0.5f);
+		}
+		
+		static float decode(std::uint16_t bits) {
+			return float(bits) * (1.0f / 65535.0f);
+		}
+		
+		std::uint16_t bits = 0;
+	};
 
 
 	template <DataType DT>
@@ -35,6 +115,8 @@ namespace worldmachine {
 			else if constexpr (DT == DataType::float2) { return mtl::float2{}; }
 			else if constexpr (DT == DataType::float3) { return mtl::float3{}; }
 			else if constexpr (DT == DataType::float4) { return mtl::float4{}; }
+			else if constexpr (DT == DataType::float16) { return Float16{}; }
+			else if constexpr (DT == DataType::unorm16) { return UNorm16{}; }
 		}
 		
 	public:
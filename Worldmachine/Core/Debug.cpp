@@ -5,19 +5,21 @@
 
 namespace worldmachine {
 	
-	std::pair<std::unique_lock<std::mutex>, utl::vector<utl::log_message>&> globalLog() {
-		static utl::vector<utl::log_message> logs;
-		static std::mutex mutex;
-		return { std::unique_lock(mutex), logs };
-	}
-	
 	utl::logger& globalLogger() {
 		static utl::logger l = [&]{
 			utl::logger l("Worldmachine");
-			l.add_listener(utl::make_stdout_listener());
+			/// Printing happens on the log thread, the caller only pays for formatting.
 			l.add_listener([](utl::log_message msg){
-				auto [lock, log] = globalLog();
-				log.push_back(std::move(msg));
+				postLog({
+					.category = LogCategory::general,
+					.level = msg.level,
+					.time = std::chrono::system_clock::now(),
+					.threadID = msg.thread_id,
+					.file = std::string(msg.source_info.file),
+					.function = std::string(msg.source_info.function),
+					.line = (std::uint32_t)msg.source_info.line,
+					.message = std::string(std::move(msg.message))
+				});
 			});
 			return l;
 		}();
@@ -6,8 +6,11 @@
 
 #include <utl/fancy_debug.hpp>
 #include <utl/log.hpp>
+#include <utl/format.hpp>
 #include <mutex>
 
+#include "Core/Log.hpp"
+
 #ifndef WM_DEBUGLEVEL
 #define WM_DEBUGLEVEL 0
 #endif
@@ -24,8 +27,8 @@
 	UTL_FANCY_BOUNDS_CHECK("WorldMachine", WM_DEBUGLEVEL, index, lower, upper)
 
 namespace worldmachine {
-	constexpr utl::log_level logLevelMask = WM_LOGLEVEL == 0 ? utl::log_level::warning | utl::log_level::error | utl::log_level::fatal : utl::log_level::all;
-	std::pair<std::unique_lock<std::mutex>, utl::vector<utl::log_message>&> globalLog();
+	constexpr utl::log_level logLevelMask = categoryLevelMask(LogCategory::general);
+	/// Hands every message to the log thread, see postLog()
 	utl::logger& globalLogger();
 }
 
@@ -34,4 +37,21 @@ namespace worldmachine {
 					   ::worldmachine::logLevelMask,   \
 					   __VA_ARGS__)
 
+/// For hot paths. Compiles to nothing unless 'level' is enabled for 'category'
+/// by WM_LOGLEVEL_<CATEGORY>, otherwise formats on the calling thread and queues
+/// the message without taking a lock.
+/// Usage: WM_LogCategory(kernel, debug, "{} droplets", count);
+#define WM_LogCategory(category, level, ...)                                                  \
+	do {                                                                                      \
+		if constexpr (::worldmachine::logEnabled(::worldmachine::LogCategory::category,       \
+												 ::utl::log_level::level)) {                  \
+			::worldmachine::postLog({ ::worldmachine::LogCategory::category,                  \
+									  ::utl::log_level::level,                                \
+									  std::chrono::system_clock::now(),                       \
+									  std::this_thread::get_id(),                             \
+									  __FILE__, __func__, __LINE__,                           \
+									  ::utl::format(__VA_ARGS__) });                          \
+		}                                                                                     \
+	} while (0)
+
 #endif // WORLDMACHINE_CPP
@@ -0,0 +1,83 @@
+#include "BlurKernels.hpp"
+
+#include <cmath>
+#include <algorithm>
+
+namespace worldmachine {
+
+	std::array<std::size_t, gaussianBoxCount> gaussianBoxRadii(float sigma) {
+		std::array<std::size_t, gaussianBoxCount> radii{};
+		if (!(sigma > 0)) {
+			return radii;
+		}
+		/// Kovesi, "Fast Almost-Gaussian Filtering": 'm' boxes of odd width 'wl'
+		/// and the others of width 'wl' + 2.
+		double const n = gaussianBoxCount;
+		double const variance = double(sigma) * sigma;
+		long wl = (long)std::floor(std::sqrt(12 * variance / n + 1));
+		if (wl % 2 == 0) {
+			--wl;
+		}
+		long const m = std::lround((12 * variance - n * wl * wl - 4 * n * wl - 3 * n) / (-4.0 * wl - 4));
+		for (std::size_t i = 0; i < gaussianBoxCount; ++i) {
+			long const width = (long)i < m ? wl : wl + 2;
+			radii[i] = (std::size_t)(width - 1) / 2;
+		}
+		return radii;
+	}
+
+	void boxBlur(float const* source, float* dest, std::size_t count, std::size_t radius) {
+		if (count == 0) {
+			return;
+		}
+		if (radius == 0) {
+			std::copy_n(source, count, dest);
+			return;
+		}
+		std::ptrdiff_t const last = count - 1;
+		std::ptrdiff_t const r = radius;
+		auto at = [&](std::ptrdiff_t i) { return source[std::clamp<std::ptrdiff_t>(i, 0, last)]; };
+
+		/// Window around -1, so the loop can add before it stores. Only the part
+		/// inside the row is summed, the rest repeats the edges.
+		double sum = double(r + 2) * source[0];
+		for (std::ptrdiff_t i = 1; i <= std::min(r - 1, last); ++i) {
+			sum += source[i];
+		}
+		sum += double(std::max<std::ptrdiff_t>(r - 1 - last, 0)) * source[last];
+
+		double const scale = 1.0 / (2 * r + 1);
+		for (std::ptrdiff_t i = 0; i <= last; ++i) {
+			sum += at(i + r) - at(i - r - 1);
+			dest[i] = float(sum * scale);
+		}
+	}
+
+	void gaussianBlur(float const* source, float* dest, std::size_t count,
+					  std::array<std::size_t, gaussianBoxCount> const& radii, float* scratch)
+	{
+		static_assert(gaussianBoxCount == 3);
+		boxBlur(source, dest, count, radii[0]);
+		boxBlur(dest, scratch, count, radii[1]);
+		boxBlur(scratch, dest, count, radii[2]);
+	}
+
+	void transpose(float const* source, std::size_t sourceStride,
+				   float* dest, std::size_t destStride, mtl::usize2 size)
+	{
+		/// 4 KiB per side
+		std::size_t const tileSize = 32;
+		for (std::size_t y0 = 0; y0 < size.y; y0 += tileSize) {
+			std::size_t const y1 = std::min(y0 + tileSize, size.y);
+			for (std::size_t x0 = 0; x0 < size.x; x0 += tileSize) {
+				std::size_t const x1 = std::min(x0 + tileSize, size.x);
+				for (std::size_t x = x0; x < x1; ++x) {
+					for (std::size_t y = y0; y < y1; ++y) {
+						dest[x * destStride + y] = source[y * sourceStride + x];
+					}
+				}
+			}
+		}
+	}
+
+}
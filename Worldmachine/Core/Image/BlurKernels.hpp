@@ -0,0 +1,30 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <mtl/mtl.hpp>
+
+namespace worldmachine {
+
+	/// Number of box filters in a row that approximate one Gaussian
+	inline constexpr std::size_t gaussianBoxCount = 3;
+
+	/// Radii of 'gaussianBoxCount' box filters whose combined variance is
+	/// closest to 'sigma'^2. All zero if 'sigma' is not positive.
+	std::array<std::size_t, gaussianBoxCount> gaussianBoxRadii(float sigma);
+
+	/// dest[i] = mean of source[i - radius, i + radius], reading past the ends
+	/// repeats the edge values. Keeps a running sum, so the cost per element does
+	/// not depend on 'radius'. 'source' and 'dest' must not overlap.
+	void boxBlur(float const* source, float* dest, std::size_t count, std::size_t radius);
+
+	/// Applies the boxes of 'radii' in turn. 'scratch' holds 'count' floats.
+	void gaussianBlur(float const* source, float* dest, std::size_t count,
+					  std::array<std::size_t, gaussianBoxCount> const& radii, float* scratch);
+
+	/// dest[x * destStride + y] = source[y * sourceStride + x] for the 'size.x'
+	/// by 'size.y' block at 'source'. Goes tile by tile so both sides stay in L1.
+	void transpose(float const* source, std::size_t sourceStride,
+				   float* dest, std::size_t destStride, mtl::usize2 size);
+
+}
@@ -25,4 +25,26 @@ namespace worldmachine {
 		
 	}
 	
+	Image decodeImage(Image const& image) {
+		if (!isCompactDataType(image.dataType())) {
+			return image;
+		}
+		Image result(DataType::float1);
+		result.adoptStorage(utl::vector<float>(Image::storageSize(DataType::float1, image.size())), image.size());
+		std::size_t const count = image.size().fold(utl::multiplies);
+		auto const* const source = reinterpret_cast<std::uint16_t const*>(image.data());
+		float* const dest = result.data();
+		if (image.dataType() == DataType::float16) {
+			for (std::size_t i = 0; i < count; ++i) {
+				dest[i] = Float16::decode(source[i]);
+			}
+		}
+		else {
+			for (std::size_t i = 0; i < count; ++i) {
+				dest[i] = UNorm16::decode(source[i]);
+			}
+		}
+		return result;
+	}
+	
 }
@@ -7,6 +7,7 @@
 #include <utl/vector.hpp>
 #include <utl/functional.hpp>
 #include <span>
+#include <algorithm>
 
 namespace worldmachine {
 	
@@ -37,6 +38,27 @@ namespace worldmachine {
 		
 		bool empty() const { return m_data.empty(); }
 		
+		/// Number of floats backing an image of this type and size. Compact types
+		/// are packed, the last float may be half used.
+		static std::size_t storageSize(DataType dataType, mtl::usize2 size) {
+			std::size_t const bytes = size.fold(utl::multiplies) * worldmachine::dataTypeSize(dataType);
+			return (bytes + sizeof(float) - 1) / sizeof(float);
+		}
+		std::size_t storageSize() const { return m_data.size(); }
+		
+		/// Hands the storage to the caller and leaves the image empty.
+		utl::vector<float> releaseStorage() {
+			m_size = { 0, 0 };
+			utl::vector<float> result = std::move(m_data);
+			m_data.clear();
+			return result;
+		}
+		void adoptStorage(utl::vector<float> storage, mtl::usize2 size) {
+			WM_Assert(storage.size() == storageSize(m_dataType, size));
+			m_size = size;
+			m_data = std::move(storage);
+		}
+		
 		float* data() { return m_data.data(); }
 		float const* data() const { return m_data.data(); }
 		
@@ -44,7 +66,8 @@ namespace worldmachine {
 			auto const result = utl::as_const(*this).toFloatSpan();
 			return { const_cast<float*>(result.data()), result.size() };
 		}
-		std::span<float const> toFloatSpan() const { return { data(), size().fold(utl::multiplies) }; }
+		/// All of the storage, also for multi-channel and compact types
+		std::span<float const> toFloatSpan() const { return { data(), m_data.size() }; }
 		
 		auto begin() { return m_data.begin(); }
 		auto begin() const { return m_data.begin(); }
@@ -52,7 +75,7 @@ namespace worldmachine {
 		auto end() const { return m_data.end(); }
 		
 	private:
-		std::size_t _flatImageSize() const { return m_size.fold(utl::multiplies) * utl::to_underlying(m_dataType); }
+		std::size_t _flatImageSize() const { return storageSize(m_dataType, m_size); }
 		
 	private:
 		DataType m_dataType = DataType::float1;
@@ -60,6 +83,47 @@ namespace worldmachine {
 		utl::vector<float> m_data;
 	};
 	
+	/// Copy of 'image' with compact data types converted to float1. Other images
+	/// are copied as they are.
+	Image decodeImage(Image const& image);
+	
+	/// MARK: ImageTile
+	/// Rectangle of an image with its own row stride, see ImageView::forEachTile()
+	/// and TiledImage::forEachTile(). Coordinates are relative to the tile.
+	template <typename VT>
+	class ImageTile {
+	public:
+		using ValueType = VT;
+		
+	public:
+		ImageTile(ValueType* data, mtl::usize2 origin, mtl::usize2 size, std::size_t rowStride):
+			_data(data), _origin(origin), _size(size), _rowStride(rowStride)
+		{}
+		
+		ValueType* data() const { return _data; }
+		/// Position of the first pixel in the image
+		mtl::usize2 origin() const { return _origin; }
+		mtl::usize2 size() const { return _size; }
+		/// Distance between the starts of two rows in elements
+		std::size_t rowStride() const { return _rowStride; }
+		
+		ValueType& operator()(std::size_t i, std::size_t j) const {
+			WM_BoundsCheck(i, 0, _size.x);
+			WM_BoundsCheck(j, 0, _size.y);
+			return _data[_rowStride * j + i];
+		}
+		
+		std::span<ValueType> row(std::size_t j) const {
+			WM_BoundsCheck(j, 0, _size.y);
+			return { _data + _rowStride * j, _size.x };
+		}
+		
+	private:
+		ValueType* _data;
+		mtl::usize2 _origin, _size;
+		std::size_t _rowStride;
+	};
+	
 	/// MARK: ImageView
 	template <typename>
 	class ImageView;
@@ -120,6 +184,19 @@ namespace worldmachine {
 		ValueType* begin() const { return _data; }
 		ValueType* end() const { return _data + _size.x * _size.y; }
 		
+		/// Calls 'f' with every tile of at most 'tileSize' pixels, row by row. Lets
+		/// kernels written against ImageTile run on a TiledImage as well.
+		void forEachTile(mtl::usize2 tileSize, utl::invocable<ImageTile<ValueType>> auto&& f) const {
+			WM_Expect(tileSize.x > 0 && tileSize.y > 0);
+			for (std::size_t y = 0; y < _size.y; y += tileSize.y) {
+				for (std::size_t x = 0; x < _size.x; x += tileSize.x) {
+					mtl::usize2 const origin = { x, y };
+					mtl::usize2 const size = { std::min(tileSize.x, _size.x - x), std::min(tileSize.y, _size.y - y) };
+					f(ImageTile<ValueType>(&(*this)(x, y), origin, size, _size.x));
+				}
+			}
+		}
+		
 	private:
 		ValueType* _data = nullptr;
 		mtl::usize2 _size = 0;
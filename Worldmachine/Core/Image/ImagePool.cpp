@@ -0,0 +1,101 @@
+#include "ImagePool.hpp"
+
+#include <algorithm>
+
+namespace worldmachine {
+
+	ImagePool& ImagePool::instance() {
+		static ImagePool pool;
+		return pool;
+	}
+
+	void ImagePool::setBudget(std::size_t bytes) {
+		std::lock_guard lock(mutex);
+		_budget = bytes;
+		trim();
+	}
+
+	std::size_t ImagePool::residentBytes() const {
+		std::lock_guard lock(mutex);
+		return liveBytes + freeBytes;
+	}
+
+	void ImagePool::allocate(Image& image, mtl::usize2 size) {
+		std::size_t const floatCount = Image::storageSize(image.dataType(), size);
+		if (image.storageSize() == floatCount) {
+			/// Same size as the last build, reuse in place.
+			image.adoptStorage(image.releaseStorage(), size);
+			std::fill(image.begin(), image.end(), 0.0f);
+			return;
+		}
+		release(image);
+
+		utl::vector<float> storage;
+		bool recycled = false;
+		{
+			std::lock_guard lock(mutex);
+			if (auto itr = freeBuffers.find(floatCount); itr != freeBuffers.end() && !itr->second.empty()) {
+				storage = std::move(itr->second.back());
+				itr->second.pop_back();
+				freeBytes -= floatCount * sizeof(float);
+				recycled = true;
+			}
+			liveBytes += floatCount * sizeof(float);
+			++liveCounts[floatCount];
+		}
+		if (recycled) {
+			std::fill(storage.begin(), storage.end(), 0.0f);
+		}
+		else {
+			/// Allocate outside the lock, this touches every page.
+			storage.resize(floatCount);
+		}
+		image.adoptStorage(std::move(storage), size);
+	}
+
+	void ImagePool::release(Image& image) {
+		auto storage = image.releaseStorage();
+		std::size_t const floatCount = storage.size();
+		if (floatCount == 0) {
+			return;
+		}
+		std::lock_guard lock(mutex);
+		liveBytes -= std::min(liveBytes, floatCount * sizeof(float));
+		auto const live = liveCounts.find(floatCount);
+		if (live == liveCounts.end() || --live->second == 0) {
+			/// Last image of this size, nothing is likely to ask for it again.
+			if (live != liveCounts.end()) {
+				liveCounts.erase(live);
+			}
+			if (auto itr = freeBuffers.find(floatCount); itr != freeBuffers.end()) {
+				freeBytes -= itr->second.size() * floatCount * sizeof(float);
+				freeBuffers.erase(itr);
+			}
+			trim();
+			return;
+		}
+		freeBytes += floatCount * sizeof(float);
+		freeBuffers[floatCount].push_back(std::move(storage));
+		trim();
+	}
+
+	void ImagePool::trim() {
+		/// Drop recycled buffers, largest first, until we are back within budget
+		/// and hold no more than the live images.
+		std::size_t const freeLimit = std::min(liveBytes, _budget - std::min(_budget, liveBytes));
+		while (freeBytes > freeLimit) {
+			auto largest = freeBuffers.end();
+			for (auto itr = freeBuffers.begin(); itr != freeBuffers.end(); ++itr) {
+				if (!itr->second.empty() && (largest == freeBuffers.end() || itr->first > largest->first)) {
+					largest = itr;
+				}
+			}
+			if (largest == freeBuffers.end()) {
+				break;
+			}
+			largest->second.pop_back();
+			freeBytes -= largest->first * sizeof(float);
+		}
+	}
+
+}
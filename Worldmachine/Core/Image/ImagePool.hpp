@@ -0,0 +1,50 @@
+#pragma once
+
+#include <mutex>
+#include <limits>
+#include <cstddef>
+#include <utl/vector.hpp>
+#include <utl/hashmap.hpp>
+#include <mtl/mtl.hpp>
+
+#include "Image.hpp"
+
+namespace worldmachine {
+
+	/// Owns the storage of all node outputs. Buffers of released images are kept
+	/// and handed out again for images of the same size, as long as everything
+	/// stays within the memory budget. Only sizes that some live image still has
+	/// are kept, and never more free bytes than live bytes, so sizes that went out
+	/// of use (progressive levels, old resolutions, deleted nodes) are given back.
+	class ImagePool {
+	public:
+		static ImagePool& instance();
+
+		/// In bytes, counts storage of live images and recycled buffers
+		std::size_t budget() const { return _budget; }
+		void setBudget(std::size_t bytes);
+
+		std::size_t residentBytes() const;
+		bool overBudget() const { return residentBytes() > budget(); }
+
+		/// Gives 'image' zeroed storage for 'size', reusing its own or a recycled buffer if possible.
+		void allocate(Image& image, mtl::usize2 size);
+
+		/// Returns the storage of 'image' to the pool, leaving it empty.
+		void release(Image& image);
+
+	private:
+		void trim();
+
+	private:
+		mutable std::mutex mutex;
+		std::size_t _budget = std::numeric_limits<std::size_t>::max();
+		std::size_t liveBytes = 0;
+		std::size_t freeBytes = 0;
+		/// Live images by float count
+		utl::hashmap<std::size_t, std::size_t> liveCounts;
+		/// Recycled buffers by float count
+		utl::hashmap<std::size_t, utl::vector<utl::vector<float>>> freeBuffers;
+	};
+
+}
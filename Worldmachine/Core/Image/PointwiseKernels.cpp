@@ -0,0 +1,222 @@
+#include "PointwiseKernels.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#if defined(__AVX2__)
+#	include <immintrin.h>
+#	define WM_POINTWISE_AVX2 1
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#	include <arm_neon.h>
+#	define WM_POINTWISE_NEON 1
+#endif
+
+#include "Core/Debug.hpp"
+
+namespace worldmachine {
+
+	void addPointwiseJobs(BuildJob& job, mtl::usize2 size,
+						  utl::function<void(std::size_t begin, std::size_t end)> const& f)
+	{
+		if (size.x == 0) {
+			return;
+		}
+		std::size_t const rowsPerJob = std::max<std::size_t>(1, pointwiseChunkSize / size.x);
+		job.reserve((size.y + rowsPerJob - 1) / rowsPerJob);
+		for (std::size_t yStart = 0; yStart < size.y; yStart += rowsPerJob) {
+			std::size_t const yEnd = std::min<std::size_t>(yStart + rowsPerJob, size.y);
+			job.add({ yStart, yEnd }, [f, begin = yStart * size.x, end = yEnd * size.x]{
+				f(begin, end);
+			});
+		}
+	}
+
+	namespace {
+
+		/// MARK: Vector types
+		/// Every kernel is written once against this interface and instantiated
+		/// for the widest available vector and for the scalar remainder.
+		struct Scalar {
+			static constexpr std::size_t width = 1;
+			float v;
+
+			static Scalar load(float const* p) { return { *p }; }
+			static Scalar broadcast(float x) { return { x }; }
+			void store(float* p) const { *p = v; }
+
+			friend Scalar operator+(Scalar a, Scalar b) { return { a.v + b.v }; }
+			friend Scalar operator-(Scalar a, Scalar b) { return { a.v - b.v }; }
+			friend Scalar operator*(Scalar a, Scalar b) { return { a.v * b.v }; }
+			friend Scalar operator/(Scalar a, Scalar b) { return { a.v / b.v }; }
+			friend Scalar min(Scalar a, Scalar b) { return { std::min(a.v, b.v) }; }
+			friend Scalar max(Scalar a, Scalar b) { return { std::max(a.v, b.v) }; }
+		};
+
+#if WM_POINTWISE_AVX2
+		struct Vector {
+			static constexpr std::size_t width = 8;
+			__m256 v;
+
+			static Vector load(float const* p) { return { _mm256_loadu_ps(p) }; }
+			static Vector broadcast(float x) { return { _mm256_set1_ps(x) }; }
+			void store(float* p) const { _mm256_storeu_ps(p, v); }
+
+			friend Vector operator+(Vector a, Vector b) { return { _mm256_add_ps(a.v, b.v) }; }
+			friend Vector operator-(Vector a, Vector b) { return { _mm256_sub_ps(a.v, b.v) }; }
+			friend Vector operator*(Vector a, Vector b) { return { _mm256_mul_ps(a.v, b.v) }; }
+			friend Vector operator/(Vector a, Vector b) { return { _mm256_div_ps(a.v, b.v) }; }
+			/// Operand order matches std::min / std::max for equal values
+			friend Vector min(Vector a, Vector b) { return { _mm256_min_ps(b.v, a.v) }; }
+			friend Vector max(Vector a, Vector b) { return { _mm256_max_ps(b.v, a.v) }; }
+		};
+#elif WM_POINTWISE_NEON
+		struct Vector {
+			static constexpr std::size_t width = 4;
+			float32x4_t v;
+
+			static Vector load(float const* p) { return { vld1q_f32(p) }; }
+			static Vector broadcast(float x) { return { vdupq_n_f32(x) }; }
+			void store(float* p) const { vst1q_f32(p, v); }
+
+			friend Vector operator+(Vector a, Vector b) { return { vaddq_f32(a.v, b.v) }; }
+			friend Vector operator-(Vector a, Vector b) { return { vsubq_f32(a.v, b.v) }; }
+			friend Vector operator*(Vector a, Vector b) { return { vmulq_f32(a.v, b.v) }; }
+			friend Vector operator/(Vector a, Vector b) { return { vdivq_f32(a.v, b.v) }; }
+			friend Vector min(Vector a, Vector b) { return { vminq_f32(a.v, b.v) }; }
+			friend Vector max(Vector a, Vector b) { return { vmaxq_f32(a.v, b.v) }; }
+		};
+#else
+		using Vector = Scalar;
+#endif
+
+		template <typename F>
+		void transform(float const* a, float* dest, std::size_t count, F&& f) {
+			std::size_t i = 0;
+			if constexpr (Vector::width > 1) {
+				for (; i + Vector::width <= count; i += Vector::width) {
+					f(Vector::load(a + i)).store(dest + i);
+				}
+			}
+			for (; i < count; ++i) {
+				f(Scalar::load(a + i)).store(dest + i);
+			}
+		}
+
+		template <typename F>
+		void transform(float const* a, float const* b, float* dest, std::size_t count, F&& f) {
+			std::size_t i = 0;
+			if constexpr (Vector::width > 1) {
+				for (; i + Vector::width <= count; i += Vector::width) {
+					f(Vector::load(a + i), Vector::load(b + i)).store(dest + i);
+				}
+			}
+			for (; i < count; ++i) {
+				f(Scalar::load(a + i), Scalar::load(b + i)).store(dest + i);
+			}
+		}
+
+		/// utl::mix(x, b, s)
+		template <typename V>
+		V mix(V x, V b, V s) {
+			return x + (b - x) * s;
+		}
+
+	}
+
+	void combine(CombinerMode mode, float strength,
+				 float const* a, float const* b, float* dest, std::size_t count)
+	{
+		switch (mode) {
+			case CombinerMode::avg:
+				transform(a, b, dest, count, [=](auto a, auto b) {
+					using V = decltype(a);
+					return (V::broadcast(1) - V::broadcast(strength)) * a + V::broadcast(strength) * b;
+				});
+				break;
+			case CombinerMode::add:
+				transform(a, b, dest, count, [=](auto a, auto b) {
+					using V = decltype(a);
+					return a + b * V::broadcast(strength);
+				});
+				break;
+			case CombinerMode::multiply:
+				transform(a, b, dest, count, [=](auto a, auto b) {
+					using V = decltype(a);
+					return a * mix(V::broadcast(1), b, V::broadcast(strength));
+				});
+				break;
+			case CombinerMode::subtract:
+				transform(a, b, dest, count, [=](auto a, auto b) {
+					using V = decltype(a);
+					return a - b * V::broadcast(strength);
+				});
+				break;
+			case CombinerMode::divide:
+				transform(a, b, dest, count, [=](auto a, auto b) {
+					using V = decltype(a);
+					return a / mix(V::broadcast(1), b, V::broadcast(strength));
+				});
+				break;
+			case CombinerMode::min:
+				transform(a, b, dest, count, [=](auto a, auto b) {
+					using V = decltype(a);
+					return min(a, mix(V::broadcast(1), b, V::broadcast(strength)));
+				});
+				break;
+			case CombinerMode::max:
+				transform(a, b, dest, count, [=](auto a, auto b) {
+					using V = decltype(a);
+					return max(a, mix(V::broadcast(0), b, V::broadcast(strength)));
+				});
+				break;
+			case CombinerMode::pow:
+				/// No vector pow, but the loop still profits from chunking.
+				for (std::size_t i = 0; i < count; ++i) {
+					dest[i] = std::pow(a[i], 1.0f + (b[i] - 1.0f) * strength);
+				}
+				break;
+			case CombinerMode::screen:
+				transform(a, b, dest, count, [=](auto a, auto b) {
+					using V = decltype(a);
+					auto const one = V::broadcast(1);
+					return one - (one - a) * (one - b * V::broadcast(strength));
+				});
+				break;
+			default:
+				WM_Log(error, "Unknown Combiner Mode [{}]", (int)mode);
+				break;
+		}
+	}
+
+	void scaleOffset(float const* source, float* dest, std::size_t count, float scale, float offset) {
+		transform(source, dest, count, [=](auto x) {
+			using V = decltype(x);
+			return x * V::broadcast(scale) + V::broadcast(offset);
+		});
+	}
+
+	void interleave(float const* a, float const* b, float* dest, std::size_t count) {
+		std::size_t i = 0;
+#if WM_POINTWISE_AVX2
+		for (; i + 8 <= count; i += 8) {
+			__m256 const va = _mm256_loadu_ps(a + i);
+			__m256 const vb = _mm256_loadu_ps(b + i);
+			/// Unpack works per 128 bit lane, the permutes put the lanes back in order.
+			__m256 const lo = _mm256_unpacklo_ps(va, vb);
+			__m256 const hi = _mm256_unpackhi_ps(va, vb);
+			_mm256_storeu_ps(dest + 2 * i,     _mm256_permute2f128_ps(lo, hi, 0x20));
+			_mm256_storeu_ps(dest + 2 * i + 8, _mm256_permute2f128_ps(lo, hi, 0x31));
+		}
+#elif WM_POINTWISE_NEON
+		for (; i + 4 <= count; i += 4) {
+			vst2q_f32(dest + 2 * i, float32x4x2_t{ vld1q_f32(a + i), vld1q_f32(b + i) });
+		}
+#endif
+		for (; i < count; ++i) {
+			dest[2 * i]     = a[i];
+			dest[2 * i + 1] = b[i];
+		}
+	}
+
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <mtl/mtl.hpp>
+#include <utl/functional.hpp>
+
+#include "Core/BuildJob.hpp"
+
+namespace worldmachine {
+
+	enum struct CombinerMode: int {
+		avg = 0,
+		add, multiply, subtract, divide,
+		min, max,
+		pow, screen, COUNT
+	};
+
+	/// Number of pixels one point-wise job processes, chosen such that all
+	/// streams of a job fit into L2 at once.
+	inline constexpr std::size_t pointwiseChunkSize = std::size_t(1) << 16;
+
+	/// Adds row banded jobs of about 'pointwiseChunkSize' pixels each to 'job'.
+	/// 'f' is called with the range of flat pixel indices of one band.
+	void addPointwiseJobs(BuildJob& job, mtl::usize2 size,
+						  utl::function<void(std::size_t begin, std::size_t end)> const& f);
+
+	/// MARK: Kernels
+	/// Pointers need no particular alignment. All kernels use AVX2 or NEON if the
+	/// build enables them and fall back to scalar code otherwise.
+
+	/// dest[i] = a[i] <mode> b[i], weighted by 'strength'
+	void combine(CombinerMode mode, float strength,
+				 float const* a, float const* b, float* dest, std::size_t count);
+
+	/// dest[i] = source[i] * scale + offset
+	void scaleOffset(float const* source, float* dest, std::size_t count, float scale, float offset);
+
+	/// dest[2i] = a[i], dest[2i + 1] = b[i]
+	void interleave(float const* a, float const* b, float* dest, std::size_t count);
+
+}
@@ -0,0 +1,245 @@
+#include "TiledImage.hpp"
+
+#include <random>
+#include <cstring>
+#include <algorithm>
+
+namespace worldmachine {
+
+	/// MARK: - TileCache
+	TileCache& TileCache::instance() {
+		static TileCache cache;
+		return cache;
+	}
+
+	std::size_t TileCache::budget() const {
+		std::lock_guard lock(mutex);
+		return _budget;
+	}
+
+	void TileCache::setBudget(std::size_t bytes) {
+		std::unique_lock lock(mutex);
+		_budget = bytes;
+		auto victims = evict();
+		lock.unlock();
+		writeBack(std::move(victims));
+	}
+
+	std::size_t TileCache::residentBytes() const {
+		std::lock_guard lock(mutex);
+		return _residentBytes;
+	}
+
+	utl::vector<TileCache::Victim> TileCache::evict() {
+		utl::vector<Victim> victims;
+		for (auto itr = lru.begin(); itr != lru.end() && _residentBytes > _budget;) {
+			auto const [image, tileIndex] = *itr;
+			auto& tile = image->tiles[tileIndex];
+			if (tile.pins > 0) {
+				++itr;
+				continue;
+			}
+			_residentBytes -= tile.data.size() * sizeof(float);
+			if (tile.dirty) {
+				tile.busy = true;
+				victims.push_back({ image, tileIndex, std::move(tile.data) });
+			}
+			tile.data = {};
+			tile.resident = false;
+			itr = lru.erase(itr);
+		}
+		return victims;
+	}
+
+	void TileCache::writeBack(utl::vector<Victim> victims) {
+		if (victims.empty()) {
+			return;
+		}
+		utl::vector<bool> written(victims.size());
+		for (std::size_t i = 0; i < victims.size(); ++i) {
+			written[i] = victims[i].image->writeBack(victims[i].tileIndex, victims[i].data.data());
+		}
+		{
+			std::lock_guard lock(mutex);
+			for (std::size_t i = 0; i < victims.size(); ++i) {
+				auto& [image, tileIndex, data] = victims[i];
+				auto& tile = image->tiles[tileIndex];
+				tile.busy = false;
+				if (written[i]) {
+					tile.dirty = false;
+					tile.onDisk = true;
+					continue;
+				}
+				/// Rather go over budget than lose the tile. Least recently used
+				/// again, so it is the first to be retried.
+				_residentBytes += data.size() * sizeof(float);
+				tile.data = std::move(data);
+				tile.resident = true;
+				tile.lruPosition = lru.insert(lru.begin(), { image, tileIndex });
+			}
+		}
+		tileIdle.notify_all();
+	}
+
+	/// MARK: - TiledImage
+	static std::filesystem::path makeTileFilePath() {
+		static std::mt19937_64 rng(std::random_device{}());
+		static std::mutex mutex;
+		std::lock_guard lock(mutex);
+		return std::filesystem::temp_directory_path() / ("worldmachine-" + std::to_string(rng()) + ".tiles");
+	}
+
+	TiledImage::TiledImage(DataType dataType, mtl::usize2 size, std::size_t tileSize):
+		_dataType(dataType),
+		_size(size),
+		_tileSize(tileSize),
+		_tileCount((size + tileSize - 1) / tileSize),
+		path(makeTileFilePath())
+	{
+		WM_Expect(tileSize > 0);
+		/// Opening for reading fails unless the file exists.
+		file.open(path, std::ios::out | std::ios::binary | std::ios::trunc);
+		file.close();
+		file.open(path, std::ios::in | std::ios::out | std::ios::binary);
+		if (!file) {
+			WM_Log(error, "Failed to create tile file '{}'", path.string());
+		}
+		tiles.resize(_tileCount.fold(utl::multiplies));
+	}
+
+	TiledImage::~TiledImage() {
+		{
+			auto& cache = TileCache::instance();
+			std::unique_lock lock(cache.mutex);
+			/// Tiles evicted by other threads may still be on their way to the file.
+			cache.tileIdle.wait(lock, [&]{
+				return std::none_of(tiles.begin(), tiles.end(), [](Tile const& tile) { return tile.busy; });
+			});
+			for (auto& tile: tiles) {
+				WM_Assert(tile.pins == 0);
+				if (tile.resident) {
+					cache._residentBytes -= tile.data.size() * sizeof(float);
+					cache.lru.erase(tile.lruPosition);
+				}
+			}
+		}
+		file.close();
+		std::error_code ec;
+		std::filesystem::remove(path, ec);
+	}
+
+	void TiledImage::copyFrom(Image const& image) {
+		WM_Expect(image.dataType() == _dataType && image.size() == _size);
+		copyTiles(reinterpret_cast<std::byte*>(const_cast<float*>(image.data())), true);
+	}
+
+	void TiledImage::copyTo(Image& image) {
+		WM_Expect(image.dataType() == _dataType && image.size() == _size);
+		copyTiles(reinterpret_cast<std::byte*>(image.data()), false);
+	}
+
+	/// Works on bytes rather than through withTile() so any data type can be copied,
+	/// also those of less than a float per pixel.
+	void TiledImage::copyTiles(std::byte* image, bool toTiles) {
+		std::size_t const pixelBytes = dataTypeSize(_dataType);
+		for (std::size_t y = 0; y < _tileCount.y; ++y) {
+			for (std::size_t x = 0; x < _tileCount.x; ++x) {
+				std::size_t const tileIndex = y * _tileCount.x + x;
+				mtl::usize2 const origin = mtl::usize2(x, y) * _tileSize;
+				mtl::usize2 const extent = tileExtent({ x, y });
+				auto* const tile = reinterpret_cast<std::byte*>(pin(tileIndex, toTiles));
+				for (std::size_t j = 0; j < extent.y; ++j) {
+					std::byte* const tileRow = tile + j * _tileSize * pixelBytes;
+					std::byte* const imageRow = image + ((origin.y + j) * _size.x + origin.x) * pixelBytes;
+					std::size_t const bytes = extent.x * pixelBytes;
+					if (toTiles) {
+						std::memcpy(tileRow, imageRow, bytes);
+					}
+					else {
+						std::memcpy(imageRow, tileRow, bytes);
+					}
+				}
+				unpin(tileIndex);
+			}
+		}
+	}
+
+	mtl::usize2 TiledImage::tileExtent(mtl::usize2 index) const {
+		mtl::usize2 const origin = index * _tileSize;
+		return { std::min(_tileSize, _size.x - origin.x), std::min(_tileSize, _size.y - origin.y) };
+	}
+
+	float* TiledImage::pin(std::size_t tileIndex, bool write) {
+		auto& cache = TileCache::instance();
+		std::unique_lock lock(cache.mutex);
+		auto& tile = tiles[tileIndex];
+		cache.tileIdle.wait(lock, [&]{ return !tile.busy; });
+		++tile.pins;
+		if (tile.resident) {
+			cache.lru.splice(cache.lru.end(), cache.lru, tile.lruPosition);
+		}
+		else {
+			/// Pinned and busy, so nobody else touches the tile while we read it.
+			tile.busy = true;
+			bool const onDisk = tile.onDisk;
+			lock.unlock();
+			utl::vector<float> data(tileFloats());
+			if (onDisk) {
+				readBack(tileIndex, data.data());
+			}
+			lock.lock();
+			tile.data = std::move(data);
+			tile.busy = false;
+			tile.resident = true;
+			tile.lruPosition = cache.lru.insert(cache.lru.end(), { this, tileIndex });
+			cache._residentBytes += tile.data.size() * sizeof(float);
+			cache.tileIdle.notify_all();
+		}
+		tile.dirty |= write;
+		/// Stays valid while pinned
+		float* const result = tile.data.data();
+		auto victims = cache.evict();
+		lock.unlock();
+		cache.writeBack(std::move(victims));
+		return result;
+	}
+
+	void TiledImage::unpin(std::size_t tileIndex) {
+		auto& cache = TileCache::instance();
+		std::unique_lock lock(cache.mutex);
+		auto& tile = tiles[tileIndex];
+		WM_Assert(tile.pins > 0);
+		--tile.pins;
+		auto victims = cache.evict();
+		lock.unlock();
+		cache.writeBack(std::move(victims));
+	}
+
+	bool TiledImage::writeBack(std::size_t tileIndex, float const* data) {
+		std::size_t const bytes = tileFloats() * sizeof(float);
+		std::lock_guard lock(fileMutex);
+		file.seekp(std::streamoff(tileIndex * bytes));
+		file.write(reinterpret_cast<char const*>(data), std::streamsize(bytes));
+		file.flush();
+		if (!file) {
+			WM_Log(error, "Failed to write tile {} to '{}'", tileIndex, path.string());
+			file.clear();
+			return false;
+		}
+		return true;
+	}
+
+	void TiledImage::readBack(std::size_t tileIndex, float* data) {
+		std::size_t const bytes = tileFloats() * sizeof(float);
+		std::lock_guard lock(fileMutex);
+		file.seekg(std::streamoff(tileIndex * bytes));
+		file.read(reinterpret_cast<char*>(data), std::streamsize(bytes));
+		if (!file) {
+			/// Leave the zeroed tile
+			WM_Log(error, "Failed to read tile {} from '{}'", tileIndex, path.string());
+			file.clear();
+			std::fill(data, data + tileFloats(), 0.0f);
+		}
+	}
+
+}
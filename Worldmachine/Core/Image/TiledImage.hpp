@@ -0,0 +1,149 @@
+#pragma once
+
+#include <mutex>
+#include <condition_variable>
+#include <list>
+#include <cstddef>
+#include <fstream>
+#include <filesystem>
+#include <type_traits>
+#include <utl/vector.hpp>
+#include <mtl/mtl.hpp>
+
+#include "Image.hpp"
+
+namespace worldmachine {
+
+	class TiledImage;
+
+	/// Resident tiles of all tiled images. Once over budget, the least recently
+	/// used tiles that nobody has pinned are written back to the file of their
+	/// image and dropped from memory. Files are read and written without holding
+	/// the cache mutex, only threads that need the same tile wait for it.
+	class TileCache {
+		friend class TiledImage;
+
+	public:
+		static TileCache& instance();
+
+		/// In bytes. Pinned tiles stay resident even if this is exceeded.
+		std::size_t budget() const;
+		void setBudget(std::size_t bytes);
+
+		std::size_t residentBytes() const;
+
+	private:
+		using Entry = std::pair<TiledImage*, std::size_t>;
+
+		/// Dirty tile taken out of the cache, to be written to its file
+		struct Victim {
+			TiledImage* image;
+			std::size_t tileIndex;
+			utl::vector<float> data;
+		};
+
+		/// Requires 'mutex'. Drops clean tiles right away and returns the dirty
+		/// ones, which stay busy until writeBack() is done with them.
+		[[nodiscard]] utl::vector<Victim> evict();
+		/// Without 'mutex'
+		void writeBack(utl::vector<Victim> victims);
+
+	private:
+		mutable std::mutex mutex;
+		/// Notified whenever a tile stops being busy
+		std::condition_variable tileIdle;
+		std::size_t _budget = std::size_t(1) << 30;
+		std::size_t _residentBytes = 0;
+		/// Least recently used first
+		std::list<Entry> lru;
+	};
+
+	/// Image of any size, split into square tiles which live in a temporary file
+	/// and are paged in through the TileCache on access. Only as much of the image
+	/// as the cache budget allows is held in memory at any time.
+	class TiledImage {
+		friend class TileCache;
+
+	public:
+		static constexpr std::size_t defaultTileSize = 256;
+
+	public:
+		TiledImage(DataType, mtl::usize2 size, std::size_t tileSize = defaultTileSize);
+		~TiledImage();
+
+		TiledImage(TiledImage const&) = delete;
+		TiledImage& operator=(TiledImage const&) = delete;
+
+		DataType dataType() const { return _dataType; }
+		mtl::usize2 size() const { return _size; }
+		std::size_t tileSize() const { return _tileSize; }
+		/// Number of tiles in each dimension
+		mtl::usize2 tileCount() const { return _tileCount; }
+
+		/// Pins tile 'index', calls 'f' with it and unpins it again. Tiles accessed with
+		/// a non const value type are written back to the file before they are evicted.
+		/// Different tiles may be accessed from different threads at the same time.
+		template <typename VT>
+		void withTile(mtl::usize2 index, utl::invocable<ImageTile<VT>> auto&& f) {
+			WM_Assert(sizeof(VT) == dataTypeSize(_dataType));
+			WM_BoundsCheck(index.x, 0, _tileCount.x);
+			WM_BoundsCheck(index.y, 0, _tileCount.y);
+			std::size_t const tileIndex = index.y * _tileCount.x + index.x;
+			float* const data = pin(tileIndex, !std::is_const_v<VT>);
+			struct Unpin {
+				TiledImage* self;
+				std::size_t tileIndex;
+				~Unpin() { self->unpin(tileIndex); }
+			} const unpinGuard{ this, tileIndex };
+			f(ImageTile<VT>(reinterpret_cast<VT*>(data), index * _tileSize, tileExtent(index), _tileSize));
+		}
+
+		/// Calls 'f' with every tile, row by row. At most one tile is pinned at a time.
+		template <typename VT>
+		void forEachTile(utl::invocable<ImageTile<VT>> auto&& f) {
+			for (std::size_t y = 0; y < _tileCount.y; ++y) {
+				for (std::size_t x = 0; x < _tileCount.x; ++x) {
+					withTile<VT>({ x, y }, f);
+				}
+			}
+		}
+
+		/// 'image' must have the same data type and size.
+		void copyFrom(Image const& image);
+		void copyTo(Image& image);
+
+	private:
+		struct Tile {
+			utl::vector<float> data;
+			std::list<TileCache::Entry>::iterator lruPosition;
+			std::size_t pins = 0;
+			bool resident = false;
+			bool dirty = false;
+			bool onDisk = false;
+			/// Being read from or written to the file
+			bool busy = false;
+		};
+
+		float* pin(std::size_t tileIndex, bool write);
+		void unpin(std::size_t tileIndex);
+		void copyTiles(std::byte* image, bool toTiles);
+		/// Without the cache mutex, file access is serialized by 'fileMutex'.
+		bool writeBack(std::size_t tileIndex, float const* data);
+		void readBack(std::size_t tileIndex, float* data);
+
+		/// Every tile is stored at full size, also the ones on the right and bottom edges.
+		std::size_t tileFloats() const { return Image::storageSize(_dataType, _tileSize); }
+		mtl::usize2 tileExtent(mtl::usize2 index) const;
+
+	private:
+		DataType _dataType;
+		mtl::usize2 _size;
+		std::size_t _tileSize;
+		mtl::usize2 _tileCount;
+		std::filesystem::path path;
+		std::mutex fileMutex;
+		std::fstream file;
+		utl::vector<Tile> tiles;
+	};
+
+}
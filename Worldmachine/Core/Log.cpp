@@ -0,0 +1,222 @@
+#include "Log.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <csignal>
+#include <cstdio>
+#include <ctime>
+#include <iterator>
+#include <utl/format.hpp>
+
+#include "Core/BoundedQueue.hpp"
+
+namespace worldmachine {
+
+	std::string_view logCategoryName(LogCategory category) {
+		switch (category) {
+			case LogCategory::general:   return "Worldmachine";
+			case LogCategory::scheduler: return "Scheduler";
+			case LogCategory::kernel:    return "Kernel";
+		}
+		return "";
+	}
+
+	static std::string_view levelName(utl::log_level level) {
+		switch (level) {
+			case utl::log_level::trace:   return "trace";
+			case utl::log_level::debug:   return "debug";
+			case utl::log_level::info:    return "info";
+			case utl::log_level::warning: return "warning";
+			case utl::log_level::error:   return "error";
+			case utl::log_level::fatal:   return "fatal";
+			default:                      return "log";
+		}
+	}
+
+	std::string formatLogTime(std::chrono::system_clock::time_point time) {
+		std::time_t const seconds = std::chrono::system_clock::to_time_t(time);
+		auto const millis = std::chrono::duration_cast<std::chrono::milliseconds>(time.time_since_epoch()).count() % 1000;
+		std::tm local{};
+#if defined(WM_PLATFORM_WINDOWS)
+		localtime_s(&local, &seconds);
+#else
+		localtime_r(&seconds, &local);
+#endif
+		char buffer[16];
+		std::snprintf(buffer, sizeof(buffer), "%02d:%02d:%02d.%03d",
+					  local.tm_hour, local.tm_min, local.tm_sec, (int)millis);
+		return buffer;
+	}
+
+	/// Set once the log thread is gone, later records are printed right away.
+	/// Constant initialized, so still valid during static destruction.
+	static std::atomic_bool logShutDown = false;
+
+	static void print(LogRecord const& record, std::string& buffer) {
+		buffer += utl::format("[{}] [{}] [{}] {}\n", formatLogTime(record.time),
+							  logCategoryName(record.category), levelName(record.level), record.message);
+	}
+
+	namespace {
+
+		/// Drains the queue on its own thread, so logging threads never wait for
+		/// stdout or for the UI reading globalLog().
+		class LogThread {
+		public:
+			static LogThread& instance() {
+				static LogThread logThread;
+				return logThread;
+			}
+
+			LogThread(): thread([this]{ run(); }) {
+				installCrashHandlers();
+			}
+
+			~LogThread() {
+				stop = true;
+				thread.join();
+				logShutDown = true;
+			}
+
+			void post(LogRecord&& record) {
+				if (!queue.tryPush(std::move(record))) {
+					dropped.fetch_add(1, std::memory_order_relaxed);
+				}
+			}
+
+			/// Returns early if the log thread does not catch up within 'timeout'.
+			void flush(std::chrono::steady_clock::duration timeout = std::chrono::steady_clock::duration::max()) {
+				if (std::this_thread::get_id() == thread.get_id()) {
+					/// Would wait for ourselves
+					return;
+				}
+				auto const start = std::chrono::steady_clock::now();
+				std::size_t const target = queue.pushed();
+				while (drained.load(std::memory_order_acquire) < target) {
+					if (std::chrono::steady_clock::now() - start > timeout) {
+						return;
+					}
+					std::this_thread::yield();
+				}
+			}
+
+			std::pair<std::unique_lock<std::mutex>, utl::vector<LogRecord>&> records() {
+				return { std::unique_lock(recordsMutex), _records };
+			}
+
+		private:
+			/// Failed assertions and fatal errors end in abort() or a trap. The records
+			/// queued before, usually the ones explaining the failure, are printed first.
+			/// Bounded, the log thread may be what crashed.
+			static void installCrashHandlers() {
+				for (int const signal: crashSignals) {
+					auto const previous = std::signal(signal, [](int signal) {
+						if (!logShutDown.load(std::memory_order_relaxed)) {
+							instance().flush(std::chrono::seconds(1));
+						}
+						std::signal(signal, previousHandlers[signalIndex(signal)]);
+						std::raise(signal);
+					});
+					previousHandlers[signalIndex(signal)] = previous == SIG_ERR ? SIG_DFL : previous;
+				}
+			}
+
+			static std::size_t signalIndex(int signal) {
+				return std::size_t(std::find(std::begin(crashSignals), std::end(crashSignals), signal) - std::begin(crashSignals));
+			}
+
+#if defined(SIGTRAP)
+			static constexpr int crashSignals[] = { SIGABRT, SIGTRAP };
+#else
+			static constexpr int crashSignals[] = { SIGABRT };
+#endif
+			static inline void (*previousHandlers[std::size(crashSignals)])(int) = {};
+
+			void run() {
+				while (!stop.load(std::memory_order_relaxed)) {
+					if (!drain()) {
+						std::this_thread::sleep_for(idleInterval);
+					}
+				}
+				while (drain()) {}
+			}
+
+			bool drain() {
+				batch.clear();
+				LogRecord record;
+				while (batch.size() < maxBatchSize && queue.tryPop(record)) {
+					batch.push_back(std::move(record));
+				}
+				std::size_t const popped = batch.size();
+				if (std::size_t const count = dropped.exchange(0, std::memory_order_relaxed)) {
+					batch.push_back({
+						.level = utl::log_level::warning,
+						.time = std::chrono::system_clock::now(),
+						.threadID = std::this_thread::get_id(),
+						.message = utl::format("Log queue full, dropped {} messages", count)
+					});
+				}
+				if (batch.empty()) {
+					return false;
+				}
+				text.clear();
+				for (auto const& r: batch) {
+					print(r, text);
+				}
+				std::fwrite(text.data(), 1, text.size(), stdout);
+				std::fflush(stdout);
+				{
+					std::lock_guard lock(recordsMutex);
+					for (auto& r: batch) {
+						_records.push_back(std::move(r));
+					}
+				}
+				drained.fetch_add(popped, std::memory_order_release);
+				return true;
+			}
+
+		private:
+			static constexpr std::size_t capacity = 1 << 13;
+			static constexpr std::size_t maxBatchSize = 256;
+			static constexpr std::chrono::milliseconds idleInterval{ 2 };
+
+			BoundedQueue<LogRecord> queue{ capacity };
+			std::atomic<std::size_t> dropped = 0;
+			std::atomic<std::size_t> drained = 0;
+			std::atomic_bool stop = false;
+			/// Only touched by the log thread
+			utl::vector<LogRecord> batch;
+			std::string text;
+			std::mutex recordsMutex;
+			utl::vector<LogRecord> _records;
+			std::thread thread;
+		};
+
+	}
+
+	void postLog(LogRecord record) {
+		if (logShutDown.load(std::memory_order_relaxed)) {
+			std::string text;
+			print(record, text);
+			std::fwrite(text.data(), 1, text.size(), stdout);
+			return;
+		}
+		bool const fatal = record.level == utl::log_level::fatal;
+		LogThread::instance().post(std::move(record));
+		if (fatal) {
+			/// The process is likely about to go down.
+			LogThread::instance().flush();
+		}
+	}
+
+	void flushLog() {
+		if (!logShutDown.load(std::memory_order_relaxed)) {
+			LogThread::instance().flush();
+		}
+	}
+
+	std::pair<std::unique_lock<std::mutex>, utl::vector<LogRecord>&> globalLog() {
+		return LogThread::instance().records();
+	}
+
+}
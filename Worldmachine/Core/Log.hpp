@@ -0,0 +1,80 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utl/log.hpp>
+#include <utl/vector.hpp>
+#include <utl/utility.hpp>
+
+#ifndef WM_LOGLEVEL
+#define WM_LOGLEVEL 0
+#endif
+
+/// Levels of the categories of WM_LogCategory(), 0 meaning warnings and errors
+/// only and 1 everything. Kernels log per pixel or per droplet, so they are
+/// quiet unless asked for.
+#ifndef WM_LOGLEVEL_SCHEDULER
+#define WM_LOGLEVEL_SCHEDULER WM_LOGLEVEL
+#endif
+#ifndef WM_LOGLEVEL_KERNEL
+#define WM_LOGLEVEL_KERNEL 0
+#endif
+
+namespace worldmachine {
+
+	enum class LogCategory {
+		general,
+		scheduler,
+		kernel
+	};
+
+	std::string_view logCategoryName(LogCategory);
+
+	constexpr utl::log_level levelMask(int level) {
+		return level == 0 ?
+			utl::log_level::warning | utl::log_level::error | utl::log_level::fatal :
+			utl::log_level::all;
+	}
+
+	constexpr utl::log_level categoryLevelMask(LogCategory category) {
+		switch (category) {
+			case LogCategory::general:   return levelMask(WM_LOGLEVEL);
+			case LogCategory::scheduler: return levelMask(WM_LOGLEVEL_SCHEDULER);
+			case LogCategory::kernel:    return levelMask(WM_LOGLEVEL_KERNEL);
+		}
+		return levelMask(WM_LOGLEVEL);
+	}
+
+	constexpr bool logEnabled(LogCategory category, utl::log_level level) {
+		return (utl::to_underlying(categoryLevelMask(category)) & utl::to_underlying(level)) != 0;
+	}
+
+	struct LogRecord {
+		LogCategory category = LogCategory::general;
+		utl::log_level level = utl::log_level::info;
+		std::chrono::system_clock::time_point time;
+		std::thread::id threadID;
+		std::string file;
+		std::string function;
+		std::uint32_t line = 0;
+		std::string message;
+	};
+
+	/// Queues 'record' for the log thread, which prints it and appends it to
+	/// globalLog(). Never blocks. If the queue is full the record is dropped and
+	/// counted, the log thread reports the number of dropped records later.
+	void postLog(LogRecord record);
+
+	/// Blocks until everything posted before the call is printed and in globalLog().
+	void flushLog();
+
+	/// Everything logged so far, in the order the log thread received it.
+	std::pair<std::unique_lock<std::mutex>, utl::vector<LogRecord>&> globalLog();
+
+	std::string formatLogTime(std::chrono::system_clock::time_point);
+
+}
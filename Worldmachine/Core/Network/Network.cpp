@@ -45,9 +45,16 @@ namespace worldmachine {
 		nodes.push_back(elem);
 		
 		std::size_t const nodeIndex = nodes.size() - 1;
+		m_indexByID.insert({ nodeID, nodeIndex });
 		return nodeIndex;
 	}
 	
+	void NodeCollection::reindexNodes(std::size_t begin) {
+		for (std::size_t i = begin; i < nodes.size(); ++i) {
+			m_indexByID[nodes[i].id] = i;
+		}
+	}
+	
 	mtl::float2 NodeCollection::pinPosition(mtl::float2 nodePosition,
 											mtl::float2 nodeSize,
 											PinKind pinKind,
@@ -105,15 +112,55 @@ namespace worldmachine {
 	
 	/// MARK: - NetworkBase
 	long NetworkBase::indexFromID(utl::UUID id) const {
-		for (std::size_t i = 0;
-			 auto& targetID: nodes.view<Node::members::id>())
-		{
-			if (targetID == id) {
-				return i;
-			}
-			++i;
+		auto const itr = m_indexByID.find(id);
+		if (itr == m_indexByID.end()) {
+			return -1;
 		}
-		return -1;
+		WM_Expect(audit, nodes[itr->second].id == id, "ID index out of sync");
+		return (long)itr->second;
+	}
+	
+	/// Counting sort of the edges by their begin (or end) node, stable so
+	/// neighbours stay in edge order.
+	static void buildAdjacencyRows(std::size_t nodeCount,
+								   EdgeCollection const& collection,
+								   bool upstream,
+								   utl::vector<std::uint32_t>& offsets,
+								   utl::vector<std::uint32_t>& indices)
+	{
+		auto const edges = collection.edges.view<Edge::members::beginNodeIndex, Edge::members::endNodeIndex>();
+		offsets.assign(nodeCount + 1, 0);
+		for (auto [begin, end]: edges) {
+			++offsets[(upstream ? end : begin) + 1];
+		}
+		for (std::size_t i = 0; i < nodeCount; ++i) {
+			offsets[i + 1] += offsets[i];
+		}
+		indices.resize(collection.edgeCount());
+		utl::small_vector<std::uint32_t, 64> next(offsets.begin(), offsets.end() - 1);
+		for (auto [begin, end]: edges) {
+			indices[next[upstream ? end : begin]++] = utl::narrow_cast<std::uint32_t>(upstream ? begin : end);
+		}
+	}
+	
+	NetworkAdjacency const& NetworkBase::adjacency() const {
+		/// Also compare sizes, tests append to 'edges' directly.
+		auto const isCurrent = [this]{
+			return _adjacencyValid &&
+				_adjacency.downstreamOffsets.size() == nodeCount() + 1 &&
+				_adjacency.downstreamIndices.size() == edgeCount();
+		};
+		if (isCurrent()) {
+			return _adjacency;
+		}
+		std::lock_guard lock(_adjacencyMutex);
+		if (isCurrent()) {
+			return _adjacency;
+		}
+		buildAdjacencyRows(nodeCount(), *this, false, _adjacency.downstreamOffsets, _adjacency.downstreamIndices);
+		buildAdjacencyRows(nodeCount(), *this, true, _adjacency.upstreamOffsets, _adjacency.upstreamIndices);
+		_adjacencyValid = true;
+		return _adjacency;
 	}
 	
 	utl::UUID NetworkBase::IDFromIndex(std::size_t nodeIndex) const {
@@ -334,7 +381,8 @@ namespace worldmachine {
 		
 		
 		WM_Assert(std::popcount(utl::to_underlying(dataTypeX)) < 2, "More than one data type flag is set in output");
-		if (!(dataTypeX & dataTypeY)) {
+		/// Compact outputs are read as float1
+		if (!(dataTypeX & dataTypeY) && !(decodedDataType(dataTypeX) & dataTypeY)) {
 			throw std::runtime_error(utl::format("Incompatible data types \"{}\" and \"{}\".",
 												 dataTypeX, dataTypeY));
 		}
@@ -348,7 +396,7 @@ namespace worldmachine {
 		std::optional<Edge> removedEdge;
 		if (edgeToRemove) {
 			removedEdge = edges[*edgeToRemove];
-			edges.erase(*edgeToRemove);
+			eraseEdge(*edgeToRemove);
 		}
 		
 		edges.push_back({
@@ -360,12 +408,14 @@ namespace worldmachine {
 			.endPinKind     = to.pinKind,
 			.proxy          = makeEdgeProxy(from, to)
 		});
+		registerEdge(edgeCount() - 1);
 		
 		if (hasCycles(this, to.nodeIndex)) {
-			edges.pop_back();
+			eraseEdge(edgeCount() - 1);
 			if (removedEdge) {
 				/// If we removed an Edge to make room for this one then restore it
 				edges.push_back(*removedEdge);
+				registerEdge(edgeCount() - 1);
 			}
 			throw NetworkCycleError("Edge would introduce a cycle.");
 		}
@@ -390,10 +440,46 @@ namespace worldmachine {
 	void Network::removeEdge(std::size_t edgeIndex) {
 		WM_BoundsCheck(edgeIndex, 0, edgeCount());
 		std::size_t const nodeIndex = edges[edgeIndex].endNodeIndex;
-		edges.erase(edgeIndex);
+		eraseEdge(edgeIndex);
 		invalidateNodesDownstream(nodeIndex);
 	}
 	
+	void Network::registerEdge(std::size_t edgeIndex) {
+		auto const index = utl::narrow_cast<std::uint32_t>(edgeIndex);
+		nodes[edges[edgeIndex].beginNodeIndex].edgeIndices.outgoing.push_back(index);
+		nodes[edges[edgeIndex].endNodeIndex].edgeIndices.incoming.push_back(index);
+		invalidateAdjacency();
+	}
+	
+	void Network::eraseEdge(std::size_t edgeIndex) {
+		WM_BoundsCheck(edgeIndex, 0, edgeCount());
+		auto const index = utl::narrow_cast<std::uint32_t>(edgeIndex);
+		auto eraseIndex = [&](auto& list) {
+			list.erase(std::find(list.begin(), list.end(), index));
+		};
+		eraseIndex(nodes[edges[edgeIndex].beginNodeIndex].edgeIndices.outgoing);
+		eraseIndex(nodes[edges[edgeIndex].endNodeIndex].edgeIndices.incoming);
+		edges.erase(edgeIndex);
+		/// Later edges move down by one
+		if (edgeIndex != edgeCount()) {
+			for (auto& edgeIndices: nodes.view<Node::members::edgeIndices>()) {
+				for (auto& i: edgeIndices.incoming) { i -= i > index; }
+				for (auto& i: edgeIndices.outgoing) { i -= i > index; }
+			}
+		}
+		invalidateAdjacency();
+	}
+	
+	void Network::rebuildEdgeIndices() {
+		for (auto& edgeIndices: nodes.view<Node::members::edgeIndices>()) {
+			edgeIndices.incoming.clear();
+			edgeIndices.outgoing.clear();
+		}
+		for (std::size_t edgeIndex = 0; edgeIndex < edgeCount(); ++edgeIndex) {
+			registerEdge(edgeIndex);
+		}
+	}
+	
 	void Network::removeSelectedNodes() {
 		auto const selectedIDs = IDsFromIndices(Selection::indices);
 		
@@ -412,7 +498,9 @@ namespace worldmachine {
 	
 	void Network::removeNode(std::size_t nodeIndex) {
 		WM_BoundsCheck(nodeIndex, 0, nodeCount());
+		m_indexByID.erase(nodes[nodeIndex].id);
 		nodes.erase(nodeIndex);
+		reindexNodes(nodeIndex);
 		utl::small_vector<std::uint32_t, 24> edgesToRemove;
 		
 		for (std::size_t edgeIndex = 0; auto edge: edges) {
@@ -432,6 +520,7 @@ namespace worldmachine {
 			edges.erase(edgeIndex - i);
 			++i;
 		}
+		rebuildEdgeIndices();
 		
 		// adjust z position
 //		for (std::size_t i = nodeIndex; i < nodes.size(); ++i) {
@@ -581,23 +670,28 @@ namespace worldmachine {
 	}
 	
 	std::optional<std::size_t> Network::edgeInPin(PinIndex const& desc) const {
-		for (std::size_t edgeIndex = 0; auto edge: edges) {
-			if (edge.endNodeIndex == desc.nodeIndex &&
-				edge.endPinIndex  == desc.pinIndex &&
-				edge.endPinKind   == desc.pinKind)
+		for (std::uint32_t const edgeIndex: nodes[desc.nodeIndex].edgeIndices.incoming) {
+			if (edges[edgeIndex].endPinIndex == desc.pinIndex &&
+				edges[edgeIndex].endPinKind  == desc.pinKind)
 			{
 				return edgeIndex;
 			}
-			++edgeIndex;
 		}
 		return std::nullopt;
 	}
 	
 	/// MARK: - Traversal and queries	
 	void Network::invalidateAllNodes(BuildType type) {
-		auto const roots = gatherRootNodes();
-		for (auto& r: roots) {
-			invalidateNodesDownstream(r, type);
+		/// Every node is downstream of itself, no need to traverse from the roots.
+		for (std::size_t nodeIndex = 0; nodeIndex < nodeCount(); ++nodeIndex) {
+			if (test(type & BuildType::highResolution)) {
+				nodes[nodeIndex].flags &= ~NodeFlags::built;
+				nodes[nodeIndex].implementation->_built = false;
+			}
+			if (test(type & BuildType::preview)) {
+				nodes[nodeIndex].flags &= ~NodeFlags::previewBuilt;
+				nodes[nodeIndex].implementation->_previewBuilt = false;
+			}
 		}
 	}
 	
@@ -620,39 +714,25 @@ namespace worldmachine {
 		invalidateNodesDownstream(indexFromID(nodeID), type);
 	}
 	
-	utl::small_vector<std::size_t> Network::gatherLeafNodes() {
-		auto condition = [this](auto nodeIndex) {
-			for (auto beginNodeIndex: edges.view<Edge::members::beginNodeIndex>()) {
-				if (nodeIndex == beginNodeIndex) {
-					/* if any edge comes from nodes[nodeIndex] then we are not a leaf */
-					return false;
-				}
-			}
-			return true;
-		};
-		return gatherNodesImpl(condition);
+	utl::small_vector<std::size_t> Network::gatherLeafNodes() const {
+		return gatherNodesImpl([](NodeEdgeIndices const& edgeIndices) {
+			return edgeIndices.outgoing.empty();
+		});
 	}
 	
-	utl::small_vector<std::size_t> Network::gatherRootNodes() {
-		auto condition = [this](auto nodeIndex) {
-			for (auto endNodeIndex: edges.view<Edge::members::endNodeIndex>()) {
-				if (nodeIndex == endNodeIndex) {
-					/* if any edge ends in nodes[nodeIndex] then we are not a root */
-					return false;
-				}
-			}
-			return true;
-		};
-		
-		return gatherNodesImpl(condition);
+	utl::small_vector<std::size_t> Network::gatherRootNodes() const {
+		return gatherNodesImpl([](NodeEdgeIndices const& edgeIndices) {
+			return edgeIndices.incoming.empty();
+		});
 	}
 	
-	utl::small_vector<std::size_t> Network::gatherNodesImpl(auto&& cond) {
+	utl::small_vector<std::size_t> Network::gatherNodesImpl(auto&& cond) const {
 		utl::small_vector<std::size_t> result;
-		for (std::size_t nodeIndex: utl::iota<std::size_t>(0, nodes.size())) {
-			if (cond(nodeIndex)) {
+		for (std::size_t nodeIndex = 0; auto const& edgeIndices: nodes.view<Node::members::edgeIndices>()) {
+			if (cond(edgeIndices)) {
 				result.push_back(nodeIndex);
 			}
+			++nodeIndex;
 		}
 		return result;
 	}
@@ -682,10 +762,8 @@ namespace worldmachine {
 			else { WM_DebugBreak(); }
 		};
 		
-		for (auto edge: edges) {
-			if (edge.endNodeIndex != nodeIndex) {
-				continue;
-			}
+		for (std::uint32_t const edgeIndex: nodes[nodeIndex].edgeIndices.incoming) {
+			auto const edge = edges[edgeIndex];
 			if (edge.endPinKind != PinKind::input && edge.endPinKind != PinKind::maskInput) {
 				continue;
 			}
@@ -704,7 +782,7 @@ namespace worldmachine {
 	}
 	
 	bool Network::allMandatoryUpstreamNodesConnected(std::size_t nodeIndex) const {
-		for (std::size_t const upstreamIndex: utl::reverse(NetworkTraversalView(this, nodeIndex))) {
+		for (std::size_t const upstreamIndex: utl::reverse(NetworkTraversalView(this, nodeIndex).unique())) {
 			auto const nodeEdges = collectNodeEdges(upstreamIndex);
 			if (!nodeEdges.dependenciesConnected()) {
 				return false;
@@ -8,6 +8,7 @@
 #include <utl/structure_of_arrays.hpp>
 #include <utl/functional.hpp>
 #include <utl/vector.hpp>
+#include <utl/hashmap.hpp>
 #include <utl/concepts.hpp>
 #include <utl/UUID.hpp>
 #include <utl/messenger.hpp>
@@ -80,6 +81,12 @@ namespace worldmachine {
 		
 		NodeContainerType nodes;
 		
+	protected:
+		/// Updates 'm_indexByID' for all nodes from 'begin' on, after nodes have been erased.
+		void reindexNodes(std::size_t begin);
+		
+		utl::hashmap<utl::UUID, std::size_t> m_indexByID;
+		
 	private:
 		NodeParameters m_nodeParams = defaultNodeParameters();
 	};
@@ -134,6 +141,14 @@ namespace worldmachine {
 		utl::small_vector<std::size_t, 16> candidates;
 	};
 	
+	/// MARK: - NetworkAdjacency
+	/// Neighbours of every node in compressed sparse rows: the neighbours of node
+	/// 'i' are 'indices[offsets[i]]' up to 'indices[offsets[i + 1]]', in edge order.
+	struct NetworkAdjacency {
+		utl::vector<std::uint32_t> downstreamOffsets, downstreamIndices;
+		utl::vector<std::uint32_t> upstreamOffsets, upstreamIndices;
+	};
+	
 	/// MARK: - NetworkBase
 	class NetworkBase:
 		public NodeCollection,
@@ -148,7 +163,7 @@ namespace worldmachine {
 		
 		using SelectionManager::isSelected;
 		
-		void clear() { nodes.clear(); edges.clear(); }
+		void clear() { nodes.clear(); edges.clear(); m_indexByID.clear(); invalidateAdjacency(); }
 		
 		long indexFromID(utl::UUID id) const;
 		utl::UUID IDFromIndex(std::size_t nodeIndex) const;
@@ -157,6 +172,9 @@ namespace worldmachine {
 	
 		std::span<std::size_t const> selectedIndices() const { return this->SelectionManager::indices; }
 		
+		/// Rebuilt on first use after the edges have changed
+		NetworkAdjacency const& adjacency() const;
+		
 		[[nodiscard]] std::unique_lock<std::mutex> lock() {
 			return std::unique_lock(_mutex);
 		}
@@ -185,6 +203,9 @@ namespace worldmachine {
 			nodes[nodeIndex].flags ^= flag;
 		}
 		
+		/// To be called whenever 'edges' or the number of nodes change
+		void invalidateAdjacency() { _adjacencyValid = false; }
+		
 		using Nodes     = NodeCollection;
 		using Edges     = EdgeCollection;
 		using Selection = SelectionManager;
@@ -196,6 +217,11 @@ namespace worldmachine {
 		
 		utl::vector<std::pair<ImplementationID, std::string>> _storedImplementationState;
 		utl::listener_id_bag _listenerIDs;
+		
+	private:
+		mutable NetworkAdjacency _adjacency;
+		mutable std::mutex _adjacencyMutex;
+		mutable std::atomic_bool _adjacencyValid = false;
 	};
 	
 	/// MARK: - HitResult
@@ -300,8 +326,8 @@ namespace worldmachine {
 		void moveSelected(mtl::float2 offset);
 		
 		/// Queries
-		utl::small_vector<std::size_t>  gatherLeafNodes();
-		utl::small_vector<std::size_t>  gatherRootNodes();
+		utl::small_vector<std::size_t>  gatherLeafNodes() const;
+		utl::small_vector<std::size_t>  gatherRootNodes() const;
 		bool allMandatoryUpstreamNodesConnected(utl::UUID nodeID) const;
 		bool allMandatoryUpstreamNodesConnected(std::size_t nodeIndex) const;
 		
@@ -323,7 +349,12 @@ namespace worldmachine {
 		
 		std::optional<std::size_t> edgeInPin(PinIndex const&) const;
 		
-		utl::small_vector<std::size_t> gatherNodesImpl(auto&& cond);
+		/// Maintain NodeEdgeIndices of the endpoints. 'eraseEdge' also removes the edge.
+		void registerEdge(std::size_t edgeIndex);
+		void eraseEdge(std::size_t edgeIndex);
+		void rebuildEdgeIndices();
+		
+		utl::small_vector<std::size_t> gatherNodesImpl(auto&& cond) const;
 		
 		template <bool Reverse>
 		static void _traverseUpstreamNodesStartImpl(auto* _this, std::size_t nodeIndex, utl::invocable<std::size_t> auto&& f);
@@ -0,0 +1,486 @@
+#include <fstream>
+#include <sstream>
+#include <optional>
+#include <cstring>
+#include <cstdint>
+#include <stdexcept>
+#include <utl/vector.hpp>
+#include <utl/hashmap.hpp>
+
+#include "Core/Debug.hpp"
+#include "Core/Registry.hpp"
+#include "NetworkSerialize.hpp"
+#include "Network.hpp"
+#include "NodeImplementation.hpp"
+#include "NodeSerializer.hpp"
+
+/// Binary document layout, all values in native (little) endian:
+///
+///     Header: char magic[8], u32 version, u32 chunk count
+///     Chunk:  u32 tag, u32 reserved, u64 payload size, payload
+///
+/// Readers skip chunks with unknown tags, so new chunks can be added without
+/// bumping the version. Image data lives in the last chunk, every image aligned
+/// to 'imageAlignment' from the start of the file, so a reader can seek to an
+/// image without touching the others.
+///
+/// Version 1 sized multi-channel images by the numeric value of their data type
+/// rather than by their channel count. Such images are padded and the padding
+/// is skipped on load.
+
+namespace worldmachine {
+
+	static constexpr char binaryMagic[8] = { 'W', 'M', 'N', 'E', 'T', 'B', 'I', 'N' };
+	static constexpr std::uint32_t binaryVersion = 2;
+	static constexpr std::size_t imageAlignment = 64;
+
+	static constexpr std::uint32_t fourCC(char const (&tag)[5]) {
+		return std::uint32_t(tag[0]) | std::uint32_t(tag[1]) << 8 | std::uint32_t(tag[2]) << 16 | std::uint32_t(tag[3]) << 24;
+	}
+
+	static constexpr std::uint32_t infoChunk = fourCC("INFO");
+	static constexpr std::uint32_t nodeChunk = fourCC("NODE");
+	static constexpr std::uint32_t edgeChunk = fourCC("EDGE");
+	static constexpr std::uint32_t imageTableChunk = fourCC("IMGT");
+	static constexpr std::uint32_t imageDataChunk = fourCC("IMGD");
+
+	static constexpr std::size_t headerSize = sizeof(binaryMagic) + 2 * sizeof(std::uint32_t);
+	static constexpr std::size_t chunkHeaderSize = 2 * sizeof(std::uint32_t) + sizeof(std::uint64_t);
+
+	namespace {
+
+		struct ImageTableEntry {
+			std::uint64_t nodeIndex;
+			std::uint32_t buildType;
+			std::uint32_t outputIndex;
+			std::uint32_t dataType;
+			std::uint32_t reserved;
+			std::uint64_t width, height;
+			std::uint64_t offset;
+			std::uint64_t byteSize;
+		};
+
+		class Writer {
+		public:
+			template <typename T>
+			void put(T const& value) {
+				static_assert(std::is_trivially_copyable_v<T>);
+				buffer.append(reinterpret_cast<char const*>(&value), sizeof(T));
+			}
+			void putString(std::string_view str) {
+				put(std::uint64_t(str.size()));
+				buffer.append(str);
+			}
+
+			std::string buffer;
+		};
+
+		class Reader {
+		public:
+			explicit Reader(std::string_view data): data(data) {}
+
+			template <typename T>
+			T get() {
+				static_assert(std::is_trivially_copyable_v<T>);
+				T value;
+				std::memcpy(&value, take(sizeof(T)).data(), sizeof(T));
+				return value;
+			}
+			std::string_view getString() {
+				return take(get<std::uint64_t>());
+			}
+
+		private:
+			std::string_view take(std::size_t size) {
+				if (size > data.size()) {
+					throw std::runtime_error("File corrupted.");
+				}
+				auto const result = data.substr(0, size);
+				data.remove_prefix(size);
+				return result;
+			}
+
+		private:
+			std::string_view data;
+		};
+
+		struct EmbeddedImage {
+			Image const* image;
+			ImageTableEntry entry;
+		};
+
+	}
+
+	static std::size_t alignUp(std::size_t value, std::size_t alignment) {
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	static void writeChunkHeader(std::ostream& out, std::uint32_t tag, std::uint64_t size) {
+		std::uint32_t const reserved = 0;
+		out.write(reinterpret_cast<char const*>(&tag), sizeof(tag));
+		out.write(reinterpret_cast<char const*>(&reserved), sizeof(reserved));
+		out.write(reinterpret_cast<char const*>(&size), sizeof(size));
+	}
+
+	static void writeChunk(std::ostream& out, std::uint32_t tag, std::string_view payload) {
+		writeChunkHeader(out, tag, payload.size());
+		out.write(payload.data(), std::streamsize(payload.size()));
+	}
+
+	static std::string serializeInfo(NetworkFileInfo const& info) {
+		Writer writer;
+		auto const resolution = info.resolution.value_or(mtl::usize2(0));
+		auto const previewResolution = info.previewResolution.value_or(mtl::usize2(0));
+		writer.put(std::uint64_t(resolution.x));
+		writer.put(std::uint64_t(resolution.y));
+		writer.put(std::uint64_t(previewResolution.x));
+		writer.put(std::uint64_t(previewResolution.y));
+		return std::move(writer.buffer);
+	}
+
+	static std::string serializeNodes(Network const& network) {
+		Writer writer;
+		writer.put(std::uint64_t(network.nodeCount()));
+		for (auto node: network.nodes) {
+			writer.put(std::uint64_t(node.implementation->implementationID().value()));
+			writer.putString(node.name);
+			writer.put(node.position.x);
+			writer.put(node.position.y);
+			writer.put(node.position.z);
+			std::string parameters;
+			node.implementation->serializer().serializeBinary(parameters);
+			writer.putString(parameters);
+		}
+		return std::move(writer.buffer);
+	}
+
+	static std::string serializeEdges(Network const& network) {
+		Writer writer;
+		writer.put(std::uint64_t(network.edgeCount()));
+		for (auto edge: network.edges) {
+			writer.put(std::uint64_t(edge.beginNodeIndex));
+			writer.put(std::uint64_t(edge.endNodeIndex));
+			writer.put(std::uint64_t(edge.beginPinIndex));
+			writer.put(std::uint64_t(edge.endPinIndex));
+			writer.put(std::uint32_t(utl::to_underlying(edge.beginPinKind)));
+			writer.put(std::uint32_t(utl::to_underlying(edge.endPinKind)));
+		}
+		return std::move(writer.buffer);
+	}
+
+	/// Also resolves all lazily loaded outputs, they may refer to the file we are about to replace.
+	static utl::vector<EmbeddedImage> gatherImages(Network const& network, bool embed) {
+		utl::vector<EmbeddedImage> result;
+		for (std::size_t nodeIndex = 0; nodeIndex < network.nodeCount(); ++nodeIndex) {
+			auto const* impl = network.nodes[nodeIndex].implementation.get();
+			if (impl->type() != NodeType::image) {
+				continue;
+			}
+			auto const* imageNode = static_cast<ImageNodeImplementation const*>(impl);
+			std::size_t const outputCount = network.nodes[nodeIndex].pinDescriptorArray.output.size();
+			for (BuildType const type: { BuildType::highResolution, BuildType::preview }) {
+				bool const built = type == BuildType::preview ? impl->previewBuilt() : impl->built();
+				/// Blank outside of the region, they would be loaded as fully built.
+				bool const partial = type == BuildType::preview ? impl->previewPartial() : impl->partial();
+				if (!built || partial) {
+					continue;
+				}
+				for (std::size_t i = 0; i < outputCount; ++i) {
+					auto const& image = imageNode->getImage(i, type);
+					if (!embed || image.empty()) {
+						continue;
+					}
+					ImageTableEntry entry{};
+					entry.nodeIndex = nodeIndex;
+					entry.buildType = utl::to_underlying(type);
+					entry.outputIndex = std::uint32_t(i);
+					entry.dataType = utl::to_underlying(image.dataType());
+					entry.width = image.size().x;
+					entry.height = image.size().y;
+					entry.byteSize = image.storageSize() * sizeof(float);
+					result.push_back({ &image, entry });
+				}
+			}
+		}
+		return result;
+	}
+
+	bool saveNetworkBinary(Network const& network, std::filesystem::path const& path,
+						   NetworkFileInfo const& info, bool embedImages)
+	{
+		WM_Log("Saving Network with {} nodes and {} edges", network.nodeCount(), network.edgeCount());
+		std::string const chunks[] = {
+			serializeInfo(info), serializeNodes(network), serializeEdges(network)
+		};
+		std::uint32_t const chunkTags[] = { infoChunk, nodeChunk, edgeChunk };
+		auto images = gatherImages(network, embedImages);
+
+		/// Image offsets are absolute, so lay out everything in front of the image data first.
+		std::size_t offset = headerSize;
+		for (auto const& chunk: chunks) {
+			offset += chunkHeaderSize + chunk.size();
+		}
+		offset += chunkHeaderSize + sizeof(std::uint64_t) + images.size() * sizeof(ImageTableEntry);
+		offset += chunkHeaderSize;
+		std::size_t const dataBegin = offset;
+		for (auto& [image, entry]: images) {
+			offset = alignUp(offset, imageAlignment);
+			entry.offset = offset;
+			offset += entry.byteSize;
+		}
+
+		Writer table;
+		table.put(std::uint64_t(images.size()));
+		for (auto const& [image, entry]: images) {
+			table.put(entry);
+		}
+
+		auto const tempPath = std::filesystem::path(path) += ".tmp";
+		{
+			std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+			if (!file) {
+				WM_Log(error, "Failed to open file \"{}\"", tempPath.string());
+				return false;
+			}
+			auto const chunkCount = std::uint32_t(std::size(chunks) + 2);
+			file.write(binaryMagic, sizeof(binaryMagic));
+			file.write(reinterpret_cast<char const*>(&binaryVersion), sizeof(binaryVersion));
+			file.write(reinterpret_cast<char const*>(&chunkCount), sizeof(chunkCount));
+			for (std::size_t i = 0; i < std::size(chunks); ++i) {
+				writeChunk(file, chunkTags[i], chunks[i]);
+			}
+			writeChunk(file, imageTableChunk, table.buffer);
+
+			writeChunkHeader(file, imageDataChunk, offset - dataBegin);
+			std::size_t position = dataBegin;
+			char const padding[imageAlignment] = {};
+			for (auto const& [image, entry]: images) {
+				file.write(padding, std::streamsize(entry.offset - position));
+				file.write(reinterpret_cast<char const*>(image->data()), std::streamsize(entry.byteSize));
+				position = entry.offset + entry.byteSize;
+			}
+			if (!file) {
+				WM_Log(error, "Failed to write file \"{}\"", tempPath.string());
+				return false;
+			}
+		}
+		std::error_code ec;
+		std::filesystem::rename(tempPath, path, ec);
+		if (ec) {
+			WM_Log(error, "Failed to replace \"{}\": {}", path.string(), ec.message());
+			std::filesystem::remove(tempPath, ec);
+			return false;
+		}
+		return true;
+	}
+
+	/// MARK: - Loading
+	static utl::vector<std::optional<std::size_t>> deserializeNodes(Network& network, std::string_view payload) {
+		Reader reader(payload);
+		std::size_t const count = reader.get<std::uint64_t>();
+		utl::vector<std::optional<std::size_t>> nodeIndices;
+		for (std::size_t i = 0; i < count; ++i) {
+			ImplementationID const implementationID{ reader.get<std::uint64_t>() };
+			std::string const name(reader.getString());
+			mtl::float3 position;
+			position.x = reader.get<float>();
+			position.y = reader.get<float>();
+			position.z = reader.get<float>();
+			auto const parameters = reader.getString();
+			try {
+				auto desc = Registry::instance().createDescriptorFromID(implementationID);
+				desc.name = name;
+				desc.position = position;
+				std::size_t const nodeIndex = network.addNode(desc);
+				network.nodes[nodeIndex].implementation->serializer().deserializeBinary(parameters);
+				nodeIndices.push_back(nodeIndex);
+			}
+			catch (std::exception const& e) {
+				WM_Log(error, "Failed to create Node \"{}\": {}", name, e.what());
+				/// Keep the indices of later nodes stable, edges to this one are dropped.
+				nodeIndices.push_back(std::nullopt);
+			}
+		}
+		return nodeIndices;
+	}
+
+	static void deserializeEdges(Network& network, std::string_view payload,
+								 utl::vector<std::optional<std::size_t>> const& nodeIndices)
+	{
+		Reader reader(payload);
+		std::size_t const count = reader.get<std::uint64_t>();
+		for (std::size_t i = 0; i < count; ++i) {
+			std::size_t const beginNode = reader.get<std::uint64_t>();
+			std::size_t const endNode   = reader.get<std::uint64_t>();
+			std::size_t const beginPin  = reader.get<std::uint64_t>();
+			std::size_t const endPin    = reader.get<std::uint64_t>();
+			auto const beginKind = PinKind(reader.get<std::uint32_t>());
+			auto const endKind   = PinKind(reader.get<std::uint32_t>());
+			if (beginNode >= nodeIndices.size() || endNode >= nodeIndices.size() ||
+				!nodeIndices[beginNode] || !nodeIndices[endNode])
+			{
+				continue;
+			}
+			network.tryAddEdge({ *nodeIndices[beginNode], beginPin, beginKind },
+							   { *nodeIndices[endNode], endPin, endKind });
+		}
+	}
+
+	static void attachImages(Network& network, std::string_view payload,
+							 utl::vector<std::optional<std::size_t>> const& nodeIndices,
+							 std::filesystem::path const& path, std::size_t fileSize,
+							 std::uint32_t version)
+	{
+		auto imageByteSize = [](ImageTableEntry const& entry) {
+			return Image::storageSize(DataType(entry.dataType), { entry.width, entry.height }) * sizeof(float);
+		};
+		auto legacyImageByteSize = [](ImageTableEntry const& entry) {
+			return std::size_t(entry.width) * entry.height * entry.dataType * sizeof(float);
+		};
+
+		Reader reader(payload);
+		std::size_t const count = reader.get<std::uint64_t>();
+		utl::vector<ImageTableEntry> entries;
+		for (std::size_t i = 0; i < count; ++i) {
+			entries.push_back(reader.get<ImageTableEntry>());
+		}
+
+		auto isValid = [&](ImageTableEntry const& entry) {
+			if (entry.nodeIndex >= nodeIndices.size() || !nodeIndices[entry.nodeIndex]) {
+				return false;
+			}
+			auto const node = network.nodes[*nodeIndices[entry.nodeIndex]];
+			auto const& outputs = node.pinDescriptorArray.output;
+			auto const type = BuildType(entry.buildType);
+			return node.implementation->type() == NodeType::image &&
+				(type == BuildType::preview || type == BuildType::highResolution) &&
+				entry.outputIndex < outputs.size() &&
+				DataType(entry.dataType) == outputs[entry.outputIndex].dataType() &&
+				(entry.byteSize == imageByteSize(entry) || (version < 2 && entry.byteSize == legacyImageByteSize(entry))) &&
+				entry.offset <= fileSize && entry.byteSize <= fileSize - entry.offset;
+		};
+
+		/// A build type of a node only counts as built if all of its outputs are present.
+		utl::hashmap<std::pair<std::size_t, std::uint32_t>, std::size_t, utl::hash<std::pair<std::size_t, std::uint32_t>>> outputsFound;
+		for (auto const& entry: entries) {
+			if (isValid(entry)) {
+				++outputsFound[{ entry.nodeIndex, entry.buildType }];
+			}
+		}
+
+		for (auto const& entry: entries) {
+			if (!isValid(entry)) {
+				WM_Log(warning, "Ignoring invalid embedded image of node {}", entry.nodeIndex);
+				continue;
+			}
+			std::size_t const nodeIndex = *nodeIndices[entry.nodeIndex];
+			if (outputsFound[{ entry.nodeIndex, entry.buildType }] != network.nodes[nodeIndex].pinDescriptorArray.output.size()) {
+				continue;
+			}
+			auto const type = BuildType(entry.buildType);
+			auto* const impl = static_cast<ImageNodeImplementation*>(network.nodes[nodeIndex].implementation.get());
+			impl->setLazyOutput(type, entry.outputIndex, { entry.width, entry.height }, [=](Image& image) {
+				std::ifstream file(path, std::ios::binary);
+				file.seekg(std::streamoff(entry.offset));
+				/// Legacy images are larger than the storage, the rest is padding.
+				file.read(reinterpret_cast<char*>(image.data()), std::streamsize(image.storageSize() * sizeof(float)));
+				return (bool)file;
+			});
+			network.nodes[nodeIndex].flags |= type == BuildType::preview ? NodeFlags::previewBuilt : NodeFlags::built;
+		}
+	}
+
+	static bool loadNetworkBinary(Network& network, std::ifstream& file,
+								  std::filesystem::path const& path, NetworkFileInfo* info)
+	{
+		std::uint32_t version = 0, chunkCount = 0;
+		file.read(reinterpret_cast<char*>(&version), sizeof(version));
+		file.read(reinterpret_cast<char*>(&chunkCount), sizeof(chunkCount));
+		if (!file) {
+			return false;
+		}
+		if (version > binaryVersion) {
+			WM_Log(error, "File was written by a newer version (format version {}, supported {})", version, binaryVersion);
+			return false;
+		}
+
+		file.seekg(0, std::ios::end);
+		std::size_t const fileSize = std::size_t(file.tellg());
+		file.seekg(std::streamoff(headerSize));
+
+		/// Read everything but the image data, which is loaded on first use.
+		utl::hashmap<std::uint32_t, std::string> payloads;
+		for (std::uint32_t i = 0; i < chunkCount; ++i) {
+			std::uint32_t tag = 0, reserved = 0;
+			std::uint64_t size = 0;
+			file.read(reinterpret_cast<char*>(&tag), sizeof(tag));
+			file.read(reinterpret_cast<char*>(&reserved), sizeof(reserved));
+			file.read(reinterpret_cast<char*>(&size), sizeof(size));
+			if (!file || size > fileSize - std::size_t(file.tellg())) {
+				throw std::runtime_error("File corrupted.");
+			}
+			bool const known = tag == infoChunk || tag == nodeChunk || tag == edgeChunk || tag == imageTableChunk;
+			if (!known) {
+				file.seekg(std::streamoff(size), std::ios::cur);
+				continue;
+			}
+			std::string payload(size, '\0');
+			file.read(payload.data(), std::streamsize(size));
+			payloads[tag] = std::move(payload);
+		}
+		if (!file) {
+			throw std::runtime_error("File corrupted.");
+		}
+
+		network.clear();
+		auto const nodeIndices = deserializeNodes(network, payloads[nodeChunk]);
+		deserializeEdges(network, payloads[edgeChunk], nodeIndices);
+		if (auto itr = payloads.find(imageTableChunk); itr != payloads.end()) {
+			attachImages(network, itr->second, nodeIndices, std::filesystem::absolute(path), fileSize, version);
+		}
+		if (auto itr = payloads.find(infoChunk); itr != payloads.end() && info) {
+			Reader reader(itr->second);
+			mtl::usize2 resolution, previewResolution;
+			resolution.x = reader.get<std::uint64_t>();
+			resolution.y = reader.get<std::uint64_t>();
+			previewResolution.x = reader.get<std::uint64_t>();
+			previewResolution.y = reader.get<std::uint64_t>();
+			if (resolution.x > 0 && resolution.y > 0) {
+				info->resolution = resolution;
+			}
+			if (previewResolution.x > 0 && previewResolution.y > 0) {
+				info->previewResolution = previewResolution;
+			}
+		}
+		return true;
+	}
+
+	bool loadNetworkFile(Network& network, std::filesystem::path const& path, NetworkFileInfo* info) {
+		std::ifstream file(path, std::ios::binary);
+		if (!file) {
+			WM_Log(warning, "Failed to open file \"{}\"", path.string());
+			return false;
+		}
+		char magic[sizeof(binaryMagic)] = {};
+		file.read(magic, sizeof(magic));
+		if (file && std::memcmp(magic, binaryMagic, sizeof(magic)) == 0) {
+			try {
+				bool const result = loadNetworkBinary(network, file, path, info);
+				WM_Log("Loaded Network with {} nodes and {} edges", network.nodeCount(), network.edgeCount());
+				return result;
+			}
+			catch (std::exception const& e) {
+				WM_Log(error, "Deserialization failed: {}", e.what());
+				return false;
+			}
+		}
+
+		/// Not a binary document, try YAML.
+		file.clear();
+		file.seekg(0);
+		std::stringstream sstr;
+		sstr << file.rdbuf();
+		return deserializeNetwork(network, std::move(sstr).str());
+	}
+
+}
@@ -1,6 +1,9 @@
 #pragma once
 
 #include <string>
+#include <optional>
+#include <filesystem>
+#include <mtl/mtl.hpp>
 
 namespace worldmachine {
 	
@@ -9,4 +12,18 @@ namespace worldmachine {
 	std::string serializeNetwork(Network const&);
 	bool deserializeNetwork(Network&, std::string_view);
 	
+	/// Document settings that are stored next to the network in binary files
+	struct NetworkFileInfo {
+		std::optional<mtl::usize2> resolution;
+		std::optional<mtl::usize2> previewResolution;
+	};
+	
+	/// Writes the versioned binary format. With 'embedImages' the outputs of all
+	/// built nodes are stored too and are read back lazily on first access.
+	bool saveNetworkBinary(Network const&, std::filesystem::path const&,
+						   NetworkFileInfo const&, bool embedImages);
+	
+	/// Opens binary and YAML documents, the format is detected from the contents.
+	bool loadNetworkFile(Network&, std::filesystem::path const&, NetworkFileInfo* info = nullptr);
+	
 }
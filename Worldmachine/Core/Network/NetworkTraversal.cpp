@@ -2,7 +2,7 @@
 
 #include "Network.hpp"
 
-#include <utl/hashset.hpp>
+#include <algorithm>
 
 namespace worldmachine {
 	
@@ -10,55 +10,42 @@ namespace worldmachine {
 									 std::size_t beginIndex,
 									 Direction dir,
 									 bool traverseUnique):
-		visited(network->nodes.size()),
+		cursors(network->nodeCount(), unvisited),
 		traverseUnique(traverseUnique)
 	{
-		edges.reserve(network->edges.size());
-		std::copy(network->edges.begin(), network->edges.end(), std::back_inserter(edges));
-		if (dir == NetworkIterator::Direction::upstream) {
-			// reverse edges to traverse upstream
-			std::transform(edges.begin(), edges.end(),
-						   edges.begin(), [](EdgeRep edge) {
-				return reverse(edge);
-			});
+		auto const& adjacency = network->adjacency();
+		if (dir == Direction::downstream) {
+			offsets = adjacency.downstreamOffsets;
+			targets = adjacency.downstreamIndices;
 		}
-		std::sort(edges.begin(), edges.end(), [](EdgeRep a, EdgeRep b) {
-			return a.begin < b.begin;
-		});
-		ancestors.push(utl::narrow_cast<IndexType>(beginIndex));
+		else {
+			offsets = adjacency.upstreamOffsets;
+			targets = adjacency.upstreamIndices;
+		}
+		ancestors.push_back(utl::narrow_cast<IndexType>(beginIndex));
 	}
 	
 	void NetworkIterator::advance() {
 		while (!done()) {
-			visited[current()] = true;
-			
-			// find child that we have not visited yet
-			auto itr = std::lower_bound(edges.begin(),
-										edges.end(),
-										EdgeRep{ current(), (IndexType)-1 },
-										[](EdgeRep a, EdgeRep b) {
-				 return a.begin < b.begin;
-			});
+			auto& cursor = cursors[current()];
+			if (cursor == unvisited) {
+				cursor = offsets[current()];
+			}
 			
-			if (itr == edges.end() || itr->begin > current()) {
+			if (cursor == offsets[current() + 1]) {
 				// we have visited all children
 				// pop this node from the stack
 				// and make parent current
-				ancestors.pop();
+				ancestors.pop_back();
 				continue;
 			}
 			
-			WM_Assert(itr->begin == current());
-			
-			// erase edge
-			EdgeRep const edge = *itr;
-			edges.erase(itr);
-
-			if (traverseUnique && visited[edge.end]) {
+			IndexType const child = targets[cursor++];
+			if (traverseUnique && cursors[child] != unvisited) {
 				continue;
 			}
 			
-			ancestors.push(edge.end);
+			ancestors.push_back(child);
 			return;
 		}
 	}
@@ -66,9 +53,8 @@ namespace worldmachine {
 	bool hasCycles(Network const* network, std::size_t beginIndex) {
 		auto view = NetworkTraversalView(network, beginIndex);
 		for (auto i = view.begin(); i != view.end(); ++i) {
-			auto& container = utl::get_container(i.ancestors);
-			auto const begin = container.begin();
-			auto const end = container.end() - 1; /* -1 because the last element is always our current index */
+			auto const begin = i.ancestors.begin();
+			auto const end = i.ancestors.end() - 1; /* -1 because the last element is always our current index */
 			WM_Assert(*end == *i);
 			if (std::find(begin, end, *i) != end) {
 				// we have a cycle
@@ -2,7 +2,7 @@
 
 #include <cstdint>
 #include <cstddef>
-#include <stack>
+#include <span>
 #include <optional>
 #include <utl/vector.hpp>
 
@@ -16,7 +16,7 @@ namespace worldmachine {
 	
 	class NetworkIterator {
 		friend bool hasCycles(Network const*, std::size_t);
-		using IndexType = std::uint16_t; // to keep the structure small
+		using IndexType = std::uint32_t;
 		
 	public:
 		struct Sentinel {};
@@ -43,24 +43,17 @@ namespace worldmachine {
 		std::size_t operator*() const { return dereference(); }
 		
 	private:
-		IndexType current() const { return ancestors.top(); }
+		IndexType current() const { return ancestors.back(); }
 		
-		struct EdgeRep {
-			EdgeRep(IndexType begin, IndexType end): begin(begin), end(end) {}
-			EdgeRep(Edge::reference e): begin(e.beginNodeIndex), end(e.endNodeIndex) {}
-			EdgeRep(Edge::const_reference e): begin(e.beginNodeIndex), end(e.endNodeIndex) {}
-			
-			friend EdgeRep reverse(EdgeRep e) {
-				return { e.end, e.begin };
-			}
-			
-			IndexType begin, end;
-		};
+		static constexpr std::uint32_t unvisited = std::uint32_t(-1);
 		
 	private:
-		utl::vector<EdgeRep> edges;
-		std::stack<IndexType, utl::small_vector<IndexType>> ancestors;
-		utl::vector<bool> visited;
+		/// Adjacency rows of the network, see Network::adjacency()
+		std::span<std::uint32_t const> offsets, targets;
+		utl::small_vector<IndexType, 32> ancestors;
+		/// Position of the next edge to follow in 'targets' per node, or 'unvisited'.
+		/// Every edge is followed once per traversal, even if its begin node is reached again.
+		utl::small_vector<std::uint32_t, 64> cursors;
 		bool traverseUnique;
 	};
 	
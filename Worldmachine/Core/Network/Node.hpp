@@ -6,6 +6,8 @@
 #include <utl/memory.hpp>
 #include <mtl/mtl.hpp>
 #include <utl/UUID.hpp>
+#include <utl/vector.hpp>
+#include <cstdint>
 #include <string>
 #include <array>
 #include <optional>
@@ -29,6 +31,13 @@ namespace worldmachine {
 		std::optional<ImplementationID> implementationID;
 	};
 	
+	/// Indices into Network::edges of the edges ending in and starting at a node,
+	/// kept up to date by Network. Leaves have no outgoing, roots no incoming edges.
+	struct NodeEdgeIndices {
+		utl::small_vector<std::uint32_t, 4> incoming;
+		utl::small_vector<std::uint32_t, 2> outgoing;
+	};
+	
 	UTL_SOA_TYPE(Node,
 				 (std::string,                  name),
 				 (NodeCategory,                 category),
@@ -39,7 +48,8 @@ namespace worldmachine {
 				 (NodeFlags,                    flags),
 				 (utl::UUID,                    id),
 				 (utl::ref<NodeImplementation>, implementation),
-				 (NodePinDescriptorArray,       pinDescriptorArray)
+				 (NodePinDescriptorArray,       pinDescriptorArray),
+				 (NodeEdgeIndices,              edgeIndices)
 				 );
 	
 	mtl::float2 nodeSize(NodeParameters, PinCount<float>);
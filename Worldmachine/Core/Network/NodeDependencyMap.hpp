@@ -1,5 +1,7 @@
 #pragma once
 
+#include <memory>
+#include <type_traits>
 #include <utl/hashmap.hpp>
 
 #include "Node.hpp"
@@ -10,6 +12,8 @@ namespace worldmachine {
 	class NodeDependencyMap {
 		friend class BuildSystem;
 	public:
+		/// Inputs of compact data types are converted to float1 unless 'ValueType'
+		/// is Float16 or UNorm16. The converted copy lives until the node is built.
 		template <typename ValueType>
 		ImageView<ValueType const> getInput(std::size_t index) {
 			return getInputImpl<ValueType>(index, PinKind::input);
@@ -31,7 +35,19 @@ namespace worldmachine {
 			if (!inputNode) {
 				return {};
 			}
-			return inputNode->getImage(itr->second.outputIndex, inputNode->_currentBuildType);
+			Image const& image = inputNode->getImage(itr->second.outputIndex, inputNode->_currentBuildType);
+			if constexpr (!std::is_same_v<ValueType, Float16> && !std::is_same_v<ValueType, UNorm16>) {
+				if (isCompactDataType(image.dataType())) {
+					return decodeInput(image);
+				}
+			}
+			return image;
+		}
+		
+		Image const& decodeInput(Image const& image) {
+			WM_Assert(consumer);
+			consumer->_decodedInputs.push_back(std::make_unique<Image>(decodeImage(image)));
+			return *consumer->_decodedInputs.back();
 		}
 		
 	private:
@@ -47,6 +63,7 @@ namespace worldmachine {
 			InputDependency,
 			utl::hash<InputDependencyKey>
 		> inputs;
+		NodeImplementation* consumer = nullptr;
 	};
 	
 }
@@ -2,12 +2,14 @@
 
 #include <thread>
 #include <random>
+#include <algorithm>
 #include <utl/functional.hpp>
 #include <utl/hashmap.hpp>
 #include <imgui/imgui.h>
 
 #include "Core/Debug.hpp"
 #include "Core/Registry.hpp"
+#include "Core/Image/ImagePool.hpp"
 #include "Core/BuildJob.hpp"
 #include "Core/Network/NodeDependencyMap.hpp"
 
@@ -28,9 +30,15 @@ namespace worldmachine {
 	}
 	
 	/// MARK: - ImageNodeImplementation
+	ImageNodeImplementation::~ImageNodeImplementation() {
+		releaseOutputs(BuildType::all);
+	}
+	
 	void ImageNodeImplementation::dynamicInit() {
 		auto desc = Registry::instance().createDescriptorFromID(implementationID());
 		
+		releaseOutputs(BuildType::all);
+		dropPendingOutputs(BuildType::all);
 		_previewOutputs.clear();
 		_highresOutputs.clear();
 		for (auto const& i: desc.pinDescriptorArray.output) {
@@ -39,18 +47,100 @@ namespace worldmachine {
 		}
 	}
 	
-	void ImageNodeImplementation::clearBuildDest() {
+	void ImageNodeImplementation::clearBuildDest(std::uint64_t connectedOutputs) {
 		WM_Assert(_currentBuildType != BuildType::none);
+		dropPendingOutputs(_currentBuildType);
 		auto& outputs = _currentBuildType == BuildType::highResolution ?
 			_highresOutputs : _previewOutputs;
-		for (auto& i: outputs) {
-			i.clear();
-			i.resize(currentBuildResolution());
+		for (std::size_t i = 0; i < outputs.size(); ++i) {
+			bool const connected = i < 64 && (connectedOutputs >> i & 1);
+			if (outputEnabled(i) || connected) {
+				ImagePool::instance().allocate(outputs[i], currentBuildResolution());
+			}
+			else {
+				ImagePool::instance().release(outputs[i]);
+			}
 		}
 	}
 	
+	void ImageNodeImplementation::releaseOutputs(BuildType type) {
+		dropPendingOutputs(type);
+		if (test(type & BuildType::preview)) {
+			for (auto& i: _previewOutputs) {
+				ImagePool::instance().release(i);
+			}
+		}
+		if (test(type & BuildType::highResolution)) {
+			for (auto& i: _highresOutputs) {
+				ImagePool::instance().release(i);
+			}
+		}
+	}
+	
+	void ImageNodeImplementation::adoptBuildDest(Image& source) {
+		Image& dest = buildDests()[0];
+		WM_Assert(dest.dataType() == source.dataType());
+		ImagePool::instance().release(dest);
+		mtl::usize2 const size = source.size();
+		dest.adoptStorage(source.releaseStorage(), size);
+	}
+	
+	std::span<Image> ImageNodeImplementation::buildDests() {
+		WM_Assert(_currentBuildType != BuildType::none);
+		auto& outputs = _currentBuildType == BuildType::highResolution ?
+			_highresOutputs : _previewOutputs;
+		return { outputs.data(), outputs.size() };
+	}
+	
+	void ImageNodeImplementation::setLazyOutput(BuildType type, std::size_t index, mtl::usize2 size,
+												utl::function<bool(Image&)> load)
+	{
+		WM_Assert(type == BuildType::preview || type == BuildType::highResolution);
+		WM_BoundsCheck(index, 0, _previewOutputs.size());
+		std::lock_guard lock(_pendingMutex);
+		_pendingOutputs.push_back({ type, index, size, std::move(load) });
+		_hasPendingOutputs = true;
+		(type == BuildType::preview ? _previewBuilt : _built) = true;
+		(type == BuildType::preview ? _previewBuiltResolution : _highresBuiltResolution) = size;
+	}
+	
+	void ImageNodeImplementation::loadPendingOutputs(BuildType type) const {
+		std::lock_guard lock(_pendingMutex);
+		auto& self = utl::as_mutable(*this);
+		for (auto& output: _pendingOutputs) {
+			if (output.type != type) {
+				continue;
+			}
+			auto& image = (type == BuildType::preview ? self._previewOutputs : self._highresOutputs)[output.index];
+			ImagePool::instance().allocate(image, output.size);
+			if (!output.load(image)) {
+				/// Leave the zeroed image, downstream nodes still get an image of the expected size.
+				WM_Log(error, "Failed to load output {} of '{}'", output.index, implementationName());
+			}
+		}
+		self.dropPendingOutputsLocked(type);
+	}
+	
+	void ImageNodeImplementation::dropPendingOutputs(BuildType type) {
+		if (!_hasPendingOutputs) {
+			return;
+		}
+		std::lock_guard lock(_pendingMutex);
+		dropPendingOutputsLocked(type);
+	}
+	
+	void ImageNodeImplementation::dropPendingOutputsLocked(BuildType type) {
+		_pendingOutputs.erase(std::remove_if(_pendingOutputs.begin(), _pendingOutputs.end(), [&](PendingOutput const& output) {
+			return test(output.type & type);
+		}), _pendingOutputs.end());
+		_hasPendingOutputs = !_pendingOutputs.empty();
+	}
+	
 	Image const& ImageNodeImplementation::getImage(std::size_t index, BuildType type) const {
 		WM_Assert(type != BuildType::none);
+		if (_hasPendingOutputs) {
+			loadPendingOutputs(type);
+		}
 		if (type == BuildType::preview) {
 			return _previewOutputs[index];
 		}
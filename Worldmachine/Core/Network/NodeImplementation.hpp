@@ -2,9 +2,13 @@
 
 #include <utl/UUID.hpp>
 #include <string>
+#include <optional>
+#include <memory>
 #include <utl/static_string.hpp>
 #include <utl/hash.hpp>
+#include <utl/functional.hpp>
 #include <atomic>
+#include <mutex>
 
 #include "Core/Base.hpp"
 #include "Core/BuildSystemFwd.hpp"
@@ -58,10 +62,41 @@ namespace worldmachine {
 		bool built() const { return _built; }
 		bool previewBuilt() const { return _previewBuilt; }
 		
+		/// Built for a region only, the rest of the outputs is blank. See FocusRequest.
+		bool partial() const { return _partial; }
+		bool previewPartial() const { return _previewPartial; }
+		
+		/// Number of rows above and below an output row that are read from the
+		/// inputs, or nullopt if the node may read anywhere in its inputs.
+		std::optional<std::size_t> rowFootprint() const { return _rowFootprint; }
+		
+		/// Input whose buffer output 0 may take over, see setInPlaceInput()
+		std::optional<std::size_t> inPlaceInput() const { return _inPlaceInput; }
+		
+		/// Part of the output cache key, see setOutputVersion()
+		std::uint32_t outputVersion() const { return _outputVersion; }
+		
 	protected:
 		mtl::usize2 buildResolution(BuildType type) const;
 		mtl::usize2 currentBuildResolution() const { return buildResolution(currentBuildType()); }
 		
+		/// Lets the build system start jobs of this node before its inputs are
+		/// finished, see BuildJob::add(RowRange, ...). To be called from the constructor.
+		void setRowFootprint(std::size_t halo) { _rowFootprint = halo; }
+		
+		/// Declares that output 0 may share its buffer with input 'index', which
+		/// then reads the pixels being written. Jobs must read a pixel of the input
+		/// before writing the same pixel, or read all of the input before a barrier.
+		/// If nothing else reads the upstream output and the build is over its memory
+		/// budget, the build system hands that buffer over instead of allocating a new
+		/// one. To be called from the constructor.
+		void setInPlaceInput(std::size_t index) { _inPlaceInput = index; }
+		
+		/// To be raised whenever the node computes different outputs from the same
+		/// parameters and inputs, so stale entries of the output cache are not loaded.
+		/// To be called from the constructor.
+		void setOutputVersion(std::uint32_t version) { _outputVersion = version; }
+		
 	private:
 		virtual std::string_view _implName() const noexcept = 0;
 		virtual ImplementationID _implID() const noexcept = 0;
@@ -72,11 +107,22 @@ namespace worldmachine {
 		NodeSerializer _serializer;
 		mtl::usize2 _previewBuildResolution = 0;
 		mtl::usize2 _highresBuildResolution = 0;
+		/// Resolution of the current outputs, only meaningful while built
+		mtl::usize2 _previewBuiltResolution = 0;
+		mtl::usize2 _highresBuiltResolution = 0;
 		NodeType _type;
+		std::optional<std::size_t> _rowFootprint;
+		std::optional<std::size_t> _inPlaceInput;
+		std::uint32_t _outputVersion = 0;
 		std::atomic<BuildType> _currentBuildType = BuildType::none;
 		std::atomic_bool _isBuilding = false;
 		std::atomic_bool _built = false;
 		std::atomic_bool _previewBuilt = false;
+		/// Built for a region only, the rest of the outputs is left blank.
+		std::atomic_bool _partial = false;
+		std::atomic_bool _previewPartial = false;
+		/// Float copies of compact inputs, see NodeDependencyMap::getInput()
+		utl::vector<std::unique_ptr<Image>> _decodedInputs;
 	};
 
 	/// MARK: FallbackNodeImplementation
@@ -101,28 +147,65 @@ namespace worldmachine {
 		friend class BuildSystem;
 	public:
 		ImageNodeImplementation(): NodeImplementation(NodeType::image) {}
+		~ImageNodeImplementation();
 		
 		Image const& previewImage(std::size_t index) const {
-			return _previewOutputs[index];
+			return getImage(index, BuildType::preview);
 		}
 		Image const& highResImage(std::size_t index) const {
-			return _highresOutputs[index];
+			return getImage(index, BuildType::highResolution);
 		}
 		
 		Image const& getImage(std::size_t index, BuildType type) const;
 		
+		/// Marks output 'index' of 'type' as built without reading it. 'load' fills
+		/// the zeroed image on first access, e.g. from a document with embedded images.
+		void setLazyOutput(BuildType type, std::size_t index, mtl::usize2 size,
+						   utl::function<bool(Image&)> load);
+		
 	protected:
 		Image& getBuildDest(std::size_t index);
 		Image const& getBuildDest(std::size_t index) const;
 		
-		void clearBuildDest();
+		/// Allocates the outputs of the current build type. Bit i of 'connectedOutputs'
+		/// is set if output i feeds another node.
+		void clearBuildDest(std::uint64_t connectedOutputs = 0);
+		
+		/// Outputs switched off by a parameter. clearBuildDest() leaves them empty,
+		/// unless another node reads them, which then reads a blank image.
+		virtual bool outputEnabled(std::size_t index) const { return true; }
 		
 	private:
 		void dynamicInit() override;
 		
+		/// All outputs of the current build type
+		std::span<Image> buildDests();
+		
+		/// Returns the storage of all outputs of 'type' to the image pool
+		void releaseOutputs(BuildType type);
+		
+		/// Output 0 of the current build type takes over the storage of 'source',
+		/// which is left empty. Called after clearBuildDest(), the storage of
+		/// output 0 goes back to the image pool.
+		void adoptBuildDest(Image& source);
+		
+		void loadPendingOutputs(BuildType type) const;
+		void dropPendingOutputs(BuildType type);
+		void dropPendingOutputsLocked(BuildType type);
+		
 	private:
+		struct PendingOutput {
+			BuildType type;
+			std::size_t index;
+			mtl::usize2 size;
+			utl::function<bool(Image&)> load;
+		};
+		
 		utl::small_vector<Image, 2> _previewOutputs;
 		utl::small_vector<Image, 2> _highresOutputs;
+		mutable std::mutex _pendingMutex;
+		mutable utl::vector<PendingOutput> _pendingOutputs;
+		mutable std::atomic_bool _hasPendingOutputs = false;
 	};
 	
 	/// MARK: - NodeImplementationT
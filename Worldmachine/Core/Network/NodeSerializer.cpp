@@ -1,6 +1,8 @@
 #include "NodeSerializer.hpp"
 
 #include <yaml-cpp/yaml.h>
+#include <cstring>
+#include <cstdint>
 
 namespace worldmachine {
 	
@@ -21,8 +23,56 @@ namespace worldmachine {
 		}
 	}
 	
+	void NodeSerializer::serializeBinary(std::string& out) const {
+		auto append = [&](auto value) {
+			out.append(reinterpret_cast<char const*>(&value), sizeof(value));
+		};
+		append(std::uint32_t(_binaryMembers.size()));
+		for (auto const& member: _binaryMembers) {
+			std::string_view const name = member.name;
+			append(std::uint32_t(name.size()));
+			out.append(name);
+			append(std::uint32_t(member.size));
+			out.append(static_cast<char const*>(member.data), member.size);
+		}
+	}
+	
+	void NodeSerializer::deserializeBinary(std::string_view data) const {
+		auto read = [&]<typename T>(T& value) {
+			if (data.size() < sizeof(T)) {
+				return false;
+			}
+			std::memcpy(&value, data.data(), sizeof(T));
+			data.remove_prefix(sizeof(T));
+			return true;
+		};
+		std::uint32_t count = 0;
+		if (!read(count)) {
+			return;
+		}
+		for (std::uint32_t i = 0; i < count; ++i) {
+			std::uint32_t nameSize = 0, size = 0;
+			if (!read(nameSize) || data.size() < nameSize) {
+				return;
+			}
+			std::string_view const name = data.substr(0, nameSize);
+			data.remove_prefix(nameSize);
+			if (!read(size) || data.size() < size) {
+				return;
+			}
+			for (auto const& member: _binaryMembers) {
+				if (member.name == name && member.size == size) {
+					std::memcpy(member.data, data.data(), size);
+				}
+			}
+			data.remove_prefix(size);
+		}
+	}
+	
 	template <utl::arithmetic T>
 	void NodeSerializer::addMember(T* data, char const* name) {
+		_binaryMembers.push_back({ name, data, sizeof(T) });
+		
 		using namespace YAML;
 		_serializers.push_back([=](YAML::Emitter& out) {
 			out << Key << name << Value << *data;
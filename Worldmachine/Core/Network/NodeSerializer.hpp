@@ -1,5 +1,7 @@
 #pragma once
 
+#include <string>
+#include <string_view>
 #include <utl/concepts.hpp>
 #include <utl/vector.hpp>
 #include <utl/functional.hpp>
@@ -16,6 +18,11 @@ namespace worldmachine {
 		void serialize(YAML::Emitter&) const;
 		void deserialize(YAML::Node&) const;
 		
+		/// Compact form for binary documents: name, size and raw bytes of every member.
+		/// Members are matched by name, unknown or mismatched entries are skipped.
+		void serializeBinary(std::string& out) const;
+		void deserializeBinary(std::string_view data) const;
+		
 		template <utl::arithmetic T>
 		void addMember(T* data, char const* name);
 		
@@ -26,7 +33,14 @@ namespace worldmachine {
 		}
 		
 	private:
+		struct BinaryMember {
+			char const* name;
+			void* data;
+			std::size_t size;
+		};
+		
 		utl::vector<utl::function<void(YAML::Emitter&)>> _serializers;
+		utl::vector<BinaryMember> _binaryMembers;
 		utl::vector<utl::function<void(YAML::Node&)>> _deserializers;
 	};
 	
@@ -0,0 +1,232 @@
+#include "NodeOutputCache.hpp"
+
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <utl/vector.hpp>
+
+#include "Core/Debug.hpp"
+
+namespace worldmachine {
+
+	namespace {
+		constexpr char magic[4] = { 'W', 'M', 'N', 'C' };
+		/// Bump whenever the file layout changes. Changes to the output of a node
+		/// go into its key instead, see NodeImplementation::setOutputVersion().
+		constexpr std::uint32_t formatVersion = 1;
+
+		/// FNV-1a, stable across runs and platforms unlike std::hash
+		std::uint64_t fnv1a(std::string_view text) {
+			std::uint64_t hash = 0xcbf29ce484222325;
+			for (unsigned char c: text) {
+				hash ^= c;
+				hash *= 0x100000001b3;
+			}
+			return hash;
+		}
+
+		template <typename T>
+		void write(std::ostream& str, T const& value) {
+			str.write(reinterpret_cast<char const*>(&value), sizeof(T));
+		}
+
+		template <typename T>
+		bool read(std::istream& str, T& value) {
+			return (bool)str.read(reinterpret_cast<char*>(&value), sizeof(T));
+		}
+
+		std::span<float const> allFloats(Image const& image) {
+			return { image.data(), std::size_t(image.end() - image.begin()) };
+		}
+	}
+
+	NodeOutputCache::Key NodeOutputCache::makeKey(std::string text) {
+		return { fnv1a(text), std::move(text) };
+	}
+
+	std::optional<std::filesystem::path> NodeOutputCache::defaultDirectory() {
+		std::error_code ec;
+		auto const tmp = std::filesystem::temp_directory_path(ec);
+		if (ec) {
+			return std::nullopt;
+		}
+		return tmp / "Worldmachine" / "NodeCache";
+	}
+
+	NodeOutputCache::NodeOutputCache(std::filesystem::path directory, std::uintmax_t capacity):
+		_directory(std::move(directory)), _capacity(capacity)
+	{
+		std::error_code ec;
+		std::filesystem::create_directories(_directory, ec);
+		if (ec) {
+			WM_Log(error, "Failed to create node cache directory '{}': {}", _directory.string(), ec.message());
+		}
+		/// Also sets '_size'
+		trim();
+	}
+
+	void NodeOutputCache::setCapacity(std::uintmax_t bytes) {
+		std::lock_guard lock(mutex);
+		_capacity = bytes;
+		if (_size > _capacity) {
+			trim();
+		}
+	}
+
+	std::filesystem::path NodeOutputCache::entryPath(Key const& key) const {
+		std::stringstream sstr;
+		sstr << std::hex << std::setw(16) << std::setfill('0') << key.hash << ".wmcache";
+		return _directory / sstr.str();
+	}
+
+	/// Entries are only ever replaced by renaming, so they are read without the mutex.
+	bool NodeOutputCache::load(Key const& key, std::span<Image> outputs) const {
+		auto const path = entryPath(key);
+		std::ifstream file(path, std::ios::binary);
+		if (!file) {
+			return false;
+		}
+
+		char fileMagic[4];
+		std::uint32_t version = 0;
+		std::uint64_t textSize = 0;
+		if (!file.read(fileMagic, 4) || !std::equal(fileMagic, fileMagic + 4, magic) ||
+			!read(file, version) || version != formatVersion ||
+			!read(file, textSize) || textSize != key.text.size())
+		{
+			return false;
+		}
+		std::string text(textSize, '\0');
+		if (!file.read(text.data(), (std::streamsize)textSize) || text != key.text) {
+			WM_Log(warning, "Node cache hash collision in '{}'", path.string());
+			return false;
+		}
+
+		std::uint32_t outputCount = 0;
+		if (!read(file, outputCount) || outputCount != outputs.size()) {
+			return false;
+		}
+		for (auto& image: outputs) {
+			std::uint32_t dataType = 0;
+			std::uint64_t width = 0, height = 0, floatCount = 0;
+			if (!read(file, dataType) || !read(file, width) || !read(file, height) || !read(file, floatCount)) {
+				return false;
+			}
+			auto const floats = allFloats(image);
+			if (DataType(dataType) != image.dataType() ||
+				width != image.size().x || height != image.size().y ||
+				floatCount != floats.size())
+			{
+				return false;
+			}
+			if (!file.read(reinterpret_cast<char*>(image.data()), (std::streamsize)(floatCount * sizeof(float)))) {
+				return false;
+			}
+		}
+		file.close();
+
+		/// Keeps recently used entries from being trimmed
+		std::error_code ec;
+		std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), ec);
+		return true;
+	}
+
+	void NodeOutputCache::store(Key const& key, std::span<Image const> outputs) {
+		auto const path = entryPath(key);
+		/// Write to a temporary first so a crash never leaves a truncated entry behind.
+		/// Named per store, others may be writing an entry with the same key.
+		auto tmpPath = path;
+		tmpPath += "." + std::to_string(tmpCounter.fetch_add(1, std::memory_order_relaxed)) + ".tmp";
+		{
+			std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+			if (!file) {
+				WM_Log(warning, "Failed to open '{}' for writing", tmpPath.string());
+				return;
+			}
+			file.write(magic, 4);
+			write(file, formatVersion);
+			write(file, std::uint64_t(key.text.size()));
+			file.write(key.text.data(), (std::streamsize)key.text.size());
+			write(file, std::uint32_t(outputs.size()));
+			for (auto const& image: outputs) {
+				auto const floats = allFloats(image);
+				write(file, std::uint32_t(utl::to_underlying(image.dataType())));
+				write(file, std::uint64_t(image.size().x));
+				write(file, std::uint64_t(image.size().y));
+				write(file, std::uint64_t(floats.size()));
+				file.write(reinterpret_cast<char const*>(floats.data()), (std::streamsize)(floats.size() * sizeof(float)));
+			}
+			if (!file) {
+				WM_Log(warning, "Failed to write node cache entry '{}'", path.string());
+				file.close();
+				std::error_code ec;
+				std::filesystem::remove(tmpPath, ec);
+				return;
+			}
+		}
+		std::error_code ec;
+		std::uintmax_t const size = std::filesystem::file_size(tmpPath, ec);
+		std::lock_guard lock(mutex);
+		/// An entry with the same key is replaced.
+		std::uintmax_t const replacedSize = std::filesystem::file_size(path, ec);
+		std::uintmax_t const replaced = ec ? 0 : replacedSize;
+		std::filesystem::rename(tmpPath, path, ec);
+		if (ec) {
+			WM_Log(warning, "Failed to store node cache entry '{}': {}", path.string(), ec.message());
+			std::filesystem::remove(tmpPath, ec);
+			return;
+		}
+		_size = _size - std::min(_size, replaced) + size;
+		if (_size > _capacity) {
+			trim();
+		}
+	}
+
+	void NodeOutputCache::clear() {
+		std::lock_guard lock(mutex);
+		std::error_code ec;
+		for (auto const& entry: std::filesystem::directory_iterator(_directory, ec)) {
+			if (entry.path().extension() == ".wmcache") {
+				std::filesystem::remove(entry.path(), ec);
+			}
+		}
+		_size = 0;
+	}
+
+	void NodeOutputCache::trim() {
+		struct Entry {
+			std::filesystem::path path;
+			std::uintmax_t size;
+			std::filesystem::file_time_type lastUse;
+		};
+		utl::vector<Entry> entries;
+		std::uintmax_t totalSize = 0;
+		std::error_code ec;
+		for (auto const& entry: std::filesystem::directory_iterator(_directory, ec)) {
+			if (entry.path().extension() != ".wmcache") {
+				continue;
+			}
+			auto const size = entry.file_size(ec);
+			entries.push_back({ entry.path(), size, entry.last_write_time(ec) });
+			totalSize += size;
+		}
+		_size = totalSize;
+		if (totalSize <= _capacity) {
+			return;
+		}
+		std::sort(entries.begin(), entries.end(), [](Entry const& a, Entry const& b) {
+			return a.lastUse < b.lastUse;
+		});
+		for (auto const& entry: entries) {
+			if (totalSize <= _capacity) {
+				break;
+			}
+			if (std::filesystem::remove(entry.path, ec)) {
+				totalSize -= entry.size;
+			}
+		}
+		_size = totalSize;
+	}
+
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+
+#include "Core/Image/Image.hpp"
+
+namespace worldmachine {
+
+	/// Content addressed disk cache for node outputs.
+	/// The key text describes everything the outputs depend on: the implementation
+	/// and its output version, its serialized parameters, the build resolution and
+	/// the keys of all inputs.
+	/// Entries are named by a hash of the key text, the text itself is stored
+	/// in the entry and compared on load to rule out collisions.
+	class NodeOutputCache {
+	public:
+		struct Key {
+			std::uint64_t hash = 0;
+			std::string text;
+		};
+
+		static Key makeKey(std::string text);
+		
+		/// Subdirectory of the system temp directory, nullopt if there is none
+		static std::optional<std::filesystem::path> defaultDirectory();
+
+	public:
+		explicit NodeOutputCache(std::filesystem::path directory,
+								 std::uintmax_t capacity = std::uintmax_t(4) << 30);
+
+		std::filesystem::path const& directory() const { return _directory; }
+
+		/// Least recently used entries are removed when the cache grows beyond this many bytes.
+		std::uintmax_t capacity() const { return _capacity; }
+		void setCapacity(std::uintmax_t bytes);
+
+		/// 'outputs' must already have the data type and size of the build.
+		/// Returns false and leaves the contents unspecified if there is no matching entry.
+		/// Files are read and written outside of the mutex, so stores from several
+		/// threads do not wait for each other's disk writes.
+		bool load(Key const&, std::span<Image> outputs) const;
+		void store(Key const&, std::span<Image const> outputs);
+
+		void clear();
+
+	private:
+		std::filesystem::path entryPath(Key const&) const;
+		/// Scans the directory, once on open and then only when the running total
+		/// goes over capacity.
+		void trim();
+
+	private:
+		std::filesystem::path _directory;
+		std::uintmax_t _capacity;
+		/// Bytes of all entries, kept up to date by store() and set by each scan
+		std::uintmax_t _size = 0;
+		/// Guards '_size', '_capacity' and renaming and removing entries
+		mutable std::mutex mutex;
+		std::atomic<std::uint64_t> tmpCounter = 0;
+	};
+
+}
@@ -1,5 +1,10 @@
 include "Utility/premakeCommon.lua"
 
+newoption {
+    trigger = "avx2",
+    description = "Compile the point-wise image kernels (and everything else) for AVX2"
+}
+
 -----------------------------------------------------------------------------------------
 -- Workspace Worldmachine
 -----------------------------------------------------------------------------------------
@@ -28,6 +33,8 @@ filter "system:macosx"
     }
 filter "system:windows"
     defines { "WM_PLATFORM_WINDOWS" }
+filter "options:avx2"
+    vectorextensions "AVX2"
 filter {}
 
 targetdir("Build/Bin/%{cfg.longname}")
@@ -201,6 +208,66 @@ postbuildcommands {
     "{COPY} %{cfg.targetdir}/libWMBuiltinNodes.dylib %{cfg.targetdir}/Worldmachine.app/Contents/MacOS",
 }
 
+-----------------------------------------------------------------------------------------
+-- Project WMCommandLine
+-----------------------------------------------------------------------------------------
+-- Headless builder for batch machines. ImGui is only linked because WMCore and the
+-- node plugin refer to it, no context is ever created.
+project "WMCommandLine"
+location "Worldmachine/CLI"
+kind "ConsoleApp"
+language "C++"
+targetname "wmbuild"
+
+dependson "WMBuiltinNodes"
+
+files { 
+    "Worldmachine/CLI/**.hpp",
+    "Worldmachine/CLI/**.cpp"
+}
+
+links { 
+    "WMCore",
+    "Utility",
+    "ImGui",
+    "YAML"
+}
+
+filter "system:linux"
+    links { "dl", "pthread" }
+filter {}
+
+-----------------------------------------------------------------------------------------
+-- Project WMBenchmarks
+-----------------------------------------------------------------------------------------
+-- Prints one JSON object per measurement, see Benchmarks/main.cpp. Build with
+-- configuration Release to get meaningful numbers.
+project "WMBenchmarks"
+location "Benchmarks"
+kind "ConsoleApp"
+language "C++"
+targetname "wmbench"
+
+dependson "WMBuiltinNodes"
+
+files { 
+    "Benchmarks/**.hpp",
+    "Benchmarks/**.cpp",
+    "Worldmachine/CLI/ArgumentParser.hpp",
+    "Worldmachine/CLI/ArgumentParser.cpp"
+}
+
+links { 
+    "WMCore",
+    "Utility",
+    "ImGui",
+    "YAML"
+}
+
+filter "system:linux"
+    links { "dl", "pthread" }
+filter {}
+
 -----------------------------------------------------------------------------------------
 -- Project WMPlayground
 -----------------------------------------------------------------------------------------